@@ -0,0 +1,90 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+//
+// Minimal benchmark harness shared by the bench targets. Each benchmark is run
+// with a doubling iteration count until it takes at least BOF_BENCH_MIN_MS
+// milliseconds (default 200), then reported as ns/op and bytes/s.
+//
+
+struct bench_result {
+    uint64_t iterations    = 0;
+    double   ns_per_op     = 0;
+    double   ns_per_item   = 0;
+    double   bytes_per_sec = 0;
+};
+
+template<typename T>
+inline void bench_do_not_optimize(T const& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+inline double bench_min_ms() {
+    static const double min_ms = [] {
+        const char* env = std::getenv("BOF_BENCH_MIN_MS");
+        return env != nullptr && std::atof(env) > 0 ? std::atof(env) : 200.0;
+    }();
+    return min_ms;
+}
+
+inline void bench_print_header(const char* title) {
+    std::printf("\n== %s\n", title);
+    std::printf("%-44s %12s %14s %12s %14s\n", "benchmark", "iterations", "ns/op", "ns/item", "MiB/s");
+}
+
+inline void bench_print(const std::string& name, const bench_result& result) {
+    std::printf("%-44s %12llu %14.1f %12.2f %14.1f\n",
+        name.c_str(),
+        static_cast<unsigned long long>(result.iterations),
+        result.ns_per_op,
+        result.ns_per_item,
+        result.bytes_per_sec / (1024.0 * 1024.0));
+}
+
+//
+// "bytes" and "items" are per single call of fn, and only used for the derived
+// throughput columns. Pass 0 when they make no sense for the benchmark.
+//
+template<typename T>
+bench_result bench_run(const std::string& name, const uint64_t bytes, const uint64_t items, T&& fn) {
+    using clock = std::chrono::steady_clock;
+
+    bench_result result;
+    uint64_t iterations = 1;
+    double elapsed_ns = 0;
+
+    fn(); // warm up caches and lazy initialisation
+
+    while (true) {
+        const auto start = clock::now();
+        for (uint64_t i = 0; i < iterations; i++) {
+            fn();
+        }
+        elapsed_ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+
+        if (elapsed_ns >= bench_min_ms() * 1e6 || iterations >= (1ull << 40)) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    result.iterations    = iterations;
+    result.ns_per_op     = elapsed_ns / static_cast<double>(iterations);
+    result.ns_per_item   = items ? result.ns_per_op / static_cast<double>(items) : 0;
+    result.bytes_per_sec = bytes ? static_cast<double>(bytes) * 1e9 / result.ns_per_op : 0;
+
+    bench_print(name, result);
+    return result;
+}
+
+#endif //BENCH_HPP
@@ -0,0 +1,230 @@
+#include <bench.hpp>
+#include <beacon_api.hpp>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//
+// Microbenchmarks for the Beacon API implementation in src/beacon_api.cpp.
+// Only the portable parts (data parsing, format buffers, output) are measured;
+// the token/process functions are stubs outside of Windows anyway.
+//
+
+namespace {
+
+const int message_sizes[] = { 16, 64, 256, 1024, 4096 };
+
+constexpr int args_per_blob = 64;
+
+//
+// Output accumulates in the runtime until somebody collects it, so the output
+// benchmarks drain it every this many calls to keep the buffer from growing forever.
+//
+constexpr uint32_t output_drain_interval = 4096;
+
+void append_prefixed(std::vector<char>& blob, const std::string& str) {
+    const auto size = static_cast<uint32_t>(str.size() + 1);
+    blob.insert(blob.end(), reinterpret_cast<const char*>(&size), reinterpret_cast<const char*>(&size) + sizeof(size));
+    blob.insert(blob.end(), str.begin(), str.end());
+    blob.push_back('\0');
+}
+
+template<typename T>
+void append_raw(std::vector<char>& blob, T value) {
+    blob.insert(blob.end(), reinterpret_cast<const char*>(&value), reinterpret_cast<const char*>(&value) + sizeof(T));
+}
+
+void bench_data_api() {
+    bench_print_header("BeaconData* (argument extraction)");
+
+    std::vector<char> ints;
+    std::vector<char> shorts;
+    for (int i = 0; i < args_per_blob; i++) {
+        append_raw<int>(ints, i * 7919);
+        append_raw<short>(shorts, static_cast<short>(i));
+    }
+
+    bench_run("BeaconDataInt x" + std::to_string(args_per_blob), ints.size(), args_per_blob, [&] {
+        datap parser;
+        int sum = 0;
+        BeaconDataParse(&parser, ints.data(), static_cast<int>(ints.size()));
+        for (int i = 0; i < args_per_blob; i++) {
+            sum += BeaconDataInt(&parser);
+        }
+        bench_do_not_optimize(sum);
+    });
+
+    bench_run("BeaconDataShort x" + std::to_string(args_per_blob), shorts.size(), args_per_blob, [&] {
+        datap parser;
+        int sum = 0;
+        BeaconDataParse(&parser, shorts.data(), static_cast<int>(shorts.size()));
+        for (int i = 0; i < args_per_blob; i++) {
+            sum += BeaconDataShort(&parser);
+        }
+        bench_do_not_optimize(sum);
+    });
+
+    for (const int size : message_sizes) {
+        std::vector<char> strings;
+        for (int i = 0; i < args_per_blob; i++) {
+            append_prefixed(strings, std::string(size - 1, 'a' + i % 26));
+        }
+
+        bench_run("BeaconDataExtract x" + std::to_string(args_per_blob) + " (" + std::to_string(size) + "B)",
+            strings.size(), args_per_blob, [&] {
+            datap parser;
+            int length = 0;
+            BeaconDataParse(&parser, strings.data(), static_cast<int>(strings.size()));
+            while (BeaconDataLength(&parser) > 0) {
+                bench_do_not_optimize(BeaconDataExtract(&parser, &length));
+            }
+        });
+    }
+}
+
+void bench_format_api() {
+    bench_print_header("BeaconFormat* (format buffers)");
+
+    char fmt_string[] = "%s: %d\n";
+
+    for (const int size : message_sizes) {
+        constexpr int capacity = 1 << 20;
+        std::string text(size, 'x');
+        formatp format;
+
+        BeaconFormatAlloc(&format, capacity);
+
+        //
+        // BeaconFormatReset marks the buffer as full (length = size), so the
+        // benchmarks rewind it by hand once it is close to capacity.
+        //
+        const auto rewind = [&](const int needed) {
+            if (format.length + needed > capacity) {
+                format.buffer = format.original;
+                format.length = 0;
+            }
+        };
+
+        bench_run("BeaconFormatAppend (" + std::to_string(size) + "B)", size, 1, [&] {
+            rewind(size);
+            BeaconFormatAppend(&format, text.data(), size);
+        });
+
+        bench_run("BeaconFormatPrintf (" + std::to_string(size) + "B)", size, 1, [&] {
+            rewind(size + 16);
+            BeaconFormatPrintf(&format, fmt_string, text.c_str(), size);
+        });
+
+        BeaconFormatFree(&format);
+    }
+
+    {
+        formatp format;
+        BeaconFormatAlloc(&format, 1 << 20);
+
+        bench_run("BeaconFormatInt", sizeof(int), 1, [&] {
+            if (format.length + 4 > format.size) {
+                format.buffer = format.original;
+                format.length = 0;
+            }
+            BeaconFormatInt(&format, 0x41424344);
+        });
+
+        bench_run("BeaconFormatToString", 0, 1, [&] {
+            int size = 0;
+            bench_do_not_optimize(BeaconFormatToString(&format, &size));
+        });
+
+        BeaconFormatFree(&format);
+    }
+
+    for (const int size : message_sizes) {
+        bench_run("BeaconFormatAlloc+Free (" + std::to_string(size) + "B)", 0, 1, [&] {
+            formatp format;
+            BeaconFormatAlloc(&format, size);
+            BeaconFormatFree(&format);
+        });
+    }
+}
+
+void bench_output_api() {
+    bench_print_header("BeaconOutput / BeaconPrintf (output accumulation)");
+
+    char fmt_string[] = "[%d] %s\n";
+
+    for (const int size : message_sizes) {
+        std::string text(size - 1, 'y');
+        uint32_t calls = 0;
+
+        clear_beacon_output();
+        bench_run("BeaconOutput (" + std::to_string(size) + "B)", size, 1, [&] {
+            BeaconOutput(CALLBACK_OUTPUT, text.data(), size);
+            if (++calls % output_drain_interval == 0) {
+                clear_beacon_output();
+            }
+        });
+
+        calls = 0;
+        clear_beacon_output();
+        bench_run("BeaconPrintf (" + std::to_string(size) + "B)", size, 1, [&] {
+            BeaconPrintf(CALLBACK_OUTPUT, fmt_string, 1, text.c_str());
+            if (++calls % output_drain_interval == 0) {
+                clear_beacon_output();
+            }
+        });
+    }
+
+    clear_beacon_output();
+    for (int i = 0; i < 1024; i++) {
+        BeaconPrintf(CALLBACK_OUTPUT, fmt_string, i, "line of typical BOF output");
+    }
+
+    const size_t collected = get_beacon_output().size();
+    bench_run("get_beacon_output (" + std::to_string(collected) + "B)", collected, 1, [&] {
+        bench_do_not_optimize(get_beacon_output());
+    });
+
+    clear_beacon_output();
+}
+
+void bench_value_api() {
+    bench_print_header("BeaconAddValue / BeaconGetValue (key/value store)");
+
+    constexpr int stored = 1024;
+    std::vector<std::string> keys;
+    int value = 0;
+
+    for (int i = 0; i < stored; i++) {
+        keys.push_back("bench.cache." + std::to_string(i));
+        BeaconAddValue(keys.back().c_str(), &value);
+    }
+
+    size_t next = 0;
+    bench_run("BeaconGetValue (" + std::to_string(stored) + " keys, hit)", 0, 1, [&] {
+        bench_do_not_optimize(BeaconGetValue(keys[next++ % keys.size()].c_str()));
+    });
+
+    bench_run("BeaconGetValue (miss)", 0, 1, [&] {
+        bench_do_not_optimize(BeaconGetValue("bench.cache.missing"));
+    });
+
+    bench_run("BeaconAddValue+RemoveValue", 0, 1, [&] {
+        BeaconAddValue("bench.cache.temporary", &value);
+        BeaconRemoveValue("bench.cache.temporary");
+    });
+
+    for (const std::string& key : keys) {
+        BeaconRemoveValue(key.c_str());
+    }
+}
+
+} // namespace
+
+int main()
+{
+    bench_data_api();
+    bench_format_api();
+    bench_output_api();
+    bench_value_api();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,260 @@
+#include <bench.hpp>
+#include <coff_writer.hpp>
+#include <loader.hpp>
+#include <parallel.hpp>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <resolver.hpp>
+
+//
+// Loader scaling benchmarks. Parse, layout and relocation only use the platform
+// independent loader core. Import resolution goes through resolve_object_symbol,
+// except for LIBRARY$Function imports outside of Windows, which use an
+// in-process lookup table instead.
+//
+// Objects above the --parallel-load thresholds are laid out and relocated a
+// second time with one thread per core (at least two), reported as "xN".
+//
+
+namespace {
+
+struct scenario {
+    const char*        name;
+    coff_writer_config config;
+};
+
+const scenario scenarios[] = {
+    //  name             sec   size     rel    sym    long   imp   beacon  bigobj
+    { "tiny",         {  1,  0x200,     16,     4,     0,     4,  true,  false } },
+    { "small",        {  4,  0x1000,    64,    16,     0,    16,  true,  false } },
+    { "medium",       { 16,  0x1000,   512,   128,     0,    64,  true,  false } },
+    { "large",        { 64,  0x4000,  2048,  1024,     0,   256,  false, false } },
+    { "huge",         { 256, 0x8000,  4096,  8192,     0,  1024,  false, false } },
+    { "long-names",   { 16,  0x1000,   512, 16384, 16384,    64,  false, false } },
+    { "bigobj",       { 256, 0x8000,  4096, 400000, 65536, 1024,  false, true  } },
+};
+
+uint32_t bench_parallel_threads() {
+    return std::max(2u, std::thread::hardware_concurrency());
+}
+
+void* bench_stub_resolver(const char* symbol) {
+    static std::unordered_map<std::string, void*> table;
+    static char slot;
+
+    auto [entry, inserted] = table.try_emplace(symbol, &slot);
+    return entry->second;
+}
+
+void* bench_noop_resolver(const char*) {
+    static char slot;
+    return &slot;
+}
+
+symbol_resolver bench_import_resolver(const coff_writer_config& config) {
+#ifdef _WIN32
+    return resolve_object_symbol;
+#else
+    return config.beacon_imports ? resolve_object_symbol : bench_stub_resolver;
+#endif
+}
+
+struct image {
+    std::unique_ptr<char[]>       memory;
+    char*                         base = nullptr;
+    std::vector<section_map>      sec_map;
+};
+
+void prepare_image(object_context& ctx, image& img) {
+    const uint64_t virtual_size = object_virtual_size(&ctx);
+
+    img.memory.reset(new char[virtual_size + SIZE_OF_PAGE]);
+    img.base = reinterpret_cast<char*>(PAGE_ALIGN(PTR_TO_U64(img.memory.get())));
+    img.sec_map.assign(ctx.section_count, section_map{});
+
+    ctx.sec_map = img.sec_map.data();
+    object_map_sections(&ctx, img.base);
+}
+
+bool emit_objects(const std::string& directory) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+
+    for (const scenario& s : scenarios) {
+        const coff_object object = coff_generate(s.config);
+        const std::filesystem::path path = std::filesystem::path(directory) / (std::string("synthetic-") + s.name + ".o");
+
+        std::ofstream out(path, std::ios::binary);
+        if (!out.write(object.data.data(), static_cast<std::streamsize>(object.data.size()))) {
+            std::cerr << "[!] ERROR, Failed to write: " << path.string() << std::endl;
+            return false;
+        }
+        std::cout << "[+] Wrote " << path.string() << " (" << coff_describe(s.config) << ")" << std::endl;
+    }
+
+    return true;
+}
+
+//
+// A synthetic relocation stream: count fixups of mixed types spread over an
+// image of size bytes, in section order or shuffled.
+//
+std::vector<object_fixup> fixup_stream(char* image, const size_t size, const size_t count, const bool shuffled)
+{
+    static const uint16_t types[] = {
+        IMAGE_REL_AMD64_REL32, IMAGE_REL_AMD64_REL32, IMAGE_REL_AMD64_REL32_4, IMAGE_REL_AMD64_ADDR64,
+        IMAGE_REL_AMD64_ADDR32NB, IMAGE_REL_AMD64_SECREL, IMAGE_REL_AMD64_SECTION,
+    };
+    std::vector<object_fixup> fixups(count);
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    const size_t stride = size / count;
+
+    for (size_t i = 0; i < count; i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+
+        object_fixup& fixup = fixups[i];
+        fixup.type         = types[(state >> 33) % (sizeof(types) / sizeof(types[0]))];
+        fixup.target       = PTR_TO_U64(image) + i * stride;
+        fixup.section_base = PTR_TO_U64(image);
+        fixup.symbol       = PTR_TO_U64(image) + (state >> 17) % size;
+        fixup.section      = 1;
+    }
+
+    for (size_t i = count; shuffled && i > 1; i--) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        std::swap(fixups[i - 1], fixups[(state >> 33) % i]);
+    }
+    return fixups;
+}
+
+void bench_fixups()
+{
+    for (const size_t count : { 1024, 16384, 262144 }) {
+        const size_t size = count * 16;
+        std::unique_ptr<char[]> image(new char[size]);
+
+        bench_print_header(("fixups (" + std::to_string(count) + " mixed relocations over "
+            + std::to_string(size / 1024) + " KiB)").c_str());
+
+        for (const bool shuffled : { false, true }) {
+            const std::vector<object_fixup> stream = fixup_stream(image.get(), size, count, shuffled);
+            std::vector<object_fixup> fixups;
+
+            //
+            // The image is cleared for every pass, so the addends stay zero
+            //
+            bench_run(shuffled ? "apply/shuffled" : "apply/in-order", size, count, [&] {
+                fixups = stream;
+                memset(image.get(), 0, size);
+                bench_do_not_optimize(object_apply_fixups(fixups.data(), fixups.size(), PTR_TO_U64(image.get())));
+            });
+
+            if (count < parallel_load_min_relocations) {
+                continue;
+            }
+
+            parallel_load_set_threads(bench_parallel_threads());
+            bench_run(std::string(shuffled ? "apply/shuffled" : "apply/in-order") + " x" + std::to_string(bench_parallel_threads()), size, count, [&] {
+                fixups = stream;
+                memset(image.get(), 0, size);
+                bench_do_not_optimize(object_apply_fixups(fixups.data(), fixups.size(), PTR_TO_U64(image.get())));
+            });
+            parallel_load_set_threads(0);
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc > 2 && strcmp(argv[1], "--emit") == 0) {
+        return emit_objects(argv[2]) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    for (const scenario& s : scenarios) {
+        coff_object object = coff_generate(s.config);
+        object_context ctx = {};
+        image img;
+
+        if (!object_parse(&ctx, object.data.data(), object.data.size())) {
+            std::cerr << "[!] ERROR, generated object failed to parse: " << s.name << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        prepare_image(ctx, img);
+        const uint64_t virtual_size = object_virtual_size(&ctx);
+
+        bench_print_header((std::string(s.name) + " (" + coff_describe(s.config) + ", "
+            + std::to_string(object.data.size()) + " bytes)").c_str());
+
+        bench_run("parse", object.data.size(), object.relocation_count + object.symbol_count, [&] {
+            object_context parsed = {};
+            bench_do_not_optimize(object_parse(&parsed, object.data.data(), object.data.size()));
+        });
+
+        bench_run("layout/virtual_size", 0, object.relocation_count, [&] {
+            bench_do_not_optimize(object_virtual_size(&ctx));
+        });
+
+        bench_run("layout/map_sections", virtual_size, s.config.sections, [&] {
+            object_map_sections(&ctx, img.base);
+            bench_do_not_optimize(ctx.sym_map);
+        });
+
+        //
+        // Every pass starts from freshly copied sections, addends would otherwise pile
+        // up until they overflow. Subtract layout/map_sections for the relocation cost.
+        //
+        bench_run("relocate", virtual_size, object.relocation_count, [&] {
+            object_map_sections(&ctx, img.base);
+            bench_do_not_optimize(process_object_sections(&ctx, bench_noop_resolver));
+        });
+
+        if (virtual_size >= parallel_load_min_bytes || object.relocation_count >= parallel_load_min_relocations) {
+            const std::string threads = " x" + std::to_string(bench_parallel_threads());
+            parallel_load_set_threads(bench_parallel_threads());
+
+            bench_run("layout/map_sections" + threads, virtual_size, s.config.sections, [&] {
+                object_map_sections(&ctx, img.base);
+                bench_do_not_optimize(ctx.sym_map);
+            });
+
+            bench_run("relocate" + threads, virtual_size, object.relocation_count, [&] {
+                object_map_sections(&ctx, img.base);
+                bench_do_not_optimize(process_object_sections(&ctx, bench_noop_resolver));
+            });
+
+            parallel_load_set_threads(0);
+        }
+
+        if (object.import_relocations == 0) {
+            continue;
+        }
+
+        //
+        // Resolution is interleaved with the relocation pass, so report it per
+        // import relocation on top of the relocation cost above.
+        //
+        const symbol_resolver resolve = bench_import_resolver(s.config);
+        if (!process_object_sections(&ctx, resolve)) {
+            std::cerr << "[!] ERROR, import resolution failed: " << s.name << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        bench_run("relocate+imports", virtual_size, object.import_relocations, [&] {
+            object_map_sections(&ctx, img.base);
+            bench_do_not_optimize(process_object_sections(&ctx, resolve));
+        });
+    }
+
+    bench_fixups();
+    return EXIT_SUCCESS;
+}
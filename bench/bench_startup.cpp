@@ -0,0 +1,328 @@
+#include <bench.hpp>
+#include <compat.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+//
+// Launch to exit latency of one-shot bof-exec runs on a trivial BOF, the way a
+// caller that starts one process per BOF sees it. Every variant is launched
+// BOF_BENCH_RUNS times (default 200) with its output going to the null device.
+// For comparison, the same BOF as BOF_BENCH_RUNS jobs of one --batch, in
+// process and with --fork (POSIX), timed per job the way bof-exec reports it.
+//
+// Usage: bench-startup [path to bof-exec]. The default is the bof-exec next to
+// this executable.
+//
+
+namespace {
+
+//
+// go() { BeaconOutput(0, "ok\n", 3); }
+//
+const uint8_t trivial_code[] = {
+    0x48, 0x83, 0xEC, 0x28,                     // sub  rsp, 0x28
+    0xB9, 0x00, 0x00, 0x00, 0x00,               // mov  ecx, 0
+    0x48, 0x8D, 0x15, 0x00, 0x00, 0x00, 0x00,   // lea  rdx, [rip + message]
+    0x41, 0xB8, 0x03, 0x00, 0x00, 0x00,         // mov  r8d, 3
+    0xFF, 0x15, 0x00, 0x00, 0x00, 0x00,         // call [rip + __imp_BeaconOutput]
+    0x48, 0x83, 0xC4, 0x28,                     // add  rsp, 0x28
+    0xC3,                                       // ret
+};
+
+const char trivial_message[] = "ok\n";
+
+template<typename T>
+void append(std::vector<char>& out, const T& value)
+{
+    out.insert(out.end(), reinterpret_cast<const char*>(&value), reinterpret_cast<const char*>(&value) + sizeof(T));
+}
+
+std::vector<char> trivial_object()
+{
+    const char import_name[] = "__imp_BeaconOutput";
+    const uint32_t code_offset     = sizeof(IMAGE_FILE_HEADER) + 2 * sizeof(IMAGE_SECTION_HEADER);
+    const uint32_t message_offset  = code_offset + sizeof(trivial_code);
+    const uint32_t reloc_offset    = message_offset + sizeof(trivial_message);
+    const uint32_t symbols_offset  = reloc_offset + 2 * sizeof(IMAGE_RELOCATION);
+
+    std::vector<char> out;
+
+    IMAGE_FILE_HEADER header = {};
+    header.Machine              = IMAGE_FILE_MACHINE_AMD64;
+    header.NumberOfSections     = 2;
+    header.PointerToSymbolTable = symbols_offset;
+    header.NumberOfSymbols      = 3;
+    append(out, header);
+
+    IMAGE_SECTION_HEADER text = {};
+    memcpy(text.Name, ".text", 5);
+    text.SizeOfRawData        = sizeof(trivial_code);
+    text.PointerToRawData     = code_offset;
+    text.PointerToRelocations = reloc_offset;
+    text.NumberOfRelocations  = 2;
+    text.Characteristics      = IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ;
+    append(out, text);
+
+    IMAGE_SECTION_HEADER rdata = {};
+    memcpy(rdata.Name, ".rdata", 6);
+    rdata.SizeOfRawData    = sizeof(trivial_message);
+    rdata.PointerToRawData = message_offset;
+    rdata.Characteristics  = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ;
+    append(out, rdata);
+
+    out.insert(out.end(), trivial_code, trivial_code + sizeof(trivial_code));
+    out.insert(out.end(), trivial_message, trivial_message + sizeof(trivial_message));
+
+    IMAGE_RELOCATION message_ref = {};
+    message_ref.VirtualAddress   = 12;
+    message_ref.SymbolTableIndex = 1;
+    message_ref.Type             = IMAGE_REL_AMD64_REL32;
+    append(out, message_ref);
+
+    IMAGE_RELOCATION import_ref = {};
+    import_ref.VirtualAddress   = 24;
+    import_ref.SymbolTableIndex = 2;
+    import_ref.Type             = IMAGE_REL_AMD64_REL32;
+    append(out, import_ref);
+
+    IMAGE_SYMBOL go = {};
+    memcpy(go.N.ShortName, "go", 2);
+    go.SectionNumber = 1;
+    go.Type          = 0x20; // function
+    go.StorageClass  = IMAGE_SYM_CLASS_EXTERNAL;
+    append(out, go);
+
+    IMAGE_SYMBOL section = {};
+    memcpy(section.N.ShortName, ".rdata", 6);
+    section.SectionNumber = 2;
+    section.StorageClass  = IMAGE_SYM_CLASS_STATIC;
+    append(out, section);
+
+    IMAGE_SYMBOL import = {};
+    import.N.Name.Long   = sizeof(uint32_t); // first string after the size
+    import.StorageClass  = IMAGE_SYM_CLASS_EXTERNAL;
+    append(out, import);
+
+    append(out, static_cast<uint32_t>(sizeof(uint32_t) + sizeof(import_name)));
+    out.insert(out.end(), import_name, import_name + sizeof(import_name));
+
+    return out;
+}
+
+uint32_t bench_runs()
+{
+    const char* env = std::getenv("BOF_BENCH_RUNS");
+    return env != nullptr && std::atoi(env) > 0 ? static_cast<uint32_t>(std::atoi(env)) : 200;
+}
+
+//
+// Runs the command line to completion with stdout and stderr discarded, or
+// stdout written to output. Returns the exit code, -1 if the process could not
+// be started.
+//
+int launch(const std::vector<std::string>& command, const std::string& output = "")
+{
+#ifdef _WIN32
+    std::string line;
+    for (const std::string& arg : command) {
+        line += (line.empty() ? "\"" : " \"") + arg + "\"";
+    }
+
+    SECURITY_ATTRIBUTES inherit = { sizeof(inherit), nullptr, TRUE };
+    HANDLE null_device = CreateFileA("NUL", GENERIC_WRITE, FILE_SHARE_WRITE, &inherit, OPEN_EXISTING, 0, nullptr);
+    HANDLE out_file = output.empty()
+        ? null_device
+        : CreateFileA(output.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &inherit, CREATE_ALWAYS, 0, nullptr);
+
+    STARTUPINFOA startup = {};
+    PROCESS_INFORMATION process = {};
+    startup.cb         = sizeof(startup);
+    startup.dwFlags    = STARTF_USESTDHANDLES;
+    startup.hStdOutput = out_file;
+    startup.hStdError  = null_device;
+
+    const BOOL started = CreateProcessA(nullptr, line.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startup, &process);
+    if (out_file != null_device) {
+        CloseHandle(out_file);
+    }
+    CloseHandle(null_device);
+    if (!started) {
+        return -1;
+    }
+
+    DWORD code = 0;
+    WaitForSingleObject(process.hProcess, INFINITE);
+    GetExitCodeProcess(process.hProcess, &code);
+    CloseHandle(process.hThread);
+    CloseHandle(process.hProcess);
+    return static_cast<int>(code);
+#else
+    std::vector<char*> argv;
+    for (const std::string& arg : command) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    if (output.empty()) {
+        posix_spawn_file_actions_adddup2(&actions, STDERR_FILENO, STDOUT_FILENO);
+    } else {
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    }
+
+    pid_t pid = 0;
+    const int spawned = posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (spawned != 0) {
+        return -1;
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+void print_samples(const std::string& name, std::vector<double>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (const double sample : samples) {
+        total += sample;
+    }
+
+    std::printf("%-44s %8zu %10.3f %10.3f %10.3f %10.3f\n",
+        name.c_str(),
+        samples.size(),
+        samples.front(),
+        samples[samples.size() / 2],
+        samples[samples.size() * 9 / 10],
+        total / static_cast<double>(samples.size()));
+}
+
+bool bench_launch(const std::string& name, const std::vector<std::string>& command)
+{
+    using clock = std::chrono::steady_clock;
+
+    const uint32_t runs = bench_runs();
+    std::vector<double> samples;
+
+    if (launch(command) != EXIT_SUCCESS) { // warm up the page cache, and check that it works at all
+        std::cerr << "[!] ERROR, " << name << " did not run the BOF successfully." << std::endl;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < runs; i++) {
+        const auto start = clock::now();
+        launch(command);
+        samples.push_back(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+    }
+
+    print_samples(name, samples);
+    return true;
+}
+
+//
+// Runs a --batch and collects the per job times it reports ("-> succeeded in <ms> ms"),
+// which is why it runs without --quiet
+//
+bool bench_batch(const std::string& name, const std::vector<std::string>& command, const std::filesystem::path& report)
+{
+    std::vector<double> samples;
+    std::string line;
+
+    if (launch(command, report.string()) != EXIT_SUCCESS) {
+        std::cerr << "[!] ERROR, " << name << " did not run every BOF successfully." << std::endl;
+        return false;
+    }
+
+    std::ifstream input(report);
+    while (std::getline(input, line)) {
+        const size_t at = line.find(" -> succeeded in ");
+        if (at != std::string::npos) {
+            samples.push_back(std::atof(line.c_str() + at + 17));
+        }
+    }
+
+    if (samples.empty()) {
+        std::cerr << "[!] ERROR, " << name << " reported no job times." << std::endl;
+        return false;
+    }
+
+    print_samples(name, samples);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::filesystem::path bof_exec = argc > 1
+        ? std::filesystem::path(argv[1])
+        : std::filesystem::absolute(argv[0]).parent_path() / "bof-exec";
+#ifdef _WIN32
+    if (argc <= 1) {
+        bof_exec.replace_extension(".exe");
+    }
+#endif
+
+    if (!std::filesystem::exists(bof_exec)) {
+        std::cerr << "[!] ERROR, bof-exec not found: " << bof_exec.string() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const std::filesystem::path object = std::filesystem::temp_directory_path() / "bof-bench-startup.o";
+    const std::vector<char> trivial = trivial_object();
+    std::ofstream(object, std::ios::binary).write(trivial.data(), static_cast<std::streamsize>(trivial.size()));
+
+    std::printf("\n== Launch to exit of %s on a trivial BOF (%zu bytes)\n", bof_exec.string().c_str(), trivial.size());
+    std::printf("%-44s %8s %10s %10s %10s %10s\n", "benchmark", "runs", "min ms", "median ms", "p90 ms", "mean ms");
+
+    const std::filesystem::path jobs   = std::filesystem::temp_directory_path() / "bof-bench-startup.jobs";
+    const std::filesystem::path report = std::filesystem::temp_directory_path() / "bof-bench-startup.out";
+    {
+        std::ofstream list(jobs);
+        for (uint32_t i = 0; i < bench_runs(); i++) {
+            list << object.string() << "\n";
+        }
+    }
+
+    bool succeeded =
+        bench_launch("bof-exec <object>", { bof_exec.string(), object.string() }) &&
+        bench_launch("bof-exec --quiet <object>", { bof_exec.string(), "--quiet", object.string() });
+
+    std::printf("\n== Per job, %u jobs of one --batch on one worker\n", bench_runs());
+    std::printf("%-44s %8s %10s %10s %10s %10s\n", "benchmark", "jobs", "min ms", "median ms", "p90 ms", "mean ms");
+
+    succeeded = succeeded &&
+        bench_batch("in process", { bof_exec.string(), "--workers", "1", "--batch", jobs.string() }, report);
+#ifndef _WIN32
+    succeeded = succeeded &&
+        bench_batch("--fork", { bof_exec.string(), "--fork", "--workers", "1", "--batch", jobs.string() }, report);
+#endif
+
+    std::error_code ec;
+    std::filesystem::remove(object, ec);
+    std::filesystem::remove(jobs, ec);
+    std::filesystem::remove(report, ec);
+    return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
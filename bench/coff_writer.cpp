@@ -0,0 +1,239 @@
+#include <coff_writer.hpp>
+#include <cstring>
+
+namespace {
+
+//
+// Real exports so that the generated objects also resolve on Windows.
+//
+const char* beacon_import_names[] = {
+    "BeaconOutput",        "BeaconPrintf",         "BeaconDataParse",   "BeaconDataInt",
+    "BeaconDataShort",     "BeaconDataLength",     "BeaconDataExtract", "BeaconFormatAlloc",
+    "BeaconFormatReset",   "BeaconFormatAppend",   "BeaconFormatPrintf", "BeaconFormatToString",
+    "BeaconFormatFree",    "BeaconFormatInt",
+};
+
+const char* library_import_names[] = {
+    "KERNEL32$GetLastError",     "KERNEL32$GetProcessHeap",   "KERNEL32$HeapAlloc",
+    "KERNEL32$HeapFree",         "KERNEL32$CloseHandle",      "KERNEL32$GetCurrentProcess",
+    "KERNEL32$FindFirstFileA",   "KERNEL32$FindNextFileA",    "KERNEL32$FindClose",
+    "KERNEL32$LocalFree",        "KERNEL32$GetTickCount",     "KERNEL32$Sleep",
+    "MSVCRT$calloc",             "MSVCRT$free",               "MSVCRT$strlen",
+    "MSVCRT$strcmp",             "MSVCRT$vsnprintf",          "MSVCRT$memcpy",
+};
+
+//
+// ClassID of ANON_OBJECT_HEADER_BIGOBJ
+//
+const BYTE big_object_class_id[16] = {
+    0xC7, 0xA1, 0xBA, 0xD1, 0xEE, 0xBA, 0xA9, 0x4B, 0xAF, 0x20, 0xFA, 0xF6, 0x6A, 0xA4, 0xDC, 0xB8,
+};
+
+template<typename T>
+void put(std::vector<char>& out, const size_t offset, const T& value) {
+    memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+void set_symbol_name(IMAGE_SYMBOL& symbol, const std::string& name, std::string& string_table) {
+    if (name.size() <= IMAGE_SIZEOF_SHORT_NAME) {
+        memcpy(symbol.N.ShortName, name.data(), name.size());
+        return;
+    }
+
+    symbol.N.Name.Short = 0;
+    symbol.N.Name.Long  = static_cast<DWORD>(string_table.size());
+    string_table.append(name);
+    string_table.push_back('\0');
+}
+
+} // namespace
+
+std::string coff_describe(const coff_writer_config& config) {
+    return "sec=" + std::to_string(config.sections)
+        + " rel=" + std::to_string(config.relocations)
+        + " sym=" + std::to_string(config.symbols)
+        + " imp=" + std::to_string(config.imports)
+        + (config.long_names ? " long=" + std::to_string(config.long_names) : "")
+        + (config.big_object ? " bigobj" : "");
+}
+
+coff_object coff_generate(const coff_writer_config& config) {
+
+    coff_object                         object;
+    std::vector<IMAGE_SYMBOL>           symbols;
+    std::string                         string_table(sizeof(uint32_t), '\0'); // size field, patched at the end
+    const uint32_t                      num_sections = config.sections ? config.sections : 1;
+    uint32_t                            section_size = config.section_size;
+    uint32_t                            first_import = 0;
+    const size_t                        header_size  = config.big_object ? sizeof(ANON_OBJECT_HEADER_BIGOBJ) : sizeof(IMAGE_FILE_HEADER);
+    const size_t                        symbol_size  = config.big_object ? sizeof(IMAGE_SYMBOL_EX) : sizeof(IMAGE_SYMBOL);
+
+    //------------------------------------------------------------//
+
+    //
+    // Every relocation gets its own 8 byte slot so ADDR64 fixups never overlap.
+    //
+    if (section_size < config.relocations * 8) {
+        section_size = config.relocations * 8;
+    }
+
+    //
+    // Section symbols (with one zeroed aux record each, like real compilers emit).
+    //
+    for (uint32_t i = 0; i < num_sections; i++) {
+        IMAGE_SYMBOL section_sym = {};
+        IMAGE_SYMBOL aux = {};
+
+        set_symbol_name(section_sym, i == 0 ? ".text" : ".data$" + std::to_string(i), string_table);
+        section_sym.SectionNumber      = static_cast<SHORT>(i + 1);
+        section_sym.StorageClass       = IMAGE_SYM_CLASS_STATIC;
+        section_sym.NumberOfAuxSymbols = 1;
+
+        symbols.push_back(section_sym);
+        symbols.push_back(aux);
+    }
+
+    //
+    // Entry point followed by filler function symbols spread over the sections.
+    //
+    {
+        IMAGE_SYMBOL entry = {};
+        set_symbol_name(entry, "go", string_table);
+        entry.SectionNumber = 1;
+        entry.Type          = IMAGE_SYM_DTYPE_FUNCTION << N_BTSHFT;
+        entry.StorageClass  = IMAGE_SYM_CLASS_EXTERNAL;
+        symbols.push_back(entry);
+    }
+
+    for (uint32_t i = 0; i < config.symbols; i++) {
+        IMAGE_SYMBOL fn = {};
+        const std::string name = i < config.long_names
+            ? "synthetic_helper_function_with_a_long_name_" + std::to_string(i)
+            : "f" + std::to_string(i);
+
+        set_symbol_name(fn, name, string_table);
+        fn.Value         = (i * 16) % section_size;
+        fn.SectionNumber = static_cast<SHORT>(1 + i % num_sections);
+        fn.Type          = IMAGE_SYM_DTYPE_FUNCTION << N_BTSHFT;
+        fn.StorageClass  = IMAGE_SYM_CLASS_EXTERNAL;
+        symbols.push_back(fn);
+    }
+
+    first_import = static_cast<uint32_t>(symbols.size());
+    for (uint32_t i = 0; i < config.imports; i++) {
+        IMAGE_SYMBOL imp = {};
+        const std::string name = config.beacon_imports
+            ? beacon_import_names[i % (sizeof(beacon_import_names) / sizeof(beacon_import_names[0]))]
+            : library_import_names[i % (sizeof(library_import_names) / sizeof(library_import_names[0]))];
+
+        set_symbol_name(imp, "__imp_" + name, string_table);
+        imp.StorageClass = IMAGE_SYM_CLASS_EXTERNAL;
+        symbols.push_back(imp);
+    }
+
+    //
+    // File layout: header, section table, raw data, relocations, symbols, strings.
+    //
+    const size_t raw_offset    = header_size + num_sections * sizeof(IMAGE_SECTION_HEADER);
+    const size_t reloc_offset  = raw_offset + INT_TO_U64(num_sections) * section_size;
+    const size_t sym_offset    = reloc_offset + INT_TO_U64(num_sections) * config.relocations * sizeof(IMAGE_RELOCATION);
+    const size_t string_offset = sym_offset + symbols.size() * symbol_size;
+
+    const auto string_size = static_cast<uint32_t>(string_table.size());
+    memcpy(string_table.data(), &string_size, sizeof(uint32_t));
+
+    object.data.assign(string_offset + string_table.size(), '\0');
+
+    if (config.big_object) {
+        ANON_OBJECT_HEADER_BIGOBJ header = {};
+        header.Sig1                 = IMAGE_FILE_MACHINE_UNKNOWN;
+        header.Sig2                 = 0xFFFF;
+        header.Version              = 2;
+        header.Machine              = IMAGE_FILE_MACHINE_AMD64;
+        header.NumberOfSections     = num_sections;
+        header.PointerToSymbolTable = static_cast<DWORD>(sym_offset);
+        header.NumberOfSymbols      = static_cast<DWORD>(symbols.size());
+        memcpy(&header.ClassID, big_object_class_id, sizeof(big_object_class_id));
+        put(object.data, 0, header);
+    } else {
+        IMAGE_FILE_HEADER header = {};
+        header.Machine              = IMAGE_FILE_MACHINE_AMD64;
+        header.NumberOfSections     = static_cast<WORD>(num_sections);
+        header.PointerToSymbolTable = static_cast<DWORD>(sym_offset);
+        header.NumberOfSymbols      = static_cast<DWORD>(symbols.size());
+        put(object.data, 0, header);
+    }
+
+    for (uint32_t i = 0; i < num_sections; i++) {
+        IMAGE_SECTION_HEADER section = {};
+        const char* name = i == 0 ? ".text" : ".data";
+
+        memcpy(section.Name, name, strlen(name));
+        section.SizeOfRawData        = section_size;
+        section.PointerToRawData     = static_cast<DWORD>(raw_offset + INT_TO_U64(i) * section_size);
+        section.PointerToRelocations = static_cast<DWORD>(reloc_offset + INT_TO_U64(i) * config.relocations * sizeof(IMAGE_RELOCATION));
+        section.NumberOfRelocations  = static_cast<WORD>(config.relocations);
+        section.Characteristics      = i == 0
+            ? IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ | IMAGE_SCN_ALIGN_16BYTES
+            : IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE | IMAGE_SCN_ALIGN_16BYTES;
+
+        put(object.data, header_size + i * sizeof(IMAGE_SECTION_HEADER), section);
+        memset(object.data.data() + section.PointerToRawData, i == 0 ? 0xCC : 0x00, section_size);
+
+        //
+        // Cycle through REL32 against imports (only in code), REL32/REL32_4
+        // against other sections, and ADDR64 against other sections.
+        //
+        for (uint32_t j = 0; j < config.relocations; j++) {
+            IMAGE_RELOCATION relocation = {};
+            const uint32_t target_section = (i + j + 1) % num_sections;
+
+            relocation.VirtualAddress   = j * 8;
+            relocation.SymbolTableIndex = target_section * 2;
+
+            switch (j % 4) {
+            case 0:
+                if (config.imports && i == 0) {
+                    relocation.SymbolTableIndex = first_import + (j / 4) % config.imports;
+                    object.import_relocations++;
+                }
+                relocation.Type = IMAGE_REL_AMD64_REL32;
+                break;
+            case 1:
+                relocation.Type = IMAGE_REL_AMD64_REL32;
+                break;
+            case 2:
+                relocation.Type = IMAGE_REL_AMD64_REL32_4;
+                break;
+            default:
+                relocation.Type = IMAGE_REL_AMD64_ADDR64;
+                break;
+            }
+
+            put(object.data, section.PointerToRelocations + j * sizeof(IMAGE_RELOCATION), relocation);
+            object.relocation_count++;
+        }
+    }
+
+    if (config.big_object) {
+        //
+        // Same records, widened. The only aux records are zeroed, so they stay zeroed.
+        //
+        for (size_t i = 0; i < symbols.size(); i++) {
+            IMAGE_SYMBOL_EX symbol = {};
+            memcpy(&symbol.N, &symbols[i].N, sizeof(symbol.N));
+            symbol.Value              = symbols[i].Value;
+            symbol.SectionNumber      = symbols[i].SectionNumber;
+            symbol.Type               = symbols[i].Type;
+            symbol.StorageClass       = symbols[i].StorageClass;
+            symbol.NumberOfAuxSymbols = symbols[i].NumberOfAuxSymbols;
+            put(object.data, sym_offset + i * sizeof(IMAGE_SYMBOL_EX), symbol);
+        }
+    } else {
+        memcpy(object.data.data() + sym_offset, symbols.data(), symbols.size() * sizeof(IMAGE_SYMBOL));
+    }
+    memcpy(object.data.data() + string_offset, string_table.data(), string_table.size());
+
+    object.symbol_count = static_cast<uint32_t>(symbols.size());
+    return object;
+}
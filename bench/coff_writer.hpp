@@ -0,0 +1,36 @@
+#ifndef COFF_WRITER_HPP
+#define COFF_WRITER_HPP
+#include <compat.hpp>
+#include <macro.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// Generates synthetic AMD64 COFF objects for benchmarking the loader.
+// The output is structurally valid (it passes object_parse and can be laid out
+// and relocated), but the section contents are filler and must never be executed.
+//
+
+struct coff_writer_config {
+    uint32_t sections       = 4;      // number of sections, the first one is code
+    uint32_t section_size   = 0x1000; // raw size of each section (grown to fit relocations)
+    uint32_t relocations    = 64;     // relocations per section (at most 0xFFFF)
+    uint32_t symbols        = 16;     // function symbols in addition to "go"
+    uint32_t long_names     = 0;      // how many of those get names longer than 8 bytes
+    uint32_t imports        = 8;      // distinct "__imp_" symbols
+    bool     beacon_imports = true;   // import Beacon API functions instead of LIBRARY$Function exports
+    bool     big_object     = false;  // ANON_OBJECT_HEADER_BIGOBJ and IMAGE_SYMBOL_EX, like /bigobj
+};
+
+struct coff_object {
+    std::vector<char> data;
+    uint32_t          relocation_count = 0; // total, across all sections
+    uint32_t          import_relocations = 0; // relocations against "__imp_" symbols
+    uint32_t          symbol_count = 0;
+};
+
+coff_object coff_generate(const coff_writer_config& config);
+std::string coff_describe(const coff_writer_config& config);
+
+#endif //COFF_WRITER_HPP
@@ -0,0 +1,48 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+#include <compat.hpp>
+#include <cstddef>
+#include <cstdint>
+
+//
+// Per-execution heap arena (opt-in). With it enabled the resolver binds the usual
+// allocation imports (KERNEL32$HeapAlloc, MSVCRT$malloc, ... and malloc & co. for
+// ELF objects) to a bump allocator owned by the executing thread. Everything a job
+// leaves allocated is reclaimed in one go by arena_end().
+//
+
+struct arena_stats {
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t peak_bytes;            // most bytes live at once
+    uint64_t leaked_allocations;    // still live when the job ended, reclaimed
+    uint64_t leaked_bytes;
+};
+
+void        arena_set_enabled(bool enabled);
+bool        arena_enabled();
+
+void        arena_begin();      // start of a job on this thread
+arena_stats arena_end();        // end of the job: reclaims its memory
+
+//
+// Values in the BeaconAddValue store may point into the arena. The chunk such
+// a value points into is pinned: arena_end() leaves it alone, and it is freed
+// once every value pointing into it was unpinned (BeaconRemoveValue). Pointers
+// outside of any arena chunk are ignored.
+//
+void        arena_pin(const void* ptr);
+void        arena_unpin(const void* ptr);
+void        arena_fork_prepare();   // pin_lock around fork(), see platform_at_fork
+void        arena_fork_parent();
+void        arena_fork_child();
+
+//
+// Arena versions of allocation imports, nullptr if the function is not one.
+// arena_import takes a LIBRARY$Function pair (Windows x64 calling convention),
+// arena_sysv_import a plain symbol name of an ELF object.
+//
+void*       arena_import(const char* library, const char* function);
+void*       arena_sysv_import(const char* function);
+
+#endif //ARENA_HPP
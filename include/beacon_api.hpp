@@ -1,13 +1,44 @@
 #ifndef BEACON_API_HPP
 #define BEACON_API_HPP
-#include <Windows.h>
+#include <compat.hpp>
+#include <cstdint>
+#include <cstdarg>
+#include <cstdio>
 #include <string>
+#include <atomic>
+#include <mutex>
 
 #define CALLBACK_OUTPUT      0x0
 #define CALLBACK_OUTPUT_OEM  0x1e
 #define CALLBACK_OUTPUT_UTF8 0x20
 #define CALLBACK_ERROR       0x0d
 
+//
+// Varargs Beacon functions are called with the Windows x64 convention. Outside of
+// Windows that means an ms_abi va_list, which the C library cannot consume, so
+// formatting goes through bof_vsnprintf (src/beacon_format.cpp) instead.
+//
+#if defined(_WIN32) || !BOF_NATIVE_EXECUTION
+typedef va_list bof_va_list;
+#define bof_va_start(ap, last) va_start(ap, last)
+#define bof_va_end(ap)         va_end(ap)
+#define bof_vsnprintf          vsnprintf
+#else
+typedef __builtin_ms_va_list bof_va_list;
+#define bof_va_start(ap, last) __builtin_ms_va_start(ap, last)
+#define bof_va_end(ap)         __builtin_ms_va_end(ap)
+int bof_vsnprintf(char* buffer, size_t size, const char* fmt, bof_va_list args);
+#endif
+
+//
+// BOFs are compiled with a 16 bit wchar_t.
+//
+#ifdef _WIN32
+typedef wchar_t bof_wchar;
+#else
+typedef char16_t bof_wchar;
+#endif
+
 /* Structs */
 typedef struct {
     char* original; /* the original buffer [so we can free it] */
@@ -24,47 +55,85 @@ typedef struct {
 } formatp;
 
 /* Beacon Data */
-void    BeaconDataParse(datap* parser, char* buffer, int size);
-int     BeaconDataInt(datap* parser);
-short   BeaconDataShort(datap* parser);
-int     BeaconDataLength(datap* parser);
-char*   BeaconDataExtract(datap* parser, int* size);
+void    BOF_API BeaconDataParse(datap* parser, char* buffer, int size);
+int     BOF_API BeaconDataInt(datap* parser);
+short   BOF_API BeaconDataShort(datap* parser);
+int     BOF_API BeaconDataLength(datap* parser);
+char*   BOF_API BeaconDataExtract(datap* parser, int* size);
 
 /* Beacon Format */
-void    BeaconFormatAlloc(formatp* format, int maxsz);
-void    BeaconFormatReset(formatp* format);
-void    BeaconFormatAppend(formatp* format, char* text, int len);
-void    BeaconFormatPrintf(formatp* format, char* fmt, ...);
-char*   BeaconFormatToString(formatp* format, int* size);
-void    BeaconFormatFree(formatp* format);
-void    BeaconFormatInt(formatp* format, int value);
+void    BOF_API BeaconFormatAlloc(formatp* format, int maxsz);
+void    BOF_API BeaconFormatReset(formatp* format);
+void    BOF_API BeaconFormatAppend(formatp* format, char* text, int len);
+void    BOF_API BeaconFormatPrintf(formatp* format, char* fmt, ...);
+char*   BOF_API BeaconFormatToString(formatp* format, int* size);
+void    BOF_API BeaconFormatFree(formatp* format);
+void    BOF_API BeaconFormatInt(formatp* format, int value);
 
 /* Output */
-void BeaconOutput(int type, char* data, int len);
-void BeaconPrintf(int type, char* fmt, ...);
+void BOF_API BeaconOutput(int type, char* data, int len);
+void BOF_API BeaconPrintf(int type, char* fmt, ...);
 
 /* Misc */
-BOOL BeaconIsAdmin();
-BOOL BeaconUseToken(HANDLE token);
-void BeaconRevertToken();
-BOOL toWideChar(char* src, wchar_t* dst, int max);
+BOOL BOF_API BeaconIsAdmin();
+BOOL BOF_API BeaconUseToken(HANDLE token);
+void BOF_API BeaconRevertToken();
+BOOL BOF_API toWideChar(char* src, bof_wchar* dst, int max);
+BOOL BOF_API BeaconIsCancelled(); // TRUE once the job ran out of time, long running BOFs should return early
+
+/* Key/value store, shared by every job of the process */
+BOOL  BOF_API BeaconAddValue(const char* key, void* ptr);  // FALSE if key is already in use
+void* BOF_API BeaconGetValue(const char* key);             // nullptr if key is not in use
+BOOL  BOF_API BeaconRemoveValue(const char* key);          // FALSE if key was not in use
 
 /* Fork & run / process injection */
-void   BeaconGetSpawnTo(BOOL x86, char* buffer, int length);
-BOOL   BeaconSpawnTemporaryProcess(BOOL x86, BOOL ignoreToken, STARTUPINFO* si, PROCESS_INFORMATION* pInfo);
-void   BeaconInjectTemporaryProcess(PROCESS_INFORMATION* pInfo, char* payload, int p_len, int p_offset, char* arg, int a_len);
-void   BeaconInjectProcess(HANDLE hProc, int pid, char* payload, int p_len, int p_offset, char* arg, int a_len);
-void   BeaconCleanupProcess(PROCESS_INFORMATION* pInfo);
+void   BOF_API BeaconGetSpawnTo(BOOL x86, char* buffer, int length);
+BOOL   BOF_API BeaconSpawnTemporaryProcess(BOOL x86, BOOL ignoreToken, STARTUPINFO* si, PROCESS_INFORMATION* pInfo);
+void   BOF_API BeaconInjectTemporaryProcess(PROCESS_INFORMATION* pInfo, char* payload, int p_len, int p_offset, char* arg, int a_len);
+void   BOF_API BeaconInjectProcess(HANDLE hProc, int pid, char* payload, int p_len, int p_offset, char* arg, int a_len);
+void   BOF_API BeaconCleanupProcess(PROCESS_INFORMATION* pInfo);
 
 /* Internal */
 void manip_beacon_output(char* str, bool clear, bool get, std::string* out);
-void manip_token(_In_ bool clear, _In_ HANDLE token, _Out_ HANDLE* out);
 std::string get_beacon_output();
 void clear_beacon_output();
+size_t beacon_output_capacity(); // bytes allocated for this thread's output buffer
 HANDLE get_curr_token();
 void clear_curr_token();
 void set_curr_token(HANDLE token);
 uint32_t swap_endianess(uint32_t indata);
-size_t char_to_wide_impl(wchar_t* dest, char* src, size_t max_allowed);
+size_t char_to_wide_impl(bof_wchar* dest, char* src, size_t max_allowed);
+void set_beacon_cancel_flag(const std::atomic<bool>* flag); // per thread, nullptr for none
+const std::atomic<bool>* get_beacon_cancel_flag();
+void set_beacon_output_sink(void (*sink)(const char* data, size_t size)); // per thread, nullptr buffers output as usual
+
+//
+// Per thread: buffer output in *buffer, under *lock if given, so another thread
+// can take it over from a job that never returns. nullptr for the thread's own.
+//
+void set_beacon_output_buffer(std::string* buffer, std::mutex* lock);
+
+//
+// --fork: the key/value store around fork() (platform_at_fork). A child warns
+// once that the values it stores die with it.
+//
+void beacon_fork_prepare();
+void beacon_fork_parent();
+void beacon_fork_child();
+
+//
+// Name to function tables of the Beacon API are plain arrays sorted by name
+// (strcmp order), constant initialised, and searched with a binary search.
+//
+struct beacon_api_entry {
+    const char* name;
+    void*       address;
+};
+
+void* beacon_api_find(const beacon_api_entry* table, size_t count, const char* name);
+
+#if BOF_ELF_SUPPORT
+void* beacon_sysv_function(const char* name); // System V entry points for ELF objects
+#endif
 
 #endif //BEACON_API_HPP
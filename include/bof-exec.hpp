@@ -1,6 +1,6 @@
 #ifndef BOF_EXEC_HPP
 #define BOF_EXEC_HPP
-#include <Windows.h>
+#include <compat.hpp>
 #include <iostream>
 #include <string>
 #include <optional>
@@ -8,9 +8,33 @@
 #include <csignal>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <charconv>
+#include <iomanip>
+#include <thread>
 #include <beacon_api.hpp>
 #include <structs.hpp>
 #include <macro.hpp>
 #include <util.hpp>
+#include <loader.hpp>
+#include <resolver.hpp>
+#include <platform.hpp>
+#include <executor.hpp>
+#include <arena.hpp>
+#include <runner.hpp>
+#include <inspect.hpp>
+#include <catalog.hpp>
+#include <linker.hpp>
+#include <perf.hpp>
+#include <footprint.hpp>
+#include <trace.hpp>
+#include <metrics.hpp>
+#include <parallel.hpp>
+#include <cstdlib>
+#include <cstring>
+
+#if BOF_ELF_SUPPORT
+#include <elf_loader.hpp>
+#endif
 
 #endif //BOF_EXEC_HPP
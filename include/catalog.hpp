@@ -0,0 +1,126 @@
+#ifndef CATALOG_HPP
+#define CATALOG_HPP
+#include <util.hpp>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//
+// Content-addressed BOF catalog. A catalog directory holds:
+//   objects/<sha256>.o   every ingested object, stored once per content hash
+//   index.bin            name -> hash -> metadata, memory-mapped for lookups
+//
+// The index is a single flat file: a header, an open addressing hash table of
+// names, fixed size records, section records, string references and a string
+// pool. A lookup hashes the name and probes the mapped table, nothing else is
+// read. The index is rewritten (to a temporary file, then renamed over the old
+// one) whenever objects are added.
+//
+
+constexpr uint32_t catalog_magic   = 0x43464F42; // "BOFC"
+constexpr uint32_t catalog_version = 1;
+
+enum catalog_format : uint32_t {
+    CATALOG_COFF,
+    CATALOG_ELF,
+};
+
+enum catalog_flags : uint32_t {
+    CATALOG_LOADABLE = 1,   // passed the --inspect checks when it was added
+};
+
+struct catalog_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_count;
+    uint32_t bucket_count;      // power of two, at most half full
+    uint64_t buckets_offset;    // uint32_t per bucket: record index + 1, 0 if empty
+    uint64_t records_offset;    // catalog_record[record_count]
+    uint64_t sections_offset;   // catalog_section[]
+    uint32_t section_count;
+    uint32_t reference_count;
+    uint64_t references_offset; // uint32_t string offsets (imports, entry points)
+    uint64_t strings_offset;    // null terminated strings
+    uint64_t strings_size;
+};
+
+struct catalog_record {
+    uint64_t name_hash;
+    uint32_t name;              // string offset
+    uint32_t format;            // catalog_format
+    uint8_t  hash[32];          // SHA-256 of the object file
+    uint64_t file_size;
+    uint64_t virtual_size;
+    uint64_t import_offset;     // start of the import slots in the image
+    uint32_t first_section;
+    uint32_t section_count;
+    uint32_t first_import;      // into the references
+    uint32_t import_count;
+    uint32_t first_entry_point; // into the references
+    uint32_t entry_point_count;
+    uint32_t flags;             // catalog_flags
+    uint32_t reserved;
+};
+
+//
+// One planned section: where the loader places it and how large it is.
+//
+struct catalog_section {
+    uint32_t name;              // string offset
+    uint32_t relocations;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t flags;             // COFF characteristics or ELF sh_flags
+};
+
+class catalog {
+    std::string                 root_;
+    mapped_file                 index_;
+    const catalog_header*       header_     = nullptr;
+    const uint32_t*             buckets_    = nullptr;
+    const catalog_record*       records_    = nullptr;
+    const catalog_section*      sections_   = nullptr;
+    const uint32_t*             references_ = nullptr;
+    const char*                 strings_    = nullptr;
+
+    bool valid(const catalog_record& record) const;
+
+public:
+    //
+    // Maps the index of the catalog at root. A catalog without an index yet is
+    // simply empty, a malformed index is an error.
+    //
+    static std::optional<catalog> open(const std::string& root);
+
+    //
+    // Both return null for records that point outside of the index.
+    //
+    const catalog_record* find(std::string_view name) const;
+    const catalog_record* at(uint32_t index) const;
+
+    uint32_t              size() const { return header_ ? header_->record_count : 0; }
+    const char*           string(uint32_t offset) const { return strings_ + offset; }
+    const catalog_section& section(const catalog_record& record, uint32_t index) const { return sections_[record.first_section + index]; }
+    const char*           import(const catalog_record& record, uint32_t index) const { return string(references_[record.first_import + index]); }
+    const char*           entry_point(const catalog_record& record, uint32_t index) const { return string(references_[record.first_entry_point + index]); }
+    std::string           object_path(const catalog_record& record) const;
+    const std::string&    root() const { return root_; }
+};
+
+std::string catalog_hash_string(const uint8_t hash[32]);
+
+//
+// Ingests an object file, or every .o/.obj below a directory, into the catalog
+// at root. Objects are named after their file name without the extension, and
+// adding a name that already exists points it at the new content.
+//
+bool catalog_add(const std::string& root, const std::vector<std::string>& paths);
+
+//
+// One line per cataloged object.
+//
+void catalog_list(const catalog& cat, std::ostream& out);
+
+#endif //CATALOG_HPP
@@ -0,0 +1,228 @@
+#ifndef COMPAT_HPP
+#define COMPAT_HPP
+
+//
+// On Windows this is just <Windows.h>. Everywhere else we provide the handful of
+// base types and PE/COFF structures the loader core uses, with the same names and
+// layouts as winnt.h, so the parsing/layout/relocation code compiles unchanged.
+//
+
+//
+// BOF_API is the calling convention of code compiled for Windows x64. BOFs call the
+// Beacon API and their entry point through it, so outside of Windows those functions
+// need the ms_abi attribute. BOF_NATIVE_EXECUTION is set where BOF code can run at all.
+//
+#if defined(_WIN32)
+#define BOF_API
+#define BOF_NATIVE_EXECUTION 1
+#elif defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BOF_API __attribute__((ms_abi))
+#define BOF_NATIVE_EXECUTION 1
+#else
+#define BOF_API
+#define BOF_NATIVE_EXECUTION 0
+#endif
+
+//
+// ELF relocatable objects (src/elf_loader.cpp) are loaded on x86-64 Linux only.
+//
+#if defined(__linux__) && defined(__x86_64__)
+#define BOF_ELF_SUPPORT 1
+#else
+#define BOF_ELF_SUPPORT 0
+#endif
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cstdint>
+#include <cstddef>
+
+#define _In_
+#define _Out_
+#define _Inout_
+#define _In_opt_
+#define _Out_opt_
+
+#ifndef TRUE
+#define TRUE  1
+#define FALSE 0
+#endif
+
+typedef uint8_t   BYTE;
+typedef uint16_t  WORD;
+typedef uint32_t  DWORD;
+typedef int16_t   SHORT;
+typedef int32_t   LONG;
+typedef uint32_t  ULONG;
+typedef uint32_t  UINT32;
+typedef uint64_t  ULONG_PTR;
+typedef int32_t   BOOL;
+typedef void*     PVOID;
+typedef void*     HANDLE;
+typedef DWORD*    PDWORD;
+
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+
+/* only ever passed through by pointer */
+typedef struct _STARTUPINFOA STARTUPINFO;
+
+typedef struct _PROCESS_INFORMATION {
+    HANDLE  hProcess;
+    HANDLE  hThread;
+    DWORD   dwProcessId;
+    DWORD   dwThreadId;
+} PROCESS_INFORMATION, *LPPROCESS_INFORMATION;
+
+#define IMAGE_FILE_MACHINE_UNKNOWN  0
+#define IMAGE_FILE_MACHINE_I386     0x014c
+#define IMAGE_FILE_MACHINE_AMD64    0x8664
+#define IMAGE_SIZEOF_SHORT_NAME     8
+#define IMAGE_SIZEOF_SYMBOL         18
+#define IMAGE_SIZEOF_SYMBOL_EX      20
+
+#pragma pack(push, 4)
+typedef struct _IMAGE_FILE_HEADER {
+    WORD    Machine;
+    WORD    NumberOfSections;
+    DWORD   TimeDateStamp;
+    DWORD   PointerToSymbolTable;
+    DWORD   NumberOfSymbols;
+    WORD    SizeOfOptionalHeader;
+    WORD    Characteristics;
+} IMAGE_FILE_HEADER, *PIMAGE_FILE_HEADER;
+
+typedef struct ANON_OBJECT_HEADER_BIGOBJ {
+    WORD    Sig1;               // IMAGE_FILE_MACHINE_UNKNOWN
+    WORD    Sig2;               // 0xffff
+    WORD    Version;            // >= 2
+    WORD    Machine;
+    DWORD   TimeDateStamp;
+    BYTE    ClassID[16];        // CLSID in winnt.h
+    DWORD   SizeOfData;
+    DWORD   Flags;
+    DWORD   MetaDataSize;
+    DWORD   MetaDataOffset;
+    DWORD   NumberOfSections;
+    DWORD   PointerToSymbolTable;
+    DWORD   NumberOfSymbols;
+} ANON_OBJECT_HEADER_BIGOBJ;
+
+typedef struct _IMAGE_SECTION_HEADER {
+    BYTE    Name[IMAGE_SIZEOF_SHORT_NAME];
+    union {
+        DWORD   PhysicalAddress;
+        DWORD   VirtualSize;
+    } Misc;
+    DWORD   VirtualAddress;
+    DWORD   SizeOfRawData;
+    DWORD   PointerToRawData;
+    DWORD   PointerToRelocations;
+    DWORD   PointerToLinenumbers;
+    WORD    NumberOfRelocations;
+    WORD    NumberOfLinenumbers;
+    DWORD   Characteristics;
+} IMAGE_SECTION_HEADER, *PIMAGE_SECTION_HEADER;
+#pragma pack(pop)
+
+#pragma pack(push, 2)
+typedef struct _IMAGE_SYMBOL {
+    union {
+        BYTE    ShortName[8];
+        struct {
+            DWORD   Short;
+            DWORD   Long;
+        } Name;
+        DWORD   LongName[2];
+    } N;
+    DWORD   Value;
+    SHORT   SectionNumber;
+    WORD    Type;
+    BYTE    StorageClass;
+    BYTE    NumberOfAuxSymbols;
+} IMAGE_SYMBOL, *PIMAGE_SYMBOL;
+
+typedef struct _IMAGE_SYMBOL_EX {
+    union {
+        BYTE    ShortName[8];
+        struct {
+            DWORD   Short;
+            DWORD   Long;
+        } Name;
+        DWORD   LongName[2];
+    } N;
+    DWORD   Value;
+    LONG    SectionNumber;
+    WORD    Type;
+    BYTE    StorageClass;
+    BYTE    NumberOfAuxSymbols;
+} IMAGE_SYMBOL_EX, *PIMAGE_SYMBOL_EX;
+
+typedef struct _IMAGE_RELOCATION {
+    union {
+        DWORD   VirtualAddress;
+        DWORD   RelocCount;
+    };
+    DWORD   SymbolTableIndex;
+    WORD    Type;
+} IMAGE_RELOCATION, *PIMAGE_RELOCATION;
+#pragma pack(pop)
+
+static_assert(sizeof(IMAGE_FILE_HEADER) == 20, "IMAGE_FILE_HEADER layout");
+static_assert(sizeof(IMAGE_SECTION_HEADER) == 40, "IMAGE_SECTION_HEADER layout");
+static_assert(sizeof(ANON_OBJECT_HEADER_BIGOBJ) == 56, "ANON_OBJECT_HEADER_BIGOBJ layout");
+static_assert(sizeof(IMAGE_SYMBOL) == IMAGE_SIZEOF_SYMBOL, "IMAGE_SYMBOL layout");
+static_assert(sizeof(IMAGE_SYMBOL_EX) == IMAGE_SIZEOF_SYMBOL_EX, "IMAGE_SYMBOL_EX layout");
+static_assert(sizeof(IMAGE_RELOCATION) == 10, "IMAGE_RELOCATION layout");
+
+/* Section characteristics */
+#define IMAGE_SCN_CNT_CODE                  0x00000020
+#define IMAGE_SCN_CNT_INITIALIZED_DATA      0x00000040
+#define IMAGE_SCN_CNT_UNINITIALIZED_DATA    0x00000080
+#define IMAGE_SCN_LNK_INFO                  0x00000200
+#define IMAGE_SCN_LNK_REMOVE                0x00000800
+#define IMAGE_SCN_ALIGN_16BYTES             0x00500000
+#define IMAGE_SCN_LNK_NRELOC_OVFL           0x01000000
+#define IMAGE_SCN_MEM_DISCARDABLE           0x02000000
+#define IMAGE_SCN_MEM_EXECUTE               0x20000000
+#define IMAGE_SCN_MEM_READ                  0x40000000
+#define IMAGE_SCN_MEM_WRITE                 0x80000000
+
+/* Symbols */
+#define IMAGE_SYM_UNDEFINED                 0
+#define IMAGE_SYM_ABSOLUTE                  (-1)
+#define IMAGE_SYM_DEBUG                     (-2)
+#define IMAGE_SYM_TYPE_NULL                 0x0000
+#define IMAGE_SYM_DTYPE_NULL                0
+#define IMAGE_SYM_DTYPE_FUNCTION            2
+#define IMAGE_SYM_CLASS_EXTERNAL            0x0002
+#define IMAGE_SYM_CLASS_STATIC              0x0003
+#define IMAGE_SYM_CLASS_LABEL               0x0006
+#define IMAGE_SYM_CLASS_FILE                0x0067
+
+#define N_BTMASK                            0x000F
+#define N_TMASK                             0x0030
+#define N_BTSHFT                            4
+#define ISFCN(x) (((x) & N_TMASK) == (IMAGE_SYM_DTYPE_FUNCTION << N_BTSHFT))
+
+/* AMD64 relocation types */
+#define IMAGE_REL_AMD64_ABSOLUTE            0x0000
+#define IMAGE_REL_AMD64_ADDR64              0x0001
+#define IMAGE_REL_AMD64_ADDR32              0x0002
+#define IMAGE_REL_AMD64_ADDR32NB            0x0003
+#define IMAGE_REL_AMD64_REL32               0x0004
+#define IMAGE_REL_AMD64_REL32_1             0x0005
+#define IMAGE_REL_AMD64_REL32_2             0x0006
+#define IMAGE_REL_AMD64_REL32_3             0x0007
+#define IMAGE_REL_AMD64_REL32_4             0x0008
+#define IMAGE_REL_AMD64_REL32_5             0x0009
+#define IMAGE_REL_AMD64_SECTION             0x000A
+#define IMAGE_REL_AMD64_SECREL              0x000B
+#define IMAGE_REL_AMD64_SECREL7             0x000C
+#define IMAGE_REL_AMD64_TOKEN               0x000D
+#define IMAGE_REL_AMD64_SREL32              0x000E
+#define IMAGE_REL_AMD64_PAIR                0x000F
+#define IMAGE_REL_AMD64_SSPAN32             0x0010
+
+#endif //_WIN32
+#endif //COMPAT_HPP
@@ -0,0 +1,54 @@
+#ifndef ELF_LOADER_HPP
+#define ELF_LOADER_HPP
+#include <loader.hpp>
+#include <elf.h>
+
+//
+// ELF64 x86-64 relocatable object (ET_REL) counterpart of the COFF loader core.
+// Sections are laid out the same way (page aligned, followed by the import area),
+// and undefined symbols go through a symbol_resolver.
+//
+
+//
+// Every relocation against an undefined symbol, and every GOT relative relocation,
+// gets one of these in the import area: the resolved address, followed by a
+// "jmp [rip - 14]" stub for calls that need to reach it with a 32 bit displacement.
+//
+struct elf_import_entry {
+    uint64_t address;
+    uint8_t  stub[8];
+};
+
+struct elf_context {
+    union {
+        ULONG_PTR   base;
+        Elf64_Ehdr* header;
+    };
+
+    size_t              size;
+    Elf64_Shdr*         sections;
+    Elf64_Sym*          sym_table;
+    size_t              sym_count;
+    const char*         str_table;
+    size_t              str_size;
+    section_map*        sec_map;    // one entry per section header, unallocated sections stay null
+    elf_import_entry*   imports;
+    size_t              import_count; // entries filled in by elf_process_relocations
+};
+
+bool        elf_parse(elf_context* ctx, void* pobject, size_t object_size);
+const char* elf_symbol_name(const elf_context* ctx, const Elf64_Sym* symbol);
+uint64_t    elf_virtual_size(elf_context* ctx);
+void        elf_map_sections(elf_context* ctx, void* virtual_addr);
+bool        elf_process_relocations(elf_context* ctx, symbol_resolver resolve);
+bool        elf_relocation_supported(uint32_t type);
+void*       elf_find_function(elf_context* ctx, const char* name);
+const Elf64_Sym* elf_nearest_symbol(const elf_context* ctx, uint64_t address, uint64_t* offset);
+
+//
+// Same rules as object_protection_plan. Every import entry has a stub, so the
+// import area is read/execute as soon as it has one.
+//
+std::vector<protection_range> elf_protection_plan(const elf_context* ctx, void* image, uint64_t image_size);
+
+#endif //ELF_LOADER_HPP
@@ -0,0 +1,65 @@
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+#include <platform.hpp>
+#include <util.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// An image kept mapped between loads of the same BOF (--watch). The next load
+// reuses the allocation if the layout is the same (same format, section sizes
+// and image size) and only relays out the object if it is not.
+//
+struct loaded_image {
+    void*                   address = nullptr;
+    uint64_t                size = 0;
+    std::vector<uint64_t>   layout;         // format, then every section size
+    bool                    reused = false; // whether the last load kept the layout
+
+    loaded_image() = default;
+    loaded_image(const loaded_image&) = delete;
+    loaded_image& operator=(const loaded_image&) = delete;
+    ~loaded_image();
+};
+
+//
+// --fork: the entry point of every BOF runs in a child process forked after the
+// image is ready (platform_forked_call), its output comes back over a pipe.
+// POSIX only; the default runs it on the calling thread.
+//
+void fork_set_enabled(bool enabled);
+bool fork_enabled();
+
+//
+// Loads a COFF or ELF object (picked from its header), runs func_name with the
+// packed arguments and frees the image again. Beacon output stays in the calling
+// thread's output buffer. Faults inside of the BOF fail the call; pass a guard to
+// let another thread abort it (see platform_abort_guarded_call). With keep the
+// image is left mapped in it instead of being freed.
+//
+bool load_object(
+    void* pobject,
+    size_t object_size,
+    const std::string& func_name,
+    char* arguments,
+    uint32_t argc,
+    platform_guard* guard = nullptr,
+    loaded_image* keep = nullptr);
+
+//
+// load_object for an object arriving through a pipe ("-", "fd:<n>"). The image
+// is reserved as soon as the headers are in and section data is read straight
+// into it while the stream advances; relocations, symbols and strings are
+// gathered into a small metadata buffer on the way. COFF objects whose parts
+// are not in file order (or that use more than 0xFFFF relocations in a
+// section) and ELF objects are read into memory first and loaded as usual.
+//
+bool load_object_stream(
+    input_stream& stream,
+    const std::string& func_name,
+    char* arguments,
+    uint32_t argc,
+    platform_guard* guard = nullptr);
+
+#endif //EXECUTOR_HPP
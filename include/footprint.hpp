@@ -0,0 +1,48 @@
+#ifndef FOOTPRINT_HPP
+#define FOOTPRINT_HPP
+#include <platform.hpp>
+#include <cstdint>
+
+//
+// Optional per-job memory accounting (--memory). The executor reports the
+// image it lays out and every protection change it makes, Beacon output and
+// format buffers report their own sizes; footprint_end() adds it up. All of it
+// is per thread, like the arena and perf, so workers do not share anything.
+//
+
+enum footprint_class : uint32_t {
+    FOOTPRINT_READ_EXECUTE,
+    FOOTPRINT_READ_ONLY,
+    FOOTPRINT_READ_WRITE,
+    FOOTPRINT_CLASS_COUNT,
+};
+
+struct footprint_stats {
+    uint64_t object_bytes;                      // the object file as read
+    uint64_t image_bytes;                       // mapped for sections and the import area
+    uint64_t committed[FOOTPRINT_CLASS_COUNT];  // image bytes per protection while the entry point ran
+    uint64_t section_bytes;                     // section contents
+    uint64_t padding_bytes;                     // page alignment after sections and import slots
+    uint64_t import_area_bytes;
+    uint64_t import_slots;                      // reserved by relocations, 8 bytes each
+    uint64_t import_slots_filled;               // holding an address or a call stub
+    uint64_t output_high_water;                 // bytes allocated for the Beacon output buffer
+    uint64_t format_high_water;                 // most bytes in live BeaconFormatAlloc buffers
+    uint64_t peak_working_set;                  // whole process, when the job ended (filled in by run_job)
+};
+
+void        footprint_set_enabled(bool enabled);
+bool        footprint_enabled();
+
+void        footprint_begin();
+void        footprint_image(uint64_t object_bytes, void* base, uint64_t image_bytes);
+void        footprint_section(uint64_t size);   // one mapped section, page aligned in the image
+void        footprint_imports(void* area, uint64_t slots, uint64_t filled);
+void        footprint_protect(void* address, uint64_t size, page_protection protection);
+void        footprint_entry();                  // the entry point is about to run
+void        footprint_format(int64_t bytes);    // a format buffer was allocated (> 0) or freed (< 0)
+footprint_stats footprint_end();
+
+const char* footprint_class_name(footprint_class protection);
+
+#endif //FOOTPRINT_HPP
@@ -0,0 +1,58 @@
+#ifndef INSPECT_HPP
+#define INSPECT_HPP
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//
+// Static preflight of object files: parses and lays out each object without
+// resolving or running anything, and lists what would stop it from loading.
+//
+
+struct inspect_section {
+    std::string name;
+    uint64_t    size;
+    uint64_t    offset;         // where the loader places it, relative to the image base
+    uint32_t    relocations;
+    uint64_t    flags;          // COFF characteristics or ELF sh_flags
+};
+
+struct inspect_relocation {
+    std::string section;
+    uint64_t    offset;
+    std::string type;
+    std::string symbol;
+};
+
+struct inspect_report {
+    std::string                     path;
+    std::string                     format;         // "coff", "elf" or "unknown"
+    std::string                     error;          // set if the object did not parse
+    uint64_t                        file_size    = 0;
+    uint64_t                        virtual_size = 0;
+    uint64_t                        import_offset = 0;         // start of the import slots in the image
+    bool                            has_entry    = false;
+    std::vector<inspect_section>    sections;
+    std::vector<std::string>        entry_points;               // defined, externally visible functions
+    std::vector<std::string>        imports;                    // sorted, unique
+    std::vector<std::string>        unsupported_beacon;         // Beacon API functions the runtime lacks
+    std::vector<std::string>        unresolved_symbols;         // undefined, and not an import
+    std::vector<inspect_relocation> unsupported_relocations;
+
+    bool ok() const {
+        return error.empty() && has_entry && unsupported_beacon.empty()
+            && unresolved_symbols.empty() && unsupported_relocations.empty();
+    }
+};
+
+inspect_report inspect_object(const std::string& path);
+void           inspect_write_json(std::ostream& out, const inspect_report& report);
+
+//
+// Inspects every .o/.obj below directory on workers threads. Writes one JSON
+// line per object (in path order) and a final summary line to out.
+//
+bool           inspect_directory(const std::string& directory, uint32_t workers, std::ostream& out);
+
+#endif //INSPECT_HPP
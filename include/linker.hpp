@@ -0,0 +1,39 @@
+#ifndef LINKER_HPP
+#define LINKER_HPP
+#include <compat.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// Resident library objects. A library is loaded, relocated and protected once
+// and then stays mapped for the rest of the process. Its external functions and
+// data are exported to every object loaded after it: undefined symbols of a BOF
+// (that are not "__imp_" imports) resolve against them.
+//
+// COFF and ELF exports live apart, since their code uses different calling
+// conventions. Libraries keep their global state between executions.
+//
+
+enum link_format : uint32_t {
+    LINK_COFF,
+    LINK_ELF,
+};
+
+//
+// Loads a set of libraries. Symbols resolve across the whole set (and against
+// libraries loaded earlier), so the order does not matter. Has to run before
+// any BOF is executed; the export table is read without locking afterwards.
+//
+bool link_load_libraries(const std::vector<std::string>& paths);
+
+void*  link_find_symbol(link_format format, const char* name);
+size_t link_library_count();
+
+//
+// Name of the closest exported function at or below address, if address lies
+// inside of a library image. For fault reports.
+//
+bool link_describe_address(uint64_t address, std::string* name, uint64_t* offset);
+
+#endif //LINKER_HPP
@@ -0,0 +1,127 @@
+#ifndef LOADER_HPP
+#define LOADER_HPP
+#include <compat.hpp>
+#include <structs.hpp>
+#include <macro.hpp>
+#include <platform.hpp>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//
+// Platform independent part of the COFF loader: parsing, layout and relocation.
+// None of these touch the OS, so they can be driven from benchmarks on any host.
+//
+
+using symbol_resolver = void* (*)(const char* symbol);
+
+//
+// Classic objects and big objects (ANON_OBJECT_HEADER_BIGOBJ, from /bigobj or
+// -mbig-obj) parse into the same object_context. Sizes are 64 bit throughout.
+//
+bool        object_parse(object_context* ctx, void* pobject, size_t object_size);
+char*       object_symbol_name(const object_context* ctx, const object_symbol& symbol);
+uint64_t    object_virtual_size(object_context* ctx);
+void        object_map_sections(object_context* ctx, void* virtual_addr);
+bool        process_object_sections(object_context* ctx, symbol_resolver resolve);
+
+inline object_symbol object_symbol_at(const object_context* ctx, const size_t index)
+{
+    const BYTE* record = ctx->sym_table + index * ctx->symbol_size;
+    object_symbol symbol;
+
+    if (ctx->symbol_size == IMAGE_SIZEOF_SYMBOL_EX) {
+        const auto* entry = reinterpret_cast<const IMAGE_SYMBOL_EX*>(record);
+        symbol.short_name    = entry->N.Name.Short ? entry->N.ShortName : nullptr;
+        symbol.name_offset   = entry->N.Name.Short ? 0 : entry->N.Name.Long;
+        symbol.value         = entry->Value;
+        symbol.section       = entry->SectionNumber;
+        symbol.type          = entry->Type;
+        symbol.storage_class = entry->StorageClass;
+        symbol.aux_count     = entry->NumberOfAuxSymbols;
+    } else {
+        const auto* entry = reinterpret_cast<const IMAGE_SYMBOL*>(record);
+        symbol.short_name    = entry->N.Name.Short ? entry->N.ShortName : nullptr;
+        symbol.name_offset   = entry->N.Name.Short ? 0 : entry->N.Name.Long;
+        symbol.value         = entry->Value;
+        symbol.section       = entry->SectionNumber;
+        symbol.type          = entry->Type;
+        symbol.storage_class = entry->StorageClass;
+        symbol.aux_count     = entry->NumberOfAuxSymbols;
+    }
+
+    return symbol;
+}
+
+//
+// Relocations of a section. More than 0xFFFF are flagged with
+// IMAGE_SCN_LNK_NRELOC_OVFL, the real count is then in the first entry.
+//
+inline PIMAGE_RELOCATION object_section_relocations(const object_context* ctx, const IMAGE_SECTION_HEADER& section, uint32_t* count)
+{
+    auto* relocation = reinterpret_cast<PIMAGE_RELOCATION>(ctx->base + section.PointerToRelocations);
+
+    if ((section.Characteristics & IMAGE_SCN_LNK_NRELOC_OVFL) && section.NumberOfRelocations == 0xFFFF) {
+        *count = relocation->RelocCount != 0 ? relocation->RelocCount - 1 : 0;
+        return relocation + 1;
+    }
+
+    *count = section.NumberOfRelocations;
+    return relocation;
+}
+
+//
+// Relocation engine. process_object_sections resolves every relocation into a
+// fixup first and then applies them all, sorted by target, in one sweep. Each
+// IMAGE_REL_AMD64_* type is a row in a table (how the value is computed, field
+// width, range); types without a row, and results that do not fit their field,
+// fail the load instead of leaving a broken image behind.
+//
+struct object_fixup {
+    uint64_t target;        // address of the field
+    uint64_t symbol;        // S: address of the symbol, its Value included
+    uint64_t section_base;  // base of the section S is in, 0 outside of the image
+    uint16_t type;          // IMAGE_REL_AMD64_*
+    uint32_t section;       // 1 based number of that section, 0 outside of the image
+};
+
+bool        object_relocation_supported(uint32_t type);
+const char* object_relocation_name(uint32_t type);   // "REL32", ...
+bool        object_apply_fixup(const object_fixup& fixup, uint64_t image_base);
+
+//
+// Sorts fixups by target and applies them. Returns how many were applied, the
+// one at that index failed if it is less than count.
+//
+size_t      object_apply_fixups(object_fixup* fixups, size_t count, uint64_t image_base);
+
+//
+// ctx->fixup_error as text, empty if the last relocation pass did not fail on a relocation
+//
+std::string object_fixup_error_string(const object_context* ctx);
+
+//
+// Protection plan: the final protection of every page of a relocated image,
+// in address order, with neighbours of the same protection merged so that it
+// takes as few protection calls as possible. Code is read/execute, read-only
+// data read-only, writable data read/write, and the import slots read-only
+// once they are bound (read/execute if they hold call stubs). It is applied
+// once after relocation and left alone while the image runs.
+//
+struct protection_range {
+    void*           address;
+    uint64_t        size;
+    page_protection protection;
+};
+
+void        protection_plan_add(std::vector<protection_range>& plan, void* address, uint64_t size, page_protection protection);
+std::vector<protection_range> object_protection_plan(const object_context* ctx, void* image, uint64_t image_size);
+
+//
+// Closest symbol at or below address inside of the mapped image, for
+// reporting faults. Returns false if address is outside of every section.
+//
+bool        object_nearest_symbol(const object_context* ctx, uint64_t address, object_symbol* nearest, uint64_t* offset);
+
+#endif //LOADER_HPP
@@ -0,0 +1,70 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+//
+// Process wide metrics (--metrics). Every thread records into its own shard,
+// with plain relaxed stores of values only it writes, so the hot path takes no
+// lock and shares no cache line with other workers. Readers add the shards up;
+// a snapshot is consistent per value, not across values. Gauges are single
+// process wide values.
+//
+
+enum metric_counter : uint32_t {
+    METRIC_JOBS_SUCCEEDED,
+    METRIC_JOBS_FAILED,
+    METRIC_JOBS_TIMED_OUT,
+    METRIC_OUTPUT_BYTES,
+    METRIC_IMAGE_REUSED,            // --watch kept the layout
+    METRIC_IMAGE_RELAID,
+    METRIC_CATALOG_HITS,
+    METRIC_CATALOG_MISSES,
+    METRIC_SYMBOLS_RESOLVED,
+    METRIC_SYMBOLS_UNRESOLVED,
+    METRIC_ARENA_ALLOCATIONS,
+    METRIC_ARENA_RECLAIMED_BYTES,
+    METRIC_COUNTER_COUNT,
+};
+
+enum metric_gauge : uint32_t {
+    METRIC_JOBS_QUEUED,
+    METRIC_JOBS_RUNNING,
+    METRIC_WORKERS,
+    METRIC_ARENA_PEAK_BYTES,        // of the last job that used the arena
+    METRIC_GAUGE_COUNT,
+};
+
+enum metric_histogram : uint32_t {
+    METRIC_PHASE_PARSE,             // same order as perf_phase
+    METRIC_PHASE_LAYOUT,
+    METRIC_PHASE_RELOCATE,
+    METRIC_PHASE_EXECUTE,
+    METRIC_JOB_DURATION,            // load and execution, as job_result::elapsed_ms
+    METRIC_QUEUE_WAIT_INTERACTIVE,  // submit to start, same order as job_priority
+    METRIC_QUEUE_WAIT_NORMAL,
+    METRIC_QUEUE_WAIT_BULK,
+    METRIC_HISTOGRAM_COUNT,
+};
+
+void        metrics_set_enabled(bool enabled);
+bool        metrics_enabled();
+
+void        metrics_add(metric_counter counter, uint64_t value = 1);
+void        metrics_set(metric_gauge gauge, int64_t value);
+void        metrics_observe(metric_histogram histogram, double elapsed_ms);
+
+void        metrics_write_prometheus(std::ostream& out);
+void        metrics_write_json(std::ostream& out);
+
+//
+// Rewrites prometheus_file (text exposition format, replaced atomically) every
+// interval_ms from a background thread. json_file gets a snapshot when
+// metrics_stop_export() runs and, on POSIX, whenever the process gets SIGUSR1.
+// Either file may be empty.
+//
+bool        metrics_start_export(const std::string& prometheus_file, const std::string& json_file, uint32_t interval_ms);
+void        metrics_stop_export();
+
+#endif //METRICS_HPP
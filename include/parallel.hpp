@@ -0,0 +1,32 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+//
+// Parallel preparation of large objects (--parallel-load). Off by default.
+// With it on, object_map_sections copies sections in chunks and
+// process_object_sections builds and applies fixups in ranges on a pool of
+// helper threads, as long as the object is above the thresholds below.
+// Import resolution stays on the loading thread and in relocation order, so
+// resolvers never run concurrently for one load.
+//
+constexpr uint64_t parallel_load_min_bytes        = 4 * 1024 * 1024;   // section data copied
+constexpr size_t   parallel_load_min_relocations  = 32768;
+
+//
+// 0 or 1 turns it off. Helper threads are started the first time a load
+// needs them, the loading thread does its share of the work too.
+//
+void        parallel_load_set_threads(uint32_t threads);
+uint32_t    parallel_load_threads();
+
+//
+// Calls fn(0) to fn(count - 1) on the helper threads and the calling thread,
+// returns once every call returned. Several threads may use it at once (batch
+// workers), their items share the pool. fn must not throw.
+//
+void        parallel_for(size_t count, const std::function<void(size_t)>& fn);
+
+#endif //PARALLEL_HPP
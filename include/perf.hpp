@@ -0,0 +1,59 @@
+#ifndef PERF_HPP
+#define PERF_HPP
+#include <cstdint>
+
+//
+// Optional per-job counters (--perf). On Linux each thread opens its own set of
+// perf_event_open counters on first use, counting only itself (hardware events
+// in user mode only), and every loader phase reads them on entry and exit. Counters the kernel refuses
+// (perf_event_paranoid, no PMU in a VM, seccomp) are left out; without any, the
+// feature reports itself unavailable once and stays out of the way. Other
+// platforms only get the wall time of each phase.
+//
+
+enum perf_counter : uint32_t {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_PAGE_FAULTS,
+    PERF_CONTEXT_SWITCHES,
+    PERF_COUNTER_COUNT,
+};
+
+enum perf_phase : uint32_t {
+    PERF_PHASE_PARSE,       // header and table checks
+    PERF_PHASE_LAYOUT,      // sizing, allocation and section copies
+    PERF_PHASE_RELOCATE,    // relocations, import resolution and protection
+    PERF_PHASE_EXECUTE,     // the entry point call
+    PERF_PHASE_COUNT,
+};
+
+struct perf_sample {
+    uint64_t values[PERF_COUNTER_COUNT];    // scaled up if the counter was multiplexed
+    double   elapsed_ms;
+};
+
+struct perf_stats {
+    perf_sample phases[PERF_PHASE_COUNT];
+    uint32_t    available;                  // bit per perf_counter that could be read
+};
+
+void        perf_set_enabled(bool enabled);
+bool        perf_enabled();
+void        perf_set_timing(bool enabled);  // phase times only, e.g. for --metrics
+
+//
+// Per thread, like the arena: perf_begin() clears the current job's stats,
+// perf_end() returns them. Phases may be entered more than once, they add up;
+// stopping a phase that is not running does nothing.
+//
+void        perf_begin();
+void        perf_phase_start(perf_phase phase);
+void        perf_phase_stop(perf_phase phase);
+perf_stats  perf_end();
+
+const char* perf_counter_name(perf_counter counter);
+const char* perf_phase_name(perf_phase phase);
+
+#endif //PERF_HPP
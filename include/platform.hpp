@@ -0,0 +1,123 @@
+#ifndef PLATFORM_HPP
+#define PLATFORM_HPP
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+//
+// The few OS services the loader needs. src/platform_win.cpp implements these with
+// VirtualAlloc/VirtualProtect/GetProcAddress, src/platform_posix.cpp with mmap/mprotect.
+//
+
+enum page_protection : uint32_t {
+    PROTECT_READ_WRITE,
+    PROTECT_READ_EXECUTE,
+    PROTECT_READ_ONLY,
+};
+
+void*   platform_alloc(size_t size); // page aligned, zeroed, read/write
+bool    platform_protect(void* address, size_t size, page_protection protection);
+void    platform_free(void* address, size_t size);
+
+uint64_t platform_peak_working_set(); // most bytes the process had resident so far, 0 if unknown
+
+//
+// Resolves a LIBRARY$Function import. Returns nullptr if the platform cannot
+// satisfy it (always the case for Windows DLL imports on POSIX). On POSIX a null
+// library looks the function up in the global namespace, which is how undefined
+// symbols of ELF objects are bound.
+//
+void*   platform_resolve_import(const char* library, const char* function);
+
+//
+// Runs function(context) and catches hardware faults raised inside of it (access
+// violations, illegal instructions, stack overflows, ...). Returns false with
+// *fault filled in if it faulted; execution then continues after the call, so
+// whatever the function held (locks, allocations) is abandoned.
+//
+struct platform_fault {
+    uint32_t code;      // exception code on Windows, signal number on POSIX
+    uint64_t pc;        // faulting instruction, 0 if unknown
+    uint64_t address;   // accessed address for memory faults
+};
+
+//
+// fault code of a guarded call stopped by platform_abort_guarded_call
+//
+constexpr uint32_t PLATFORM_FAULT_ABORTED = 0xFFFFFFFF;
+
+//
+// fault code of a forked call whose child exited without returning from it
+//
+constexpr uint32_t PLATFORM_FAULT_EXITED = 0xFFFFFFFE;
+
+enum guard_state : uint32_t {
+    GUARD_IDLE,
+    GUARD_RUNNING,
+    GUARD_ABORTING,
+};
+
+//
+// Handle to a guarded call, owned by the caller, so another thread can abort
+// it. frame is only valid while state is GUARD_RUNNING or GUARD_ABORTING.
+//
+struct platform_guard {
+    std::atomic<uint32_t> state { GUARD_IDLE };
+    void*                 frame = nullptr;
+    int64_t               child = 0;    // process of a forked call, 0 for a call on the thread
+};
+
+bool        platform_guarded_call(void (*function)(void*), void* context, platform_fault* fault, platform_guard* guard = nullptr);
+const char* platform_fault_name(uint32_t code);
+
+//
+// Forcibly stops a guarded call running on another thread, which then returns
+// false with PLATFORM_FAULT_ABORTED. Returns false if the call already finished.
+// Like a fault this abandons whatever the call held, so it is a last resort.
+//
+bool        platform_abort_guarded_call(platform_guard* guard);
+
+//
+// Process isolation (--fork, POSIX only). platform_forked_call runs
+// platform_guarded_call(function, context) in a child forked from the calling
+// thread and returns the way that call ended. The child is a copy-on-write
+// image of the caller, so everything prepared before the call (a relocated
+// image, bound imports, loaded libraries) is there without being redone, and
+// nothing it does reaches the caller's memory. Inside of the child
+// platform_forked_output sends data back over a pipe; on_output gets it on
+// the calling thread while the child runs. Once *cancel is raised the child
+// gets a SIGTERM, after which platform_forked_cancel_flag() reads true in it.
+// A child killed by a signal fails the call with that signal,
+// platform_abort_guarded_call kills the child. Without fork support it is
+// platform_guarded_call.
+//
+bool        platform_fork_supported();
+bool        platform_forked_call(void (*function)(void*), void* context, platform_fault* fault, platform_guard* guard,
+                                 void (*on_output)(const char* data, size_t size), const std::atomic<bool>* cancel);
+void        platform_forked_output(const char* data, size_t size);
+const std::atomic<bool>* platform_forked_cancel_flag();
+
+//
+// Only the forking thread lives on in the child, so a lock another thread held
+// at that moment would stay taken in it forever. prepare takes the locks a
+// child may need right before fork(), parent gives them back right after it
+// and child sets them up anew, as the child's thread does not own what the
+// parent's took (pthread_atfork). Nothing without fork support.
+//
+void        platform_at_fork(void (*prepare)(), void (*parent)(), void (*child)());
+
+//
+// Change notifications for a single file (--watch). Linux uses inotify, Windows
+// directory change notifications, other POSIX systems poll the modification
+// time. The file's directory is watched, so editors and compilers that replace
+// the file instead of rewriting it are seen as well.
+//
+struct platform_watch;
+
+constexpr uint32_t PLATFORM_WAIT_FOREVER = 0xFFFFFFFF;
+
+platform_watch* platform_watch_open(const char* path);
+bool            platform_watch_wait(platform_watch* watch, uint32_t timeout_ms); // true once the file changed
+void            platform_watch_close(platform_watch* watch);
+
+#endif //PLATFORM_HPP
\ No newline at end of file
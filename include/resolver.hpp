@@ -0,0 +1,26 @@
+#ifndef RESOLVER_HPP
+#define RESOLVER_HPP
+#include <compat.hpp>
+
+//
+// Resolves an "__imp_" symbol to either a Beacon API function
+// or a LIBRARY$Function export, and any other undefined symbol
+// to an export of a resident library object (see linker.hpp).
+//
+void* resolve_object_symbol(const char* symbol);
+
+//
+// Whether name (without "__imp_") is a Beacon API function the runtime provides.
+//
+bool is_supported_beacon_function(const char* name);
+
+#if BOF_ELF_SUPPORT
+//
+// Resolves an undefined symbol of an ELF object to either a (System V)
+// Beacon API function, an export of a resident library object or a
+// symbol already loaded into the process.
+//
+void* resolve_elf_symbol(const char* symbol);
+#endif
+
+#endif //RESOLVER_HPP
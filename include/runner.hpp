@@ -0,0 +1,173 @@
+#ifndef RUNNER_HPP
+#define RUNNER_HPP
+#include <platform.hpp>
+#include <executor.hpp>
+#include <arena.hpp>
+#include <perf.hpp>
+#include <footprint.hpp>
+#include <metrics.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+//
+// Jobs and the worker pool that runs them. Every worker executes one job at a
+// time; a watchdog thread enforces the per-job time budget in three steps:
+//   1. the budget runs out: BeaconIsCancelled() starts returning TRUE and the
+//      job is marked as timed out (its output so far is kept),
+//   2. after a grace period the call is aborted (platform_abort_guarded_call),
+//   3. if even that does not come back, the worker is abandoned and replaced,
+//      with the job's output so far taken from the worker's buffer.
+//
+// Queued jobs are scheduled by class: a free worker takes the oldest job of the
+// most urgent class that is below its limit, so jobs of one class start in the
+// order they were submitted.
+//
+
+enum job_status : uint32_t {
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_SUCCEEDED,
+    JOB_FAILED,
+    JOB_TIMED_OUT,
+};
+
+//
+// Scheduling classes, most urgent first
+//
+enum job_priority : uint32_t {
+    JOB_INTERACTIVE,                // an operator is waiting for it
+    JOB_NORMAL,
+    JOB_BULK,                       // sweeps, only latency insensitive work
+    JOB_PRIORITY_COUNT,
+};
+
+const char*                 job_priority_name(job_priority priority);
+std::optional<job_priority> job_priority_from_name(std::string_view name);
+
+struct job {
+    std::string object_path;
+    std::string arguments;          // unpacked argument string, or "@file" for a packed blob
+    uint32_t    timeout_ms = 0;     // 0 runs without a time budget
+    job_priority priority = JOB_NORMAL;
+
+    job_status  status = JOB_QUEUED;
+    std::string output;             // Beacon output, also kept for failed and timed out jobs
+    double      elapsed_ms = 0;
+    double      queued_ms = 0;      // from submit() until a worker took it
+    std::chrono::steady_clock::time_point submitted;
+    arena_stats arena = {};         // only filled in with the arena enabled
+    perf_stats  perf = {};          // only filled in with --perf
+    footprint_stats footprint = {}; // only filled in with --memory
+};
+
+struct job_result {
+    job_status  status = JOB_FAILED;
+    std::string output;
+    double      elapsed_ms = 0;
+    arena_stats arena = {};
+    perf_stats  perf = {};
+    footprint_stats footprint = {};
+};
+
+const char* job_status_name(job_status status);
+void        metrics_record_status(job_status status); // a job ended with status
+
+//
+// Reads, packs and runs one job on the calling thread. keep is passed on to
+// load_object, to reuse the image of the previous run.
+//
+job_result run_job(const std::string& object_path, const std::string& arguments, platform_guard* guard = nullptr,
+                   loaded_image* keep = nullptr);
+
+//
+// One job per line: "[class] <object path> [arguments]", where the optional
+// class is "[interactive]", "[normal]" (the default) or "[bulk]". Blank lines
+// and lines starting with '#' are skipped.
+//
+std::optional<std::vector<job>> read_job_file(const std::string& file_name, uint32_t timeout_ms);
+
+constexpr uint32_t default_grace_ms = 500;
+
+//
+// class_limit caps how many jobs of a class run at once (0: no cap).
+// interactive_reserved workers are held back for interactive jobs: the other
+// classes together never occupy more than the rest of the pool, so an
+// interactive job does not wait behind a sweep that would otherwise fill it.
+// At least one worker always stays open to every class.
+//
+struct scheduler_limits {
+    uint32_t class_limit[JOB_PRIORITY_COUNT] = {};
+    uint32_t interactive_reserved = 0;
+};
+
+struct queue_wait_stats {
+    uint32_t jobs = 0;              // taken by a worker so far
+    double   mean_ms = 0;
+    double   p50_ms = 0;
+    double   p99_ms = 0;
+    double   max_ms = 0;
+};
+
+class worker_pool {
+    //
+    // Shared with the worker's thread, so an abandoned thread that comes back
+    // late still finds it after the pool is gone.
+    //
+    struct worker {
+        std::thread                             thread;
+        job*                                    current = nullptr;
+        std::chrono::steady_clock::time_point   deadline;
+        uint32_t                                stage = 0;      // watchdog steps taken for the current job
+        std::atomic<bool>                       cancel { false };
+        platform_guard                          guard;
+
+        std::mutex                              state_lock;     // guards the fields below, taken after lock_
+        std::string                             output;         // Beacon output of the current job
+        bool                                    returned = false; // the job's call is over, the thread heads back to lock_
+        bool                                    retired = false;  // abandoned, also only written with lock_ held
+    };
+
+    std::mutex                              lock_;
+    std::condition_variable                 work_ready_;
+    std::condition_variable                 job_done_;
+    std::condition_variable                 watchdog_wake_;
+    std::deque<job*>                        queues_[JOB_PRIORITY_COUNT];
+    std::vector<double>                     waits_[JOB_PRIORITY_COUNT];     // queue time of every job taken, ms
+    uint32_t                                running_[JOB_PRIORITY_COUNT] = {};
+    std::vector<std::shared_ptr<worker>>    workers_;
+    std::thread                             watchdog_;
+    scheduler_limits                        limits_;
+    size_t                                  queued_   = 0;
+    size_t                                  pending_  = 0;
+    uint32_t                                size_;
+    uint32_t                                replaced_ = 0;
+    uint32_t                                grace_ms_;
+    bool                                    stopping_ = false;
+
+    job* take_next();           // with lock_ held, nullptr if nothing may start now
+    void spawn_worker();
+    void worker_loop(std::shared_ptr<worker> self);
+    void watchdog_loop();
+
+public:
+    explicit worker_pool(uint32_t workers, const scheduler_limits& limits = {}, uint32_t grace_ms = default_grace_ms);
+    worker_pool(const worker_pool&) = delete;
+    worker_pool& operator=(const worker_pool&) = delete;
+    ~worker_pool();
+
+    void     submit(job* j);    // j has to stay alive until wait() returns
+    void     wait();            // until every submitted job has finished
+    uint32_t replaced_workers();
+    queue_wait_stats queue_wait(job_priority priority);
+};
+
+#endif //RUNNER_HPP
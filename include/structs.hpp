@@ -1,23 +1,60 @@
 #ifndef STRUCTS_HPP
 #define STRUCTS_HPP
-#include <Windows.h>
+#include <compat.hpp>
+#include <cstdint>
 #include <string>
 
 struct section_map {
-    PVOID base;
-    ULONG size;
+    PVOID    base;
+    uint64_t size;
 };
 
-struct object_context {
-    union {
-        ULONG_PTR          base;
-        PIMAGE_FILE_HEADER header;
-    };
+enum object_fixup_status : uint32_t {
+    OBJECT_FIXUP_OK,
+    OBJECT_FIXUP_UNSUPPORTED,       // relocation type the loader does not apply
+    OBJECT_FIXUP_OUT_OF_BOUNDS,     // field outside of its section
+    OBJECT_FIXUP_BAD_SYMBOL,        // symbol the relocation type cannot refer to
+    OBJECT_FIXUP_OVERFLOW,          // result does not fit into the field
+};
+
+//
+// Why process_object_sections failed, if it was a relocation
+//
+struct object_fixup_error {
+    uint32_t status;
+    uint32_t type;
+    uint32_t section;   // 1 based
+    uint32_t offset;    // into the section
+};
 
-    PIMAGE_SYMBOL       sym_table;
+//
+// A symbol table entry of either format: IMAGE_SYMBOL in classic objects,
+// IMAGE_SYMBOL_EX (32 bit section numbers) in big objects. See object_symbol_at.
+//
+struct object_symbol {
+    const BYTE* short_name;     // 8 bytes, only terminated if shorter; nullptr for long names
+    uint32_t    name_offset;    // of a long name, into the string table
+    uint32_t    value;
+    int32_t     section;        // 1 based, or IMAGE_SYM_UNDEFINED / ABSOLUTE / DEBUG
+    uint16_t    type;
+    uint8_t     storage_class;
+    uint8_t     aux_count;
+};
+
+struct object_context {
+    ULONG_PTR           base;           // the raw object file
+    BYTE*               sym_table;      // symbol_count entries of symbol_size bytes
+    const char*         str_table;      // right after the symbol table, starts with its size
     PVOID*              sym_map;
     section_map*        sec_map;
     PIMAGE_SECTION_HEADER sections;
+    size_t              size; // size of the raw object file in bytes
+    uint32_t            section_count;
+    uint32_t            symbol_count;
+    uint32_t            symbol_size;    // IMAGE_SIZEOF_SYMBOL, or IMAGE_SIZEOF_SYMBOL_EX for big objects
+    uint32_t            import_slots; // sym_map entries process_object_sections reserved
+    uint32_t            call_stubs;   // of those, slots holding a call stub into another object
+    object_fixup_error  fixup_error;
 };
 
 struct beacon_function_pair { //unused.
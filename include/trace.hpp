@@ -0,0 +1,59 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+#include <compat.hpp>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+//
+// Record and replay (--record / --replay). While recording, every import slot
+// the loader fills in (Beacon API functions as well as LIBRARY$Function and
+// ELF imports) points at a thunk that calls the real function and logs its
+// name, first four integer arguments and integer result. The trace also keeps
+// the object path, the packed arguments and the Beacon output.
+//
+// Replaying runs the same object with the same arguments, but imports that
+// depend on the machine (anything outside the Beacon API and a small set of
+// allocation, memory and string functions) are not called: their thunk hands
+// back the recorded results in order. The Beacon API itself runs for real, so
+// output handling and argument parsing are exercised every time and the output
+// is compared byte for byte with the recorded one. A trace recorded on Windows
+// replays on Linux as long as the imports it needs live were recorded.
+//
+// Only integer and pointer arguments are forwarded and logged. Data the real
+// function wrote through pointer arguments is not part of the trace.
+//
+
+enum trace_mode : uint32_t {
+    TRACE_OFF,
+    TRACE_RECORD,
+    TRACE_REPLAY,
+};
+
+void        trace_set_record(const std::string& trace_file);
+bool        trace_recording();
+
+//
+// Per thread, like the arena: a recording or replay session covers the
+// object loaded in between, and the resolvers below only wrap imports while
+// one is active.
+//
+void        trace_record_begin();
+bool        trace_record_end(const std::string& object_path, const char* args, uint32_t size,
+                             const std::string& output, bool succeeded);
+
+//
+// Replays one trace file, or every *.trace file below a directory, on the
+// calling thread. Prints one line per trace and returns whether all of them
+// produced the recorded output.
+//
+bool        trace_replay(const std::string& path, std::ostream& out);
+
+void*       trace_resolve_object_symbol(const char* symbol);
+#if BOF_ELF_SUPPORT
+void*       trace_resolve_elf_symbol(const char* symbol);
+#endif
+
+bool        trace_active();
+
+#endif //TRACE_HPP
@@ -5,10 +5,91 @@
 #include <fstream>
 #include <optional>
 #include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <string_view>
+
+//
+// Argument packing. Comma separated chunks become, in order:
+//   i<n>          32 bit integer
+//   s<n>          16 bit integer
+//   wstr:<text>   length prefixed, null terminated UTF-16LE string
+//   file:<path>   length prefixed raw contents of <path>
+//   anything else length prefixed, null terminated string
+//
+// The packer measures first and then writes straight into the output, so
+// packing into a buffer that is already large enough does not allocate.
+//
+std::optional<size_t> packed_arguments_size(std::string_view unpacked);
+bool pack_arguments(std::string_view unpacked, char* out, size_t capacity, size_t* written);
+bool pack_arguments(std::string_view unpacked, std::vector<char>& packed);
 
-bool pack_arguments(std::string unpacked, std::vector<char>& packed);
 std::optional<std::vector<char>> read_from_disk(const std::string& file_name);
 
+//
+// --quiet: progress messages ("[*]", "[+]") are left out. Errors still go to
+// stderr and BOF output to stdout.
+//
+void log_set_quiet(bool quiet);
+bool log_quiet();
+
+//
+// Read only, copy-on-write view of a file. Writes through data() are private
+// to this process and never reach the file.
+//
+class mapped_file {
+    char*  base_   = nullptr;
+    size_t length_ = 0;
+    void*  handle_ = nullptr; // file mapping object (Windows only)
+
+public:
+    char*  data() const { return base_; }
+    size_t size() const { return length_; }
+
+    static std::optional<mapped_file> open(const std::string& file_name);
+
+    mapped_file() = default;
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    mapped_file(mapped_file&& other) noexcept;
+    mapped_file& operator=(mapped_file&& other) noexcept;
+    ~mapped_file();
+};
+
+//
+// Sequential reader for objects that arrive through a pipe instead of a file:
+// "-" is stdin, "fd:<n>" an inherited file descriptor (POSIX only). Nothing
+// is buffered, read() goes straight to the descriptor.
+//
+class input_stream {
+    int      fd_     = -1;
+    uint64_t offset_ = 0;
+
+public:
+    static bool is_stream_name(const std::string& name);
+    static std::optional<input_stream> open(const std::string& name);
+
+    //
+    // Fills buffer unless the stream ends or fails first, returns how much it read
+    //
+    size_t   read(void* buffer, size_t size);
+    bool     skip(uint64_t size);
+    uint64_t offset() const { return offset_; }
+};
+
+//
+// Pre-packed argument blobs, so repeated or very large argument sets
+// only get packed once. The loaded blob points into the mapping.
+//
+struct packed_blob {
+    mapped_file file;
+    char*       data = nullptr;
+    uint32_t    size = 0;
+};
+
+bool save_packed_arguments(const std::string& file_name, const char* packed, size_t size);
+std::optional<packed_blob> load_packed_arguments(const std::string& file_name);
+
 template<typename T>
 class defer_wrapper {
     T callable;
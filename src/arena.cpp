@@ -0,0 +1,529 @@
+#include <arena.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#define HEAP_ZERO_MEMORY    0x00000008
+#define LMEM_ZEROINIT       0x0040
+typedef size_t SIZE_T;
+#endif
+
+namespace {
+
+constexpr size_t   chunk_size   = 256 * 1024;
+constexpr uint32_t block_magic  = 0x41524E41; // "ANRA"
+
+//
+// Chunks are carved front to back. The first one survives between jobs, the
+// rest go back to the system at the end of every job.
+//
+struct arena_chunk {
+    arena_chunk* next;
+    size_t       size;  // usable bytes after the header
+    size_t       used;
+    size_t       pins;  // store values pointing into it, changed with pin_lock held
+};
+
+struct block_header {
+    uint64_t size;
+    uint32_t magic;
+    uint32_t live;
+};
+
+static_assert(sizeof(arena_chunk) % 16 == 0 && sizeof(block_header) == 16, "arena alignment");
+
+struct arena_state {
+    arena_chunk*    chunks = nullptr;   // newest first
+    block_header*   last   = nullptr;   // most recent allocation, can grow or shrink in place
+    arena_stats     stats  = {};
+    uint64_t        live_bytes  = 0;
+    uint64_t        live_blocks = 0;
+};
+
+std::atomic<bool> enabled { false };
+thread_local arena_state arena;
+
+//
+// Every chunk with pins, from any thread. A detached chunk outlived the job
+// that carved it and is freed with its last pin.
+//
+struct pinned_chunk {
+    arena_chunk* chunk;
+    bool         detached;
+};
+
+std::mutex                pin_lock;
+std::vector<pinned_chunk> pinned_chunks;
+
+char* chunk_data(arena_chunk* chunk)
+{
+    return reinterpret_cast<char*>(chunk) + sizeof(arena_chunk);
+}
+
+bool chunk_holds(arena_chunk* chunk, const void* ptr)
+{
+    return ptr >= chunk_data(chunk) && ptr < chunk_data(chunk) + chunk->size;
+}
+
+size_t align_16(const size_t size)
+{
+    return (size + 15) & ~static_cast<size_t>(15);
+}
+
+arena_chunk* new_chunk(const size_t needed)
+{
+    const size_t size = needed > chunk_size ? align_16(needed) : chunk_size;
+    auto* chunk = static_cast<arena_chunk*>(malloc(sizeof(arena_chunk) + size));
+
+    if (chunk != nullptr) {
+        chunk->next = arena.chunks;
+        chunk->size = size;
+        chunk->used = 0;
+        chunk->pins = 0;
+        arena.chunks = chunk;
+    }
+
+    return chunk;
+}
+
+block_header* owned_block(void* ptr)
+{
+    if (ptr == nullptr) {
+        return nullptr;
+    }
+
+    for (arena_chunk* chunk = arena.chunks; chunk != nullptr; chunk = chunk->next) {
+        if (ptr > chunk_data(chunk) && ptr < chunk_data(chunk) + chunk->used) {
+            auto* block = reinterpret_cast<block_header*>(static_cast<char*>(ptr) - sizeof(block_header));
+            return block->magic == block_magic ? block : nullptr;
+        }
+    }
+
+    return nullptr;
+}
+
+void* arena_alloc(const size_t size, const bool zero)
+{
+    const size_t needed = sizeof(block_header) + align_16(size ? size : 1);
+    arena_chunk* chunk = arena.chunks;
+
+    if (chunk == nullptr || chunk->size - chunk->used < needed) {
+        if ((chunk = new_chunk(needed)) == nullptr) {
+            return nullptr;
+        }
+    }
+
+    auto* block = reinterpret_cast<block_header*>(chunk_data(chunk) + chunk->used);
+    chunk->used += needed;
+
+    block->size  = size;
+    block->magic = block_magic;
+    block->live  = 1;
+    arena.last   = block;
+
+    arena.stats.allocations++;
+    arena.live_blocks++;
+    arena.live_bytes += size;
+    if (arena.live_bytes > arena.stats.peak_bytes) {
+        arena.stats.peak_bytes = arena.live_bytes;
+    }
+
+    void* memory = reinterpret_cast<char*>(block) + sizeof(block_header);
+    if (zero) {
+        memset(memory, 0, size);
+    }
+
+    return memory;
+}
+
+//
+// Frees are bookkeeping only, except for the most recent block, whose space
+// goes straight back to the bump pointer (the common alloc/free pairing).
+//
+void arena_release(block_header* block)
+{
+    if (!block->live) {
+        return;
+    }
+
+    block->live = 0;
+    arena.stats.frees++;
+    arena.live_blocks--;
+    arena.live_bytes -= block->size;
+
+    if (block == arena.last && arena.chunks != nullptr) {
+        arena.chunks->used = reinterpret_cast<char*>(block) - chunk_data(arena.chunks);
+        arena.last = nullptr;
+    }
+}
+
+void* arena_resize(void* ptr, block_header* block, const size_t size, const bool zero)
+{
+    //
+    // The most recent block grows and shrinks in place while the chunk has room.
+    //
+    if (block == arena.last) {
+        const size_t offset = reinterpret_cast<char*>(block) - chunk_data(arena.chunks);
+        const size_t needed = sizeof(block_header) + align_16(size ? size : 1);
+
+        if (offset + needed <= arena.chunks->size) {
+            if (zero && size > block->size) {
+                memset(static_cast<char*>(ptr) + block->size, 0, size - block->size);
+            }
+
+            arena.live_bytes = arena.live_bytes - block->size + size;
+            if (arena.live_bytes > arena.stats.peak_bytes) {
+                arena.stats.peak_bytes = arena.live_bytes;
+            }
+
+            arena.chunks->used = offset + needed;
+            block->size = size;
+            return ptr;
+        }
+    }
+
+    void* moved = arena_alloc(size, zero);
+    if (moved != nullptr) {
+        memcpy(moved, ptr, block->size < size ? block->size : size);
+        arena_release(block);
+    }
+
+    return moved;
+}
+
+//
+// Frees and resizes of memory the arena does not own (handed out by some other
+// API, e.g. FormatMessage) go to the real function where there is one.
+//
+#ifdef _WIN32
+template<typename T>
+T msvcrt_function(const char* name)
+{
+    static HMODULE msvcrt = LoadLibraryA("msvcrt.dll");
+    return reinterpret_cast<T>(GetProcAddress(msvcrt, name));
+}
+#endif
+
+/* Windows x64 calling convention, for COFF objects */
+PVOID BOF_API arena_HeapAlloc(HANDLE, DWORD flags, SIZE_T bytes)
+{
+    return arena_alloc(bytes, (flags & HEAP_ZERO_MEMORY) != 0);
+}
+
+PVOID BOF_API arena_HeapReAlloc(HANDLE heap, DWORD flags, PVOID ptr, SIZE_T bytes)
+{
+    if (block_header* block = owned_block(ptr)) {
+        return arena_resize(ptr, block, bytes, (flags & HEAP_ZERO_MEMORY) != 0);
+    }
+
+#ifdef _WIN32
+    return HeapReAlloc(heap, flags, ptr, bytes);
+#else
+    (void)heap;
+    return nullptr;
+#endif
+}
+
+BOOL BOF_API arena_HeapFree(HANDLE heap, DWORD flags, PVOID ptr)
+{
+    if (block_header* block = owned_block(ptr)) {
+        arena_release(block);
+        return TRUE;
+    }
+
+#ifdef _WIN32
+    return HeapFree(heap, flags, ptr);
+#else
+    (void)heap;
+    (void)flags;
+    return ptr == nullptr ? TRUE : FALSE;
+#endif
+}
+
+#ifndef _WIN32
+HANDLE BOF_API arena_GetProcessHeap()
+{
+    return reinterpret_cast<HANDLE>(&arena);
+}
+#endif
+
+PVOID BOF_API arena_LocalAlloc(UINT32 flags, SIZE_T bytes)
+{
+#ifdef _WIN32
+    if (flags & LMEM_MOVEABLE) { // returns a handle, not memory
+        return LocalAlloc(flags, bytes);
+    }
+#endif
+    return arena_alloc(bytes, (flags & LMEM_ZEROINIT) != 0);
+}
+
+PVOID BOF_API arena_LocalFree(PVOID ptr)
+{
+    if (block_header* block = owned_block(ptr)) {
+        arena_release(block);
+        return nullptr;
+    }
+
+#ifdef _WIN32
+    return LocalFree(ptr);
+#else
+    return nullptr;
+#endif
+}
+
+PVOID BOF_API arena_malloc(SIZE_T size)
+{
+    return arena_alloc(size, false);
+}
+
+PVOID BOF_API arena_calloc(SIZE_T count, SIZE_T size)
+{
+    if (size != 0 && count > SIZE_MAX / size) {
+        return nullptr;
+    }
+
+    return arena_alloc(count * size, true);
+}
+
+PVOID BOF_API arena_realloc(PVOID ptr, SIZE_T size)
+{
+    if (ptr == nullptr) {
+        return arena_alloc(size, false);
+    }
+
+    if (block_header* block = owned_block(ptr)) {
+        if (size == 0) {
+            arena_release(block);
+            return nullptr;
+        }
+        return arena_resize(ptr, block, size, false);
+    }
+
+#ifdef _WIN32
+    return msvcrt_function<void* (*)(void*, size_t)>("realloc")(ptr, size);
+#else
+    return nullptr;
+#endif
+}
+
+void BOF_API arena_free(PVOID ptr)
+{
+    if (block_header* block = owned_block(ptr)) {
+        arena_release(block);
+        return;
+    }
+
+#ifdef _WIN32
+    if (ptr != nullptr) {
+        msvcrt_function<void (*)(void*)>("free")(ptr);
+    }
+#endif
+}
+
+/* System V, for ELF objects */
+void* sysv_malloc(size_t size)
+{
+    return arena_alloc(size, false);
+}
+
+void* sysv_calloc(size_t count, size_t size)
+{
+    if (size != 0 && count > SIZE_MAX / size) {
+        return nullptr;
+    }
+
+    return arena_alloc(count * size, true);
+}
+
+void* sysv_realloc(void* ptr, size_t size)
+{
+    if (ptr == nullptr) {
+        return arena_alloc(size, false);
+    }
+
+    if (block_header* block = owned_block(ptr)) {
+        if (size == 0) {
+            arena_release(block);
+            return nullptr;
+        }
+        return arena_resize(ptr, block, size, false);
+    }
+
+    return realloc(ptr, size);
+}
+
+void sysv_free(void* ptr)
+{
+    if (block_header* block = owned_block(ptr)) {
+        arena_release(block);
+        return;
+    }
+
+    free(ptr);
+}
+
+} // namespace
+
+void arena_set_enabled(const bool value)
+{
+    enabled.store(value);
+}
+
+bool arena_enabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void arena_begin()
+{
+    arena_end();
+}
+
+arena_stats arena_end()
+{
+    arena_stats stats = arena.stats;
+    arena_chunk* keep = nullptr;
+
+    stats.leaked_allocations = arena.live_blocks;
+    stats.leaked_bytes       = arena.live_bytes;
+
+    //
+    // Keep one regular sized chunk around for the next job, free the rest.
+    // Pinned chunks are left to their last arena_unpin.
+    //
+    std::lock_guard<std::mutex> guard(pin_lock);
+
+    for (arena_chunk* chunk = arena.chunks; chunk != nullptr;) {
+        arena_chunk* next = chunk->next;
+        if (chunk->pins != 0) {
+            for (pinned_chunk& pinned : pinned_chunks) {
+                if (pinned.chunk == chunk) {
+                    pinned.detached = true;
+                }
+            }
+        } else if (keep == nullptr && chunk->size == chunk_size) {
+            keep = chunk;
+            keep->next = nullptr;
+            keep->used = 0;
+        } else {
+            free(chunk);
+        }
+        chunk = next;
+    }
+
+    arena = arena_state();
+    arena.chunks = keep;
+
+    return stats;
+}
+
+void arena_pin(const void* ptr)
+{
+    if (ptr == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(pin_lock);
+
+    for (pinned_chunk& pinned : pinned_chunks) {
+        if (chunk_holds(pinned.chunk, ptr)) {
+            pinned.chunk->pins++;
+            return;
+        }
+    }
+
+    for (arena_chunk* chunk = arena.chunks; chunk != nullptr; chunk = chunk->next) {
+        if (chunk_holds(chunk, ptr)) {
+            chunk->pins = 1;
+            pinned_chunks.push_back({ chunk, false });
+            return;
+        }
+    }
+}
+
+void arena_fork_prepare()
+{
+    pin_lock.lock();
+}
+
+void arena_fork_parent()
+{
+    pin_lock.unlock();
+}
+
+void arena_fork_child()
+{
+    new (&pin_lock) std::mutex();
+}
+
+void arena_unpin(const void* ptr)
+{
+    if (ptr == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(pin_lock);
+
+    for (auto it = pinned_chunks.begin(); it != pinned_chunks.end(); ++it) {
+        if (!chunk_holds(it->chunk, ptr)) {
+            continue;
+        }
+        if (--it->chunk->pins == 0) {
+            if (it->detached) {
+                free(it->chunk);
+            }
+            pinned_chunks.erase(it);
+        }
+        return;
+    }
+}
+
+void* arena_import(const char* library, const char* function)
+{
+    static const std::unordered_map<std::string, void*> functions = {
+        { "KERNEL32$HeapAlloc", reinterpret_cast<void*>(arena_HeapAlloc) },
+        { "KERNEL32$HeapReAlloc", reinterpret_cast<void*>(arena_HeapReAlloc) },
+        { "KERNEL32$HeapFree", reinterpret_cast<void*>(arena_HeapFree) },
+        { "KERNEL32$LocalAlloc", reinterpret_cast<void*>(arena_LocalAlloc) },
+        { "KERNEL32$LocalFree", reinterpret_cast<void*>(arena_LocalFree) },
+#ifndef _WIN32
+        // the real one is kept on Windows, its handle may go to other Heap* functions
+        { "KERNEL32$GetProcessHeap", reinterpret_cast<void*>(arena_GetProcessHeap) },
+#endif
+        { "MSVCRT$malloc", reinterpret_cast<void*>(arena_malloc) },
+        { "MSVCRT$calloc", reinterpret_cast<void*>(arena_calloc) },
+        { "MSVCRT$realloc", reinterpret_cast<void*>(arena_realloc) },
+        { "MSVCRT$free", reinterpret_cast<void*>(arena_free) },
+    };
+
+    std::string name = std::string(library) + "$" + function;
+    for (char& c : name) { // library names are case insensitive
+        if (c == '$') {
+            break;
+        }
+        c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+    }
+
+    const auto found = functions.find(name);
+    return found != functions.end() ? found->second : nullptr;
+}
+
+void* arena_sysv_import(const char* function)
+{
+    static const std::unordered_map<std::string, void*> functions = {
+        { "malloc", reinterpret_cast<void*>(sysv_malloc) },
+        { "calloc", reinterpret_cast<void*>(sysv_calloc) },
+        { "realloc", reinterpret_cast<void*>(sysv_realloc) },
+        { "free", reinterpret_cast<void*>(sysv_free) },
+    };
+
+    const auto found = functions.find(function);
+    return found != functions.end() ? found->second : nullptr;
+}
@@ -1,41 +1,60 @@
+#include <arena.hpp>
 #include <beacon_api.hpp>
+#include <footprint.hpp>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <unordered_map>
 
 /* Internal */
+thread_local std::string beacon_output; // one job per thread at a time
+thread_local std::string* beacon_output_buffer = nullptr;
+thread_local std::mutex* beacon_output_lock = nullptr;
+thread_local void (*beacon_output_sink)(const char*, size_t) = nullptr;
+
 void manip_beacon_output(
     _In_ char* str,
     _In_ const bool clear,
     _In_ const bool get,
     _Out_ std::string* out
 ){
-    static std::string buff;
+    if (!clear && !get && beacon_output_sink != nullptr) {
+        beacon_output_sink(str, strlen(str));
+        return;
+    }
+
+    std::unique_lock<std::mutex> guard;
+    if (beacon_output_lock != nullptr) {
+        guard = std::unique_lock<std::mutex>(*beacon_output_lock);
+    }
+
+    std::string& output = beacon_output_buffer != nullptr ? *beacon_output_buffer : beacon_output;
     if (clear) {
-        buff.clear();
+        output.clear();
     } else if (get) {
         if (out != nullptr) {
-            *out = buff;
+            *out = output;
         }
     } else {
-        buff += str;
+        output += str;
     }
 }
 
-void manip_token(
-    _In_ const bool clear,
-    _In_ HANDLE token,
-    _Out_ HANDLE* out
-){
-    static HANDLE curr_token = nullptr;
-    if (clear) {
-        if (curr_token != nullptr) {
-            CloseHandle(curr_token);
-            curr_token = nullptr;
-        }
-    } else if (token != nullptr) {
-        curr_token = token;
-    } else if (out != nullptr) {
-        *out = curr_token;
-    }
+void set_beacon_output_sink(void (*sink)(const char* data, size_t size))
+{
+    beacon_output_sink = sink;
+}
+
+void set_beacon_output_buffer(std::string* buffer, std::mutex* lock)
+{
+    beacon_output_buffer = buffer;
+    beacon_output_lock   = lock;
 }
 
 void clear_beacon_output()
@@ -50,25 +69,24 @@ std::string get_beacon_output()
     return out;
 }
 
-HANDLE get_curr_token()
+size_t beacon_output_capacity()
 {
-    HANDLE token = nullptr;
-    manip_token(false, nullptr, &token);
-    return token;
-}
-
-void set_curr_token(HANDLE token)
-{
-    if (!token || token == INVALID_HANDLE_VALUE) {
-        return;
+    std::unique_lock<std::mutex> guard;
+    if (beacon_output_lock != nullptr) {
+        guard = std::unique_lock<std::mutex>(*beacon_output_lock);
     }
 
-    manip_token(false, token, nullptr);
+    return beacon_output_buffer != nullptr ? beacon_output_buffer->capacity() : beacon_output.capacity();
 }
 
-void clear_curr_token()
+void* beacon_api_find(const beacon_api_entry* table, const size_t count, const char* name)
 {
-    manip_token(true, nullptr, nullptr);
+    const beacon_api_entry* end = table + count;
+    const beacon_api_entry* found = std::lower_bound(table, end, name, [](const beacon_api_entry& entry, const char* key) {
+        return strcmp(entry.name, key) < 0;
+    });
+
+    return found != end && strcmp(found->name, name) == 0 ? found->address : nullptr;
 }
 
 uint32_t swap_endianess(uint32_t indata)
@@ -84,7 +102,7 @@ uint32_t swap_endianess(uint32_t indata)
     return outint;
 }
 
-size_t char_to_wide_impl(wchar_t* dest, char* src, size_t max_allowed)
+size_t char_to_wide_impl(bof_wchar* dest, char* src, size_t max_allowed)
 {
     int len = static_cast<int>(max_allowed);
     while (--len >= 0) {
@@ -95,6 +113,82 @@ size_t char_to_wide_impl(wchar_t* dest, char* src, size_t max_allowed)
     return max_allowed - len;
 }
 
+namespace {
+thread_local const std::atomic<bool>* cancel_flag = nullptr;
+
+//
+// BeaconAddValue & co. The store belongs to the process, so a value one job
+// adds is there for every later job of a --batch or --watch run, on any
+// worker. Keys are spread over shards with a lock each; lookups take it
+// shared, so parallel readers of a cached value do not wait on one another.
+// Only the pointer is stored, what it points to is up to the BOF; under
+// --arena the allocation it points into is pinned until the value is removed.
+//
+constexpr size_t value_shard_count = 16;
+
+struct alignas(64) value_shard {
+    std::shared_mutex                       lock;
+    std::unordered_map<std::string, void*>  values;
+};
+
+value_shard value_shards[value_shard_count];
+
+value_shard& value_shard_of(const std::string& key)
+{
+    return value_shards[std::hash<std::string>{}(key) % value_shard_count];
+}
+
+//
+// Set inside of a --fork child, where a stored value is gone with the job
+//
+bool values_forked = false;
+std::once_flag values_forked_warning;
+
+void warn_forked_value()
+{
+    if (values_forked) {
+        std::call_once(values_forked_warning, []() {
+            fprintf(stderr, "[!] BeaconAddValue/BeaconRemoveValue in a --fork child only last until the job ends.\n");
+        });
+    }
+}
+}
+
+void set_beacon_cancel_flag(const std::atomic<bool>* flag)
+{
+    cancel_flag = flag;
+}
+
+const std::atomic<bool>* get_beacon_cancel_flag()
+{
+    return cancel_flag;
+}
+
+void beacon_fork_prepare()
+{
+    for (value_shard& shard : value_shards) {
+        shard.lock.lock();
+    }
+    arena_fork_prepare();
+}
+
+void beacon_fork_parent()
+{
+    arena_fork_parent();
+    for (size_t i = value_shard_count; i != 0; i--) {
+        value_shards[i - 1].lock.unlock();
+    }
+}
+
+void beacon_fork_child()
+{
+    arena_fork_child();
+    for (value_shard& shard : value_shards) {
+        new (&shard.lock) std::shared_mutex();
+    }
+    values_forked = true;
+}
+
 /* used by BOFs */
 // implementations are mostly borrowed with some exceptions.
 void BeaconDataParse(datap* parser, char* buffer, int size)
@@ -171,10 +265,14 @@ void BeaconFormatAlloc(formatp* format, int maxsz)
         return;
     }
 
-    format->original = static_cast<char*>(HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, maxsz));
+    format->original = static_cast<char*>(calloc(maxsz, 1));
     format->buffer = format->original;
     format->length = 0;
     format->size = maxsz;
+
+    if (format->original != nullptr) {
+        footprint_format(maxsz);
+    }
 }
 
 void BeaconFormatReset(formatp* format)
@@ -198,20 +296,20 @@ void BeaconOutput(int type, char* data, int len)
 
 void BeaconFormatPrintf(formatp* format, char* fmt, ...)
 {
-    va_list args = { 0 };
+    bof_va_list args;
     int length = 0;
 
-    va_start(args, fmt);
-    length = vsnprintf(nullptr, 0, fmt, args);
-    va_end(args);
+    bof_va_start(args, fmt);
+    length = bof_vsnprintf(nullptr, 0, fmt, args);
+    bof_va_end(args);
 
     if (format->length + length > format->size) {
         return;
     }
 
-    va_start(args, fmt);
-    vsnprintf(format->buffer, length, fmt, args);
-    va_end(args);
+    bof_va_start(args, fmt);
+    bof_vsnprintf(format->buffer, length, fmt, args);
+    bof_va_end(args);
 
     format->length += length;
     format->buffer += length;
@@ -229,8 +327,9 @@ void BeaconFormatFree(formatp* format)
         return;
 
     if (format->original != nullptr) {
-        HeapFree(GetProcessHeap(), 0, format->original);
+        free(format->original);
         format->original = nullptr;
+        footprint_format(-static_cast<int64_t>(format->size));
     }
 
     format->buffer = nullptr;
@@ -255,294 +354,97 @@ void BeaconFormatInt(formatp* format, int value)
 
 void BeaconPrintf(int type, char* fmt, ...)
 {
-    va_list VaList = nullptr;
+    bof_va_list VaList;
     char* buff = nullptr;
 
-    va_start(VaList, fmt);
-    int len = vsnprintf(nullptr, 0, fmt, VaList);
-    if (!len) {
-        va_end(VaList);
+    bof_va_start(VaList, fmt);
+    int len = bof_vsnprintf(nullptr, 0, fmt, VaList);
+    bof_va_end(VaList);
+    if (len <= 0) {
         return;
     }
 
-    buff = static_cast<char*>(HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, len + 2));
+    buff = static_cast<char*>(calloc(len + 2, 1));
     if (!buff) {
-        va_end(VaList);
         return;
     }
 
-    vsnprintf(buff, len + 1, fmt, VaList);
-    manip_beacon_output(buff, false, false, nullptr);
+    bof_va_start(VaList, fmt); // a va_list can only be walked once outside of Windows
+    bof_vsnprintf(buff, len + 1, fmt, VaList);
+    bof_va_end(VaList);
 
-    va_end(VaList);
+    manip_beacon_output(buff, false, false, nullptr);
     memset(buff, 0, len);
-    HeapFree(GetProcessHeap(), 0, buff);
-}
-
-BOOL BeaconIsAdmin()
-{
-    HANDLE htoken = nullptr;
-    TOKEN_ELEVATION elevation = { 0 };
-    uint32_t bytes_needed = 0;
-
-    if (!OpenProcessToken(
-         GetCurrentProcess(),
-         TOKEN_QUERY,
-         &htoken
-    )) {
-        return FALSE;
-    }
-
-    if (!GetTokenInformation(
-         htoken,
-         TokenElevation,
-         &elevation,
-         sizeof(elevation),
-         reinterpret_cast<PDWORD>(&bytes_needed)
-    )) {
-        CloseHandle(htoken);
-        return FALSE;
-    }
-
-    CloseHandle(htoken);
-    return (elevation.TokenIsElevated != 0 ? TRUE : FALSE);
+    free(buff);
 }
 
-//
-// 1. Revert the current token to the original
-// 2. Duplicate the provided token to a primary token with SecurityDelegation
-// 3. Call ImpersonateLoggedOnUser to impersonate the new primary token
-//
-
-BOOL BeaconUseToken(HANDLE token)
+BOOL toWideChar(char* src, bof_wchar* dst, int max)
 {
-    HANDLE hduplicate_token = nullptr;
-    BeaconRevertToken();
-
-    if (!DuplicateTokenEx(
-         token,
-         MAXIMUM_ALLOWED,
-         nullptr,
-         SecurityDelegation,
-         TokenPrimary,
-         &hduplicate_token
-    )) {
-        return FALSE;
-    }
-
-    if (!ImpersonateLoggedOnUser(hduplicate_token)) {
+    const size_t length = char_to_wide_impl(dst, src, max);
+    if (length == 0) {
         return FALSE;
     }
 
-    set_curr_token(hduplicate_token);
     return TRUE;
 }
 
-void BeaconRevertToken()
+BOOL BeaconIsCancelled()
 {
-    clear_curr_token();
-    RevertToSelf();
+    return (cancel_flag != nullptr && cancel_flag->load(std::memory_order_relaxed)) ? TRUE : FALSE;
 }
 
-void BeaconGetSpawnTo(BOOL x86, char* buffer, int length)
+BOOL BeaconAddValue(const char* key, void* ptr)
 {
-    wchar_t ext[] = L"\\System32\\RuntimeBroker.exe";
-    wchar_t windows_dir[MAX_PATH] = { 0 };
-    wchar_t final[MAX_PATH] = { 0 };
-    unsigned int len = 0;
-    unsigned int size = 0;
-
-    //-----------------------------------------------------------------//
-
-    if (x86) { // not supported
-        return;
-    }
-
-    len = GetWindowsDirectoryW(windows_dir, MAX_PATH);
-    if (!len) {
-        return;
+    if (key == nullptr) {
+        return FALSE;
     }
 
-    //
-    // note: "len" will contain the length in characters, NOT in bytes.
-    //
+    std::string name = key;
+    value_shard& shard = value_shard_of(name);
 
-    memcpy(final, windows_dir, len * sizeof(wchar_t));
-    memcpy(&final[len], ext, sizeof(ext));
+    warn_forked_value();
 
-    size = wcslen(final) * sizeof(wchar_t);
-    if (size > length) {
-        return;
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    if (!shard.values.emplace(std::move(name), ptr).second) {
+        return FALSE;
     }
 
-    memcpy(buffer, final, size);
+    arena_pin(ptr);
+    return TRUE;
 }
 
-BOOL BeaconSpawnTemporaryProcess(BOOL x86, BOOL ignoreToken, STARTUPINFO* si, PROCESS_INFORMATION* pInfo)
+void* BeaconGetValue(const char* key)
 {
-    HANDLE htoken = nullptr;
-    wchar_t path[MAX_PATH] = { 0 };
-
-    BeaconGetSpawnTo(FALSE, (char*)path, sizeof(path));
-    htoken = get_curr_token();
-
-    if (x86 || path[0] == L'\0' || (!ignoreToken && htoken == nullptr)) {
-        return FALSE;
-    }
-
-    if (ignoreToken) {
-        return CreateProcessW(
-            nullptr,
-            path,
-            nullptr,
-            nullptr,
-            TRUE,
-            CREATE_NO_WINDOW,
-            nullptr,
-            nullptr,
-            (LPSTARTUPINFOW)si,
-            pInfo);
-    }
-
-    return CreateProcessAsUserW(
-        htoken,
-        nullptr,
-        path,
-        nullptr,
-        nullptr,
-        TRUE,
-        CREATE_NO_WINDOW,
-        nullptr,
-        nullptr,
-        (LPSTARTUPINFOW)si,
-        pInfo
-    );
-}
-
-void BeaconInjectTemporaryProcess(
-    PROCESS_INFORMATION* pInfo,
-    char* payload,
-    int p_len,
-    int p_offset,
-    char* arg,
-    int a_len)
-{
-    char* remote_payload = nullptr;
-    char* remote_args = nullptr;
-    HANDLE hthread = nullptr;
-    size_t bytes_written = 0;
-
-    if (payload == nullptr || !p_len) {
-        return;
-    }
-
-    remote_payload = static_cast<char*>(VirtualAllocEx(
-        pInfo->hProcess,
-        nullptr,
-        p_len,
-        MEM_COMMIT | MEM_RESERVE,
-        PAGE_EXECUTE_READWRITE)
-    );
-
-    if (remote_payload == nullptr) {
-        return;
-    }
-
-    if (!WriteProcessMemory(
-         pInfo->hProcess,
-         remote_payload,
-         payload,
-         p_len,
-         &bytes_written)
-        || bytes_written != p_len)
-    {
-        return;
+    if (key == nullptr) {
+        return nullptr;
     }
 
-    if (arg != nullptr && a_len) {
-        remote_args = static_cast<char*>(VirtualAllocEx(
-            pInfo->hProcess,
-            nullptr,
-            a_len,
-            MEM_COMMIT | MEM_RESERVE,
-            PAGE_EXECUTE_READWRITE
-        ));
-
-        if (remote_args == nullptr) {
-            return;
-        }
-
-        bytes_written = 0;
-        if (!WriteProcessMemory(
-             pInfo->hProcess,
-             remote_args,
-             arg,
-             a_len,
-             &bytes_written)
-            || bytes_written != a_len)
-        {
-            return;
-        }
-    }
+    const std::string name = key;
+    value_shard& shard = value_shard_of(name);
 
-    //
-    // this is a random ass fork & run BOF function nobody should use anyways,
-    // so frankly I don't give a flying fuck
-    //
-    hthread = CreateRemoteThread(
-        pInfo->hProcess,
-        nullptr,
-        0,
-        (LPTHREAD_START_ROUTINE)(remote_payload + p_offset),
-        remote_args,
-        0,
-        nullptr
-    );
-
-    if (hthread != nullptr) {
-        CloseHandle(hthread);
-    }
+    std::shared_lock<std::shared_mutex> guard(shard.lock);
+    const auto found = shard.values.find(name);
+    return found != shard.values.end() ? found->second : nullptr;
 }
 
-void BeaconInjectProcess(
-    HANDLE hProc,
-    int pid,
-    char* payload,
-    int p_len,
-    int p_offset,
-    char* arg,
-    int a_len
-) {
-    if (hProc == nullptr) {
-        hProc = OpenProcess(PROCESS_ALL_ACCESS, FALSE, pid);
-        if (hProc == nullptr) {
-            return;
-        }
+BOOL BeaconRemoveValue(const char* key)
+{
+    if (key == nullptr) {
+        return FALSE;
     }
 
-    PROCESS_INFORMATION proc_info = { 0 };
-    proc_info.hProcess = hProc;
-    proc_info.dwProcessId = pid;
+    const std::string name = key;
+    value_shard& shard = value_shard_of(name);
 
-    BeaconInjectTemporaryProcess(&proc_info, payload, p_len, p_offset, arg, a_len);
-}
+    warn_forked_value();
 
-void BeaconCleanupProcess(PROCESS_INFORMATION* pInfo)
-{
-    if (pInfo->hProcess != nullptr) {
-        CloseHandle(pInfo->hProcess);
-    }
-    if (pInfo->hThread != nullptr) {
-        CloseHandle(pInfo->hThread);
-    }
-}
-
-BOOL toWideChar(char* src, wchar_t* dst, int max)
-{
-    const size_t length = char_to_wide_impl(dst, src, max);
-    if (length == 0) {
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    const auto found = shard.values.find(name);
+    if (found == shard.values.end()) {
         return FALSE;
     }
 
+    arena_unpin(found->second);
+    shard.values.erase(found);
     return TRUE;
 }
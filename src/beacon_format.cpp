@@ -0,0 +1,273 @@
+#include <beacon_api.hpp>
+
+#if !defined(_WIN32) && BOF_NATIVE_EXECUTION
+#include <cstring>
+#include <string>
+
+//
+// vsnprintf for Windows x64 varargs. The C library cannot walk an ms_abi va_list,
+// so each conversion is pulled out of it here, using Windows type sizes (long is
+// 32 bits, %ls/%S are UTF-16), and formatted on its own through snprintf.
+//
+
+namespace {
+
+//
+// A single conversion specification, e.g. "%-08.3lld".
+//
+struct format_spec {
+    char   text[48] = { '%' };
+    size_t length   = 1;
+
+    void push(const char c) {
+        if (length < sizeof(text) - 4) { // leave room for "ll", the conversion and the terminator
+            text[length++] = c;
+        }
+    }
+
+    void push_int(const int value) {
+        char digits[16];
+        const int count = snprintf(digits, sizeof(digits), "%d", value);
+        for (int i = 0; i < count; i++) {
+            push(digits[i]);
+        }
+    }
+
+    const char* with(const char* suffix) {
+        size_t i = length;
+        while (*suffix != '\0') {
+            text[i++] = *suffix++;
+        }
+        text[i] = '\0';
+        return text;
+    }
+};
+
+template<typename T>
+void append_formatted(std::string& out, const char* spec, T value)
+{
+    const size_t old_size = out.size();
+
+    //
+    // Most conversions are short, so try formatting into spare capacity first.
+    //
+    out.resize(old_size + 64);
+    const int length = snprintf(&out[old_size], 64, spec, value);
+    if (length <= 0) {
+        out.resize(old_size);
+        return;
+    }
+
+    if (length >= 64) {
+        out.resize(old_size + length + 1);
+        snprintf(&out[old_size], length + 1, spec, value);
+    }
+
+    out.resize(old_size + length);
+}
+
+void append_utf8(std::string& out, uint32_t code_point)
+{
+    if (code_point < 0x80) {
+        out += static_cast<char>(code_point);
+    } else if (code_point < 0x800) {
+        out += static_cast<char>(0xC0 | (code_point >> 6));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        out += static_cast<char>(0xE0 | (code_point >> 12));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code_point >> 18));
+        out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+std::string utf16_to_utf8(const bof_wchar* str, const int max_units)
+{
+    std::string out;
+    if (str == nullptr) {
+        return "(null)";
+    }
+
+    for (int i = 0; str[i] != 0 && (max_units < 0 || i < max_units); i++) {
+        uint32_t code_point = str[i];
+        if (code_point >= 0xD800 && code_point <= 0xDBFF && str[i + 1] >= 0xDC00 && str[i + 1] <= 0xDFFF) {
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) + (str[i + 1] - 0xDC00);
+            i++;
+        }
+        append_utf8(out, code_point);
+    }
+
+    return out;
+}
+
+} // namespace
+
+int bof_vsnprintf(char* buffer, const size_t size, const char* fmt, bof_va_list args)
+{
+    thread_local std::string out;
+    format_spec spec;
+    char suffix[2] = { 0 };
+    char suffix_64[4] = { 'l', 'l', 0, 0 };
+
+    out.clear();
+
+    for (const char* p = fmt; *p != '\0'; p++) {
+        if (*p != '%') {
+            out += *p;
+            continue;
+        }
+
+        if (*(++p) == '%') {
+            out += '%';
+            continue;
+        }
+
+        spec = format_spec();
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+            spec.push(*p++);
+        }
+
+        //
+        // width and precision, '*' takes them from the argument list
+        //
+        int precision = -1;
+        if (*p == '*') {
+            spec.push_int(__builtin_va_arg(args, int));
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') {
+                spec.push(*p++);
+            }
+        }
+
+        if (*p == '.') {
+            spec.push(*p++);
+            if (*p == '*') {
+                precision = __builtin_va_arg(args, int);
+                spec.push_int(precision);
+                p++;
+            } else {
+                precision = 0;
+                while (*p >= '0' && *p <= '9') {
+                    precision = precision * 10 + (*p - '0');
+                    spec.push(*p++);
+                }
+            }
+        }
+
+        //
+        // length modifiers, in Windows sizes
+        //
+        bool is_64 = false;
+        bool is_wide = false;
+        if (p[0] == 'I' && p[1] == '6' && p[2] == '4') {
+            is_64 = true;
+            p += 3;
+        } else if (p[0] == 'I' && p[1] == '3' && p[2] == '2') {
+            p += 3;
+        } else if (*p == 'I' || *p == 'z' || *p == 'j' || *p == 't') {
+            is_64 = true;
+            p++;
+        } else if (p[0] == 'l' && p[1] == 'l') {
+            is_64 = true;
+            p += 2;
+        } else if (*p == 'l' || *p == 'w') {
+            is_wide = true; // long is 32 bits, only matters for %lc/%ls
+            p++;
+        } else if (p[0] == 'h' && p[1] == 'h') {
+            spec.push('h');
+            spec.push('h');
+            p += 2;
+        } else if (*p == 'h' || *p == 'L') {
+            if (*p == 'h') {
+                spec.push('h');
+            }
+            p++;
+        }
+
+        const char conversion = *p;
+        suffix[0] = conversion;
+        suffix_64[2] = conversion;
+        switch (conversion) {
+        case 'd':
+        case 'i':
+            if (is_64) {
+                append_formatted(out, spec.with(suffix_64), __builtin_va_arg(args, long long));
+            } else {
+                append_formatted(out, spec.with(suffix), __builtin_va_arg(args, int));
+            }
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            if (is_64) {
+                append_formatted(out, spec.with(suffix_64), __builtin_va_arg(args, unsigned long long));
+            } else {
+                append_formatted(out, spec.with(suffix), __builtin_va_arg(args, unsigned int));
+            }
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            append_formatted(out, spec.with(suffix), __builtin_va_arg(args, double));
+            break;
+        case 'p':
+            append_formatted(out, spec.with(suffix), __builtin_va_arg(args, void*));
+            break;
+        case 'c':
+        case 'C':
+            if (is_wide || conversion == 'C') {
+                std::string utf8;
+                append_utf8(utf8, static_cast<bof_wchar>(__builtin_va_arg(args, int)));
+                append_formatted(out, spec.with("s"), utf8.c_str());
+            } else {
+                append_formatted(out, spec.with("c"), __builtin_va_arg(args, int));
+            }
+            break;
+        case 's':
+        case 'S':
+            if (is_wide || conversion == 'S') {
+                const std::string utf8 = utf16_to_utf8(__builtin_va_arg(args, bof_wchar*), precision);
+                append_formatted(out, spec.with("s"), utf8.c_str());
+            } else {
+                const char* str = __builtin_va_arg(args, char*);
+                if (spec.length == 1) { // plain "%s", nothing to pad or truncate
+                    out.append(str != nullptr ? str : "(null)");
+                } else {
+                    append_formatted(out, spec.with("s"), str != nullptr ? str : "(null)");
+                }
+            }
+            break;
+        case 'n':
+            *__builtin_va_arg(args, int*) = static_cast<int>(out.size());
+            break;
+        case '\0':
+            p--; // dangling '%' at the end of the format string
+            break;
+        default:
+            out.append(spec.text, spec.length);
+            out += conversion;
+            break;
+        }
+    }
+
+    if (size != 0 && buffer != nullptr) {
+        const size_t copied = out.size() < size - 1 ? out.size() : size - 1;
+        memcpy(buffer, out.data(), copied);
+        buffer[copied] = '\0';
+    }
+
+    return static_cast<int>(out.size());
+}
+
+#endif
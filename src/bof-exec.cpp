@@ -1,437 +1,608 @@
-#include <BOF-exec.hpp>
+#include <bof-exec.hpp>
 
-uint32_t object_virtual_size(object_context* ctx)
+void sig_handle_ctrlc(int signal)
 {
-    PIMAGE_RELOCATION obj_rel  = nullptr;
-    PIMAGE_SYMBOL obj_sym      = nullptr;
-    char* symbol_name          = nullptr;
-    uint32_t total_size        = 0;
+    std::cout << std::endl;
+    std::cout << "[*] Keyboard interrupt received. Exiting..." << std::endl;
+    std::exit(signal);
+}
 
-    //
-    // Add up each page aligned section size.
-    //
-    for (size_t i = 0; i < ctx->header->NumberOfSections; i++) {
-        total_size += PAGE_ALIGN(ctx->sections[i].SizeOfRawData);
-    }
-
-    for (size_t i = 0; i < ctx->header->NumberOfSections; i++) {
-        obj_rel = reinterpret_cast<PIMAGE_RELOCATION>(ctx->base + ctx->sections[i].PointerToRelocations);
-        for (size_t j = 0; j < ctx->sections[i].NumberOfRelocations; j++) {
-            obj_sym = &ctx->sym_table[obj_rel->SymbolTableIndex];
-
-            //
-            // get symbol name
-            //
-            if (obj_sym->N.Name.Short) {
-                symbol_name = reinterpret_cast<char*>(obj_sym->N.ShortName); // short name (> 8 bytes)
-            } else {
-                symbol_name = reinterpret_cast<char*>(PTR_TO_U64(ctx->sym_table + ctx->header->NumberOfSymbols) + INT_TO_U64(obj_sym->N.Name.Long));
-            }
+bool parse_option_u32(const char* value, uint32_t& out)
+{
+    const char* end = value + strlen(value);
+    const auto [ptr, ec] = std::from_chars(value, end, out);
+    return ec == std::errc() && ptr == end;
+}
 
-            //
-            // Only if the symbol is external
-            //
-            if (strncmp("__imp_", symbol_name, 6) == 0) {
-                total_size += sizeof(void*);
+void print_arena_stats(const arena_stats& stats)
+{
+    std::cout << "[*] Arena: " << stats.allocations << " allocations, "
+              << stats.frees << " frees, peak " << stats.peak_bytes << " bytes";
+    if (stats.leaked_allocations != 0) {
+        std::cout << ", reclaimed " << stats.leaked_allocations << " leaked allocations ("
+                  << stats.leaked_bytes << " bytes)";
+    }
+    std::cout << std::endl;
+}
+
+void print_perf_stats(const perf_stats& stats)
+{
+    std::cout << "[*] Counters (hardware counters are user mode only):" << std::endl;
+    std::cout << "    " << std::left << std::setw(10) << "phase" << std::right << std::setw(12) << "ms";
+    for (uint32_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (stats.available & (1u << i)) {
+            std::cout << std::setw(18) << perf_counter_name(static_cast<perf_counter>(i));
+        }
+    }
+    std::cout << std::endl;
+
+    for (uint32_t phase = 0; phase < PERF_PHASE_COUNT; phase++) {
+        const perf_sample& sample = stats.phases[phase];
+        const bool in_child = phase == PERF_PHASE_EXECUTE && fork_enabled(); // the counters only saw the waiting parent
+
+        std::cout << "    " << std::left << std::setw(10) << perf_phase_name(static_cast<perf_phase>(phase))
+                  << std::right << std::setw(12) << std::fixed << std::setprecision(3) << sample.elapsed_ms;
+        for (uint32_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+            if (stats.available & (1u << i)) {
+                if (in_child) {
+                    std::cout << std::setw(18) << "-";
+                } else {
+                    std::cout << std::setw(18) << sample.values[i];
+                }
             }
-            obj_rel = reinterpret_cast<PIMAGE_RELOCATION>(PTR_TO_U64(obj_rel) + sizeof(IMAGE_RELOCATION));
         }
+        std::cout << std::defaultfloat << std::endl;
+    }
+}
+
+//
+// The job's own memory adds up to the object file, its image, output and
+// format buffers and, with --arena, the arena's peak. Heap allocations outside
+// of the arena are only part of the process wide peak.
+//
+void print_footprint_stats(const footprint_stats& stats, const arena_stats& arena)
+{
+    const uint64_t total = stats.object_bytes + stats.image_bytes + stats.output_high_water
+                         + stats.format_high_water + arena.peak_bytes;
+
+    std::cout << "[*] Memory: " << total << " bytes for the job, object " << stats.object_bytes
+              << ", image " << stats.image_bytes << " (";
+    for (uint32_t i = 0; i < FOOTPRINT_CLASS_COUNT; i++) {
+        std::cout << (i ? ", " : "") << footprint_class_name(static_cast<footprint_class>(i)) << " " << stats.committed[i];
     }
+    std::cout << "), sections " << stats.section_bytes << ", padding " << stats.padding_bytes << std::endl;
 
-    return PAGE_ALIGN(total_size); // align the size to a page boundary on return
+    std::cout << "[*] Memory: import slots " << stats.import_slots_filled << " of " << stats.import_slots << " filled ("
+              << stats.import_slots * sizeof(void*) << " of " << stats.import_area_bytes << " bytes), output buffer "
+              << stats.output_high_water << ", format buffers " << stats.format_high_water
+              << ", process peak working set " << stats.peak_working_set << std::endl;
 }
 
-bool object_execute(object_context* ctx, const char* entry, char* args, const uint32_t argc)
+//
+// Points object_path at the stored object if it names a catalog entry.
+//
+bool resolve_catalog_name(const catalog* cat, std::string& object_path)
 {
-    void (*main)(char*, uint32_t)  = nullptr;
-    PIMAGE_SYMBOL symbol           = nullptr;
-    char* symbol_name              = nullptr;
-    void* section_base             = nullptr;
-    uint32_t section_size          = 0;
-    uint32_t old_protect           = 0;
-
-    for (size_t i = 0; i < ctx->header->NumberOfSymbols; i++) {
-        symbol = &ctx->sym_table[i];
-        if (symbol->N.Name.Short) { // if the symbol has a short name
-            symbol_name = reinterpret_cast<char*>(symbol->N.ShortName);
-        } else {
-            symbol_name = reinterpret_cast<char*>(PTR_TO_U64(ctx->sym_table + ctx->header->NumberOfSymbols) + INT_TO_U64(symbol->N.Name.Long));
-        }
-
-        if (ISFCN(ctx->sym_table[i].Type) && strcmp(entry, symbol_name) == 0) {
-            section_base = ctx->sec_map[symbol->SectionNumber - 1].base;
-            section_size = ctx->sec_map[symbol->SectionNumber - 1].size;
-
-            //
-            // Change the section where the symbol is to R/X
-            //
-            if (!VirtualProtect(
-                 section_base,
-                 section_size,
-                 PAGE_EXECUTE_READ,
-                 reinterpret_cast<PDWORD>(&old_protect)
-            )) {
-                return false;
-            }
+    const catalog_record* record = cat != nullptr ? cat->find(object_path) : nullptr;
+    if (cat != nullptr) {
+        metrics_add(record != nullptr ? METRIC_CATALOG_HITS : METRIC_CATALOG_MISSES);
+    }
+    if (record == nullptr) {
+        return false;
+    }
 
-            //
-            // Call the function
-            //
-            main = reinterpret_cast<decltype(main)>(PTR_TO_U64(section_base) + symbol->Value);
-            main(args, argc);
-
-            //
-            // Restore previous protection
-            //
-            if (!VirtualProtect(
-                 section_base,
-                 section_size,
-                 old_protect,
-                 reinterpret_cast<PDWORD>(&old_protect)
-            )) {
-                return false;
-            }
+    if (!log_quiet()) {
+        std::cout << "[*] Catalog: " << object_path << " -> " << catalog_hash_string(record->hash).substr(0, 16)
+                  << " (" << record->file_size << " bytes, " << record->import_count << " imports)" << std::endl;
+    }
+    object_path = cat->object_path(*record);
+    return true;
+}
 
-            return true;
-        }
+//
+// --class-limit <class>=<n>
+//
+bool parse_class_limit(const char* value, scheduler_limits& limits)
+{
+    const char* equals = strchr(value, '=');
+    uint32_t limit = 0;
+
+    if (equals == nullptr || !parse_option_u32(equals + 1, limit)) {
+        return false;
+    }
+
+    const auto priority = job_priority_from_name(std::string_view(value, equals - value));
+    if (!priority) {
+        return false;
     }
 
-    return false;
+    limits.class_limit[*priority] = limit;
+    return true;
 }
 
-void* resolve_object_symbol(const char* symbol)
+//
+// Everything a one-shot or quiet batch run has to say about the BOF goes out in one write,
+// after whatever was printed before it.
+//
+void write_results(const std::string& results)
 {
-    std::string function;
-    std::string library;
-    void* resolved_func = nullptr;
-
-    static const std::map<std::string, void*> api_pairs = {
-        { "BeaconOutput", BeaconOutput },
-        { "BeaconPrintf", BeaconPrintf },
-        { "BeaconDataParse", BeaconDataParse },
-        { "BeaconDataInt", BeaconDataInt },
-        { "BeaconDataShort", BeaconDataShort },
-        { "BeaconDataLength", BeaconDataLength },
-        { "BeaconDataExtract", BeaconDataExtract },
-        { "BeaconIsAdmin", BeaconIsAdmin },
-        { "BeaconUseToken", BeaconUseToken },
-        { "BeaconRevertToken", BeaconRevertToken },
-        { "BeaconFormatAlloc", BeaconFormatAlloc },
-        { "BeaconFormatReset", BeaconFormatReset },
-        { "BeaconFormatAppend", BeaconFormatAppend },
-        { "BeaconFormatPrintf", BeaconFormatPrintf },
-        { "BeaconFormatToString", BeaconFormatToString },
-        { "BeaconFormatFree", BeaconFormatFree },
-        { "BeaconFormatInt", BeaconFormatInt },
-        { "BeaconGetSpawnTo", BeaconGetSpawnTo },
-        { "BeaconSpawnTemporaryProcess", BeaconSpawnTemporaryProcess },
-        { "BeaconInjectTemporaryProcess", BeaconInjectTemporaryProcess },
-        { "BeaconInjectProcess", BeaconInjectProcess },
-        { "BeaconCleanupProcess", BeaconCleanupProcess },
-        { "toWideChar", toWideChar },
-    };
-
-    if (symbol == nullptr || strncmp("__imp_", symbol, 6) != 0) {
-        return nullptr;
-    }
-
-    symbol += 6; // move past the "__imp_" string
+    std::cout.flush();
+    fwrite(results.data(), 1, results.size(), stdout);
+    fflush(stdout);
+}
 
-    //
-    // if the symbol is a Beacon API function, check which one it is.
-    //
-    if (strncmp("Beacon", symbol, 6) == 0) {
+int run_batch(const std::string& batch_file, const uint32_t timeout_ms, const uint32_t workers, const scheduler_limits& limits,
+              const catalog* cat)
+{
+    size_t counts[JOB_TIMED_OUT + 1] = { 0 };
 
-        if (const auto found = api_pairs.find(symbol); found != api_pairs.end()) {
-            resolved_func = found->second;
-        } else {
-            clear_beacon_output();
-            manip_beacon_output((char*)(std::string("Unsupported beacon function: ") + symbol).c_str(), false, false, nullptr);
-            return nullptr;
-        }
+    auto jobs = read_job_file(batch_file, timeout_ms);
+    if (!jobs) {
+        return EXIT_FAILURE;
     }
 
+    for (job& j : *jobs) {
+        resolve_catalog_name(cat, j.object_path);
+    }
+
+    if (!log_quiet()) {
+        std::cout << "[*] Running " << jobs->size() << " jobs on " << workers << " workers..." << std::endl;
+    }
+
+    worker_pool pool(workers, limits);
+    for (job& j : *jobs) {
+        pool.submit(&j);
+    }
+    pool.wait();
+
     //
-    // otherwise we need to resolve the symbol via GetProcAddress/LoadLibrary
+    // Quiet runs only print the jobs' output, in job order, in one write
     //
-    else {
-        const std::string obj = symbol;
-        const size_t pos = obj.find_first_of('$');
-        HMODULE hmod = nullptr;
+    std::string results;
+
+    for (size_t i = 0; i < jobs->size(); i++) {
+        const job& j = (*jobs)[i];
+        counts[j.status]++;
 
-        if (pos == std::string::npos) {
-            return nullptr;
+        if (log_quiet()) {
+            results += j.output;
+        } else {
+            std::cout << "[*] Job " << i + 1 << ": " << j.object_path
+                      << (j.arguments.empty() ? "" : " (" + j.arguments + ")")
+                      << (j.priority != JOB_NORMAL ? std::string(" [") + job_priority_name(j.priority) + "]" : "")
+                      << " -> " << job_status_name(j.status) << " in " << j.elapsed_ms << " ms"
+                      << " after " << j.queued_ms << " ms queued" << std::endl;
+        }
+        if (arena_enabled()) {
+            print_arena_stats(j.arena);
+        }
+        if (perf_enabled()) {
+            print_perf_stats(j.perf);
         }
+        if (footprint_enabled()) {
+            print_footprint_stats(j.footprint, j.arena);
+        }
+        if (!j.output.empty() && !log_quiet()) {
+            std::cout << j.output << std::endl;
+        }
+    }
 
-        library = obj.substr(0, pos);
-        function = obj.substr(pos + 1);
+    if (log_quiet()) {
+        write_results(results);
+        return counts[JOB_SUCCEEDED] == jobs->size() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-        if (!(hmod = GetModuleHandleA(library.c_str())) && !(hmod = LoadLibraryA(library.c_str()))) {
-            return nullptr;
+    for (uint32_t i = 0; i < JOB_PRIORITY_COUNT; i++) {
+        const queue_wait_stats wait = pool.queue_wait(static_cast<job_priority>(i));
+        if (wait.jobs != 0) {
+            std::cout << "[*] Queue wait, " << job_priority_name(static_cast<job_priority>(i)) << ": " << wait.jobs << " jobs, mean "
+                      << wait.mean_ms << " ms, p50 " << wait.p50_ms << " ms, p99 " << wait.p99_ms << " ms, max " << wait.max_ms << " ms" << std::endl;
         }
+    }
 
-        resolved_func = GetProcAddress(hmod, function.c_str());
-        if (!resolved_func) {
-            return nullptr;
-        }
+    if (const uint32_t replaced = pool.replaced_workers()) {
+        std::cout << "[*] Replaced " << replaced << " hung worker(s)." << std::endl;
     }
 
-    return resolved_func;
-}
+    std::cout << "[+] Finished " << jobs->size() << " jobs: "
+              << counts[JOB_SUCCEEDED] << " succeeded, "
+              << counts[JOB_FAILED] << " failed, "
+              << counts[JOB_TIMED_OUT] << " timed out." << std::endl;
 
-void object_relocation(const uint32_t type, void* needs_relocating, void* section_base)
-{
-    switch (type) {
-    case IMAGE_REL_AMD64_REL32:
-        *(uint32_t*)needs_relocating = (*(uint32_t*)(needs_relocating)) + (unsigned long)(PTR_TO_U64(section_base) - PTR_TO_U64(needs_relocating) - sizeof(UINT32));
-        break;
-    case IMAGE_REL_AMD64_REL32_1:
-        *(uint32_t*)needs_relocating = (*(uint32_t*)(needs_relocating)) + (unsigned long)(PTR_TO_U64(section_base) - PTR_TO_U64(needs_relocating) - sizeof(UINT32) - 1);
-        break;
-    case IMAGE_REL_AMD64_REL32_2:
-        *(uint32_t*)needs_relocating = (*(uint32_t*)(needs_relocating)) + (unsigned long)(PTR_TO_U64(section_base) - PTR_TO_U64(needs_relocating) - sizeof(UINT32) - 2);
-        break;
-    case IMAGE_REL_AMD64_REL32_3:
-        *(uint32_t*)needs_relocating = (*(uint32_t*)(needs_relocating)) + (unsigned long)(PTR_TO_U64(section_base) - PTR_TO_U64(needs_relocating) - sizeof(UINT32) - 3);
-        break;
-    case IMAGE_REL_AMD64_REL32_4:
-        *(uint32_t*)needs_relocating = (*(uint32_t*)(needs_relocating)) + (unsigned long)(PTR_TO_U64(section_base) - PTR_TO_U64(needs_relocating) - sizeof(UINT32) - 4);
-        break;
-    case IMAGE_REL_AMD64_REL32_5:
-        *(uint32_t*)needs_relocating = (*(uint32_t*)(needs_relocating)) + (unsigned long)(PTR_TO_U64(section_base) - PTR_TO_U64(needs_relocating) - sizeof(UINT32) - 5);
-        break;
-    case IMAGE_REL_AMD64_ADDR64:
-        *(uint64_t*)needs_relocating = (*(uint64_t*)(needs_relocating)) + PTR_TO_U64(section_base);
-        break;
-    default:
-        break;
-    }
+    return counts[JOB_SUCCEEDED] == jobs->size() ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-bool process_object_sections(object_context* ctx)
+//
+// Runs the BOF, and again with the same arguments every time the object file
+// changes, until interrupted. The image stays mapped between runs.
+//
+int run_watch(const std::string& object_path, const std::string& arguments)
 {
-    void* section_base             = nullptr;
-    void* resolved_addr            = nullptr;
-    void* needs_resolving          = nullptr;
-    uint32_t func_index            = 0;
-    PIMAGE_RELOCATION relocation   = nullptr;
-    PIMAGE_SYMBOL symbol           = nullptr;
-    char* symbol_name              = nullptr;
+    loaded_image image;
+    platform_watch* watch = platform_watch_open(object_path.c_str());
 
-    //---------------------------------------------------//
-
-    for (size_t i = 0; i < ctx->header->NumberOfSections; i++) {
-        relocation = reinterpret_cast<PIMAGE_RELOCATION>(ctx->base + ctx->sections[i].PointerToRelocations);
+    if (watch == nullptr) {
+        std::cerr << "[!] ERROR, Failed to watch: " << object_path << std::endl;
+        return EXIT_FAILURE;
+    }
 
-        //
-        // iterate over each relocation entry for the section.
-        //
-        for (size_t j = 0; j < ctx->sections[i].NumberOfRelocations; j++) {
-            symbol = &ctx->sym_table[relocation->SymbolTableIndex];
+    auto _ = defer([&]() { platform_watch_close(watch); });
 
-            if (symbol->N.Name.Short) {
-                symbol_name = reinterpret_cast<char*>(symbol->N.ShortName);
-            } else {
-                symbol_name = reinterpret_cast<char*>(PTR_TO_U64(ctx->sym_table + ctx->header->NumberOfSymbols) + (symbol->N.Name.Long));
-            }
+    perf_set_enabled(true); // every run reports its phase times
+    std::cout << "[*] Watching " << object_path << " for changes, Ctrl+C to stop." << std::endl;
 
-            //
-            // RVA for the relocation needs to be applied to the base of the section.
-            //
-            needs_resolving = reinterpret_cast<void*>(PTR_TO_U64(ctx->sec_map[i].base) + relocation->VirtualAddress);
-            resolved_addr = nullptr;
+    auto changed = std::chrono::steady_clock::now();
+    for (uint32_t run = 1;; run++) {
+        const job_result result = run_job(object_path, arguments, nullptr, &image);
+        metrics_record_status(result.status);
+        const double latency_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - changed).count();
 
-            if (strncmp("__imp_", symbol_name, 6) == 0) {
-                resolved_addr = resolve_object_symbol(symbol_name);
-                if (resolved_addr == nullptr) {
-                    return false;
-                }
-            }
+        std::cout << "[*] Run " << run << ": " << job_status_name(result.status) << " ("
+                  << (image.reused ? "layout reused" : "laid out") << "), result " << latency_ms << " ms after "
+                  << (run == 1 ? "start" : "the change") << std::endl;
+        print_perf_stats(result.perf);
+        if (footprint_enabled()) {
+            print_footprint_stats(result.footprint, result.arena);
+        }
+        if (!result.output.empty()) {
+            std::cout << result.output << std::endl;
+        }
 
-            if (relocation->Type == IMAGE_REL_AMD64_REL32 && resolved_addr) { // Relative 32-bit relocation for jumps/calls
-                ctx->sym_map[func_index] = resolved_addr;
-                *((uint32_t*)needs_resolving) = static_cast<uint32_t>((PTR_TO_U64(ctx->sym_map) + func_index * sizeof(void*)) - PTR_TO_U64(needs_resolving) - sizeof(uint32_t));
-                func_index++;
-            } else {
-                section_base = ctx->sec_map[symbol->SectionNumber - 1].base;
-                object_relocation(relocation->Type, needs_resolving, section_base);
-            }
+        if (!platform_watch_wait(watch, PLATFORM_WAIT_FOREVER)) {
+            std::cerr << "[!] ERROR, Lost the watch on: " << object_path << std::endl;
+            return EXIT_FAILURE;
+        }
 
-            relocation = reinterpret_cast<PIMAGE_RELOCATION>(PTR_TO_U64(relocation) + sizeof(IMAGE_RELOCATION));
+        //
+        // Let the writer finish, compilers and linkers may touch the file more than once
+        //
+        changed = std::chrono::steady_clock::now();
+        while (platform_watch_wait(watch, 20)) {
         }
-    }
 
-    return true;
+        std::cout << "[*] " << object_path << " changed, reloading..." << std::endl;
+    }
 }
 
-bool load_object(
-    void* pobject,
-    const std::string& func_name,
-    char* arguments,
-    const uint32_t argc)
+void print_banner()
 {
+    std::cout <<
+        R"(
+ _            __
+| |__   ___  / _|       _____  _____  ___
+| '_ \ / _ \| |_ _____ / _ \ \/ / _ \/ __|
+| |_) | (_) |  _|_____|  __/>  <  __/ (__
+|_.__/ \___/|_|        \___/_/\_\___|\___|
+)" << "\n";
+}
 
-    object_context ctx = { 0 };
-    uint32_t virtual_size = 0;
-    uint32_t section_size = 0;
-    void* virtual_addr = nullptr;
-    void* section_base = nullptr;
+int main(int argc, char** argv)
+{
+    std::signal(SIGINT, sig_handle_ctrlc);
 
-    //------------------------------------//
+    if (argc > 1 && strcmp(argv[1], "--pack") == 0) {
+        std::vector<char> packed;
 
-    auto _ = defer([&]() {
-        if (virtual_addr != nullptr) {
-            VirtualFree(virtual_addr, 0, MEM_RELEASE);
-        }
-        if (ctx.sec_map != nullptr) {
-            HeapFree(GetProcessHeap(), 0, ctx.sec_map);
-            ctx.sec_map = nullptr;
+        print_banner();
+        if (argc < 4 || !pack_arguments(argv[2], packed)) {
+            std::cerr << "[!] ERROR, invalid BOF arguments passed." << std::endl;
+            return EXIT_FAILURE;
         }
-    });
 
-    if (!pobject || func_name.empty()) {
-        return false;
-    }
-
-    ctx.header = static_cast<PIMAGE_FILE_HEADER>(pobject);
-    ctx.sym_table = reinterpret_cast<PIMAGE_SYMBOL>(PTR_TO_U64(pobject) + ctx.header->PointerToSymbolTable);
-    ctx.sections = reinterpret_cast<PIMAGE_SECTION_HEADER>(PTR_TO_U64(pobject) + sizeof(IMAGE_FILE_HEADER));
+        if (!save_packed_arguments(argv[3], packed.data(), packed.size())) {
+            std::cerr << "[!] ERROR, failed to write packed arguments to: " << argv[3] << std::endl;
+            return EXIT_FAILURE;
+        }
 
-    if (ctx.header->Machine != IMAGE_FILE_MACHINE_AMD64) { // do not support 32 bit
-        return false;
+        std::cout << "[+] Packed " << packed.size() << " bytes of arguments into: " << argv[3] << std::endl;
+        return EXIT_SUCCESS;
     }
 
     //
-    // allocate memory
+    // Options come before the input file.
     //
-    virtual_size = object_virtual_size(&ctx);
-    virtual_addr = VirtualAlloc(
-        nullptr,
-        virtual_size,
-        MEM_COMMIT | MEM_RESERVE,
-        PAGE_READWRITE);
-
-    if (virtual_addr == nullptr) {
-        return false;
-    }
+    std::string batch_file;
+    std::string inspect_dir;
+    std::string catalog_dir;
+    std::string replay_path;
+    std::string metrics_file;
+    std::string metrics_json;
+    uint32_t metrics_interval_ms = 5000;
+    std::vector<std::string> catalog_adds;
+    std::vector<std::string> library_paths;
+    bool catalog_listing = false;
+    bool watching = false;
+    uint32_t timeout_ms = 0;
+    uint32_t workers = 0; // one per core, looked up only if --batch or --inspect need it
+    scheduler_limits limits;
+    uint32_t load_threads = 0;
+    bool parallel_load = false;
+    int first = 1;
+
+    for (; first < argc && strncmp(argv[first], "--", 2) == 0; first++) {
+        const char* option = argv[first];
+        const char* value  = first + 1 < argc ? argv[first + 1] : "";
+
+        if (strcmp(option, "--arena") == 0) {
+            arena_set_enabled(true);
+            continue;
+        }
+        if (strcmp(option, "--perf") == 0) {
+            perf_set_enabled(true);
+            continue;
+        }
+        if (strcmp(option, "--quiet") == 0) {
+            log_set_quiet(true);
+            continue;
+        }
+        if (strcmp(option, "--memory") == 0) {
+            footprint_set_enabled(true);
+            continue;
+        }
+        if (strcmp(option, "--catalog-list") == 0) {
+            catalog_listing = true;
+            continue;
+        }
+        if (strcmp(option, "--watch") == 0) {
+            watching = true;
+            continue;
+        }
+        if (strcmp(option, "--fork") == 0) {
+            if (!platform_fork_supported()) {
+                std::cerr << "[!] ERROR, --fork is only available on POSIX systems." << std::endl;
+                return EXIT_FAILURE;
+            }
+            fork_set_enabled(true);
+            continue;
+        }
 
-    ctx.sec_map = static_cast<section_map*>(HeapAlloc(
-        GetProcessHeap(),
-        HEAP_ZERO_MEMORY,
-        ctx.header->NumberOfSections * sizeof(section_map)));
+        first++;
+        if (strcmp(option, "--batch") == 0 && *value != '\0') {
+            batch_file = value;
+        } else if (strcmp(option, "--inspect") == 0 && *value != '\0') {
+            inspect_dir = value;
+        } else if (strcmp(option, "--catalog") == 0 && *value != '\0') {
+            catalog_dir = value;
+        } else if (strcmp(option, "--catalog-add") == 0 && *value != '\0') {
+            catalog_adds.emplace_back(value);
+        } else if (strcmp(option, "--record") == 0 && *value != '\0') {
+            trace_set_record(value);
+        } else if (strcmp(option, "--replay") == 0 && *value != '\0') {
+            replay_path = value;
+        } else if (strcmp(option, "--metrics") == 0 && *value != '\0') {
+            metrics_file = value;
+        } else if (strcmp(option, "--metrics-json") == 0 && *value != '\0') {
+            metrics_json = value;
+        } else if (strcmp(option, "--metrics-interval") == 0 && parse_option_u32(value, metrics_interval_ms) && metrics_interval_ms != 0) {
+            continue;
+        } else if (strcmp(option, "--library") == 0 && *value != '\0') {
+            library_paths.emplace_back(value);
+        } else if (strcmp(option, "--timeout") == 0 && parse_option_u32(value, timeout_ms)) {
+            continue;
+        } else if (strcmp(option, "--workers") == 0 && parse_option_u32(value, workers) && workers != 0) {
+            continue;
+        } else if (strcmp(option, "--class-limit") == 0 && parse_class_limit(value, limits)) {
+            continue;
+        } else if (strcmp(option, "--reserve-interactive") == 0 && parse_option_u32(value, limits.interactive_reserved)) {
+            continue;
+        } else if (strcmp(option, "--parallel-load") == 0 && parse_option_u32(value, load_threads)) {
+            parallel_load = true;
+        } else {
+            std::cerr << "[!] ERROR, invalid option: " << option << " " << value << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
-    if (ctx.sec_map == nullptr) {
-        return false;
+    if (workers == 0 && (!inspect_dir.empty() || !batch_file.empty())) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (fork_enabled() && trace_recording()) {
+        std::cerr << "[!] ERROR, --record cannot trace a BOF that runs in a forked child." << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (fork_enabled() && perf_enabled()) {
+        std::cerr << "[!] ERROR, --perf cannot count a BOF that runs in a forked child." << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (parallel_load) {
+        parallel_load_set_threads(load_threads != 0 ? load_threads : std::max(1u, std::thread::hardware_concurrency()));
     }
 
     //
-    // copy over sections from the object file
+    // Inspection output is meant for other tools, so it comes without the banner.
     //
-    section_base = virtual_addr;
-    for (size_t i = 0; i < ctx.header->NumberOfSections; i++) {
-
-        section_size = ctx.sections[i].SizeOfRawData;
-        ctx.sec_map[i].size = section_size;
-        ctx.sec_map[i].base = section_base;
-
-        memcpy( // copy over the section
-            section_base,
-            reinterpret_cast<void*>(ctx.base + ctx.sections[i].PointerToRawData),
-            section_size);
+    if (!inspect_dir.empty()) {
+        return inspect_directory(inspect_dir, workers, std::cout) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-        section_base = reinterpret_cast<void*>(PAGE_ALIGN(PTR_TO_U64(section_base) + section_size));
+    if (!log_quiet()) {
+        print_banner();
     }
 
     //
-    // Process COFF sections
+    // Phase times for the histograms come from perf, without counters unless --perf asks for them
     //
-    ctx.sym_map = static_cast<PVOID*>(section_base);
-    if (!process_object_sections(&ctx)) {
-        return false;
+    if (!metrics_file.empty() || !metrics_json.empty()) {
+        perf_set_timing(true);
+        metrics_start_export(metrics_file, metrics_json, metrics_interval_ms);
+    }
+    auto exported = defer([]() { metrics_stop_export(); });
+
+    std::optional<catalog> cat;
+    if (!catalog_dir.empty()) {
+        if (!catalog_adds.empty() && !catalog_add(catalog_dir, catalog_adds)) {
+            return EXIT_FAILURE;
+        }
+        if (!(cat = catalog::open(catalog_dir))) {
+            return EXIT_FAILURE;
+        }
+        if (catalog_listing) {
+            catalog_list(*cat, std::cout);
+            return EXIT_SUCCESS;
+        }
+        if (!catalog_adds.empty() && batch_file.empty() && argc <= first) {
+            return EXIT_SUCCESS;
+        }
+    } else if (!catalog_adds.empty() || catalog_listing) {
+        std::cerr << "[!] ERROR, --catalog-add and --catalog-list need --catalog <dir>." << std::endl;
+        return EXIT_FAILURE;
     }
 
     //
-    // Execute "go"
+    // Libraries are loaded once, before anything runs, and shared by every BOF.
     //
-    if (!object_execute(&ctx, func_name.c_str(), arguments, argc)) {
-        return false;
+    if (!library_paths.empty()) {
+        for (std::string& path : library_paths) {
+            resolve_catalog_name(cat ? &*cat : nullptr, path);
+        }
+        if (!link_load_libraries(library_paths)) {
+            return EXIT_FAILURE;
+        }
     }
 
-    return true;
-}
-
-void sig_handle_ctrlc(int signal)
-{
-    std::cout << std::endl;
-    std::cout << "[*] Keyboard interrupt received. Exiting..." << std::endl;
-    std::exit(signal);
-}
+    if (!replay_path.empty()) {
+        return trace_replay(replay_path, std::cout) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-int main(int argc, char** argv)
-{
-    std::signal(SIGINT, sig_handle_ctrlc);
-    std::cout <<
-        R"(
- _            __
-| |__   ___  / _|       _____  _____  ___
-| '_ \ / _ \| |_ _____ / _ \ \/ / _ \/ __|
-| |_) | (_) |  _|_____|  __/>  <  __/ (__
-|_.__/ \___/|_|        \___/_/\_\___|\___|
-)" << std::endl;
+    if (!batch_file.empty()) {
+        if (watching) {
+            std::cerr << "[!] ERROR, --watch reruns a single BOF, not a --batch." << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (trace_recording()) {
+            std::cerr << "[!] ERROR, --record traces a single BOF, not a --batch." << std::endl;
+            return EXIT_FAILURE;
+        }
+        return run_batch(batch_file, timeout_ms, workers, limits, cat ? &*cat : nullptr);
+    }
 
-    if (argc < 2) {
-        std::cout << R"(  Useage: [INPUT FILE] [ARGUMENTS (optional)])" << std::endl;
+    if (argc <= first) {
+        std::cout << R"(  Useage: [OPTIONS] [INPUT FILE] [ARGUMENTS (optional)])" << std::endl;
         std::cout << R"(  Examples: BOF-exec bof.o "string argument, i32, i200")" << std::endl;
         std::cout << R"(            BOF-exec bof.obj "i16, s-50, s121")" << std::endl;
-        std::cout << R"(            BOF-exec bof.o)" << std::endl
+        std::cout << R"(            BOF-exec bof.o)" << std::endl;
+        std::cout << R"(            BOF-exec bof.o @args.bin)" << std::endl;
+        std::cout << R"(            cat bof.o | BOF-exec - "i5")" << std::endl;
+        std::cout << R"(            BOF-exec --pack "file:C:\input.bin, wstr:text" args.bin)" << std::endl
                   << std::endl;
 
         std::cout << R"(  Note: passing arguments to the "go" function is optional.)" << std::endl;
         std::cout << R"(   - arguments can be passed as integers by prefixing the argument with "i" or "s".)" << std::endl;
         std::cout << R"(   - "i" passes the argument as a 32 bit integer, and "s" passes a 16 bit one.)" << std::endl;
         std::cout << R"(   - integer arguments can be negative numbers, such as: "i-32" or "s-2")" << std::endl;
+        std::cout << R"(   - "wstr:" passes the rest of the argument as a UTF-16 string.)" << std::endl;
+        std::cout << R"(   - "file:" passes the contents of the file at the given path as binary data.)" << std::endl;
+        std::cout << R"(   - "--pack" saves packed arguments to a file, "@file" passes them without re-packing.)" << std::endl;
+        std::cout << R"(   - an input file of "-" reads the object from stdin, "fd:<n>" from an inherited descriptor.)" << std::endl
+                  << std::endl;
+
+        std::cout << R"(  Options:)" << std::endl;
+        std::cout << R"(   --timeout <ms>   time budget per BOF, BeaconIsCancelled() turns TRUE once it is used up)" << std::endl;
+        std::cout << R"(   --batch <file>   run the jobs listed in a file, one "[class] <object> [arguments]" per line)" << std::endl;
+        std::cout << R"(   --workers <n>    worker threads for --batch and --inspect (default: one per core))" << std::endl;
+        std::cout << R"(   --class-limit <class>=<n>  run at most n jobs of a class (interactive, normal, bulk) at once)" << std::endl;
+        std::cout << R"(   --reserve-interactive <n>  keep n --batch workers free for [interactive] jobs)" << std::endl;
+        std::cout << R"(   --parallel-load <n>  copy and relocate objects over 4 MB or 32768 relocations on n threads (0: one per core))" << std::endl;
+        std::cout << R"(   --inspect <dir>  preflight every object below dir without running it, JSON lines on stdout)" << std::endl;
+        std::cout << R"(   --catalog <dir>  content-addressed BOF store, the input file can then be a catalog name)" << std::endl;
+        std::cout << R"(   --catalog-add <path>  add an object file, or every object below a directory, to the catalog)" << std::endl;
+        std::cout << R"(   --catalog-list   list the cataloged objects)" << std::endl;
+        std::cout << R"(   --library <obj>  load a shared helper object once, BOFs resolve their undefined symbols against it)" << std::endl;
+        std::cout << R"(   --watch          rerun the BOF with the same arguments whenever the object file changes)" << std::endl;
+        std::cout << R"(   --record <file>  log every Beacon API and import call of the BOF, with its output, to a trace file)" << std::endl;
+        std::cout << R"(   --replay <path>  rerun a trace, or every *.trace below a directory, feeding back the recorded results)" << std::endl;
+        std::cout << R"(   --metrics <file> Prometheus text file of job, phase, output, cache and arena metrics, rewritten periodically)" << std::endl;
+        std::cout << R"(   --metrics-json <file>  JSON snapshot of the same, written at exit and on SIGUSR1)" << std::endl;
+        std::cout << R"(   --metrics-interval <ms>  how often --metrics is rewritten (default: 5000))" << std::endl;
+        std::cout << R"(   --perf           per phase CPU counters (cycles, instructions, misses, faults, switches) for every BOF)" << std::endl;
+        std::cout << R"(   --quiet          no banner or progress messages, only the BOF output (and errors on stderr))" << std::endl;
+        std::cout << R"(   --fork           run every BOF in a child forked from the ready image, for process isolation (POSIX))" << std::endl;
+        std::cout << R"(   --memory         image bytes per protection, padding, import slot use, buffer high-water marks and peak working set per BOF)" << std::endl;
+        std::cout << R"(   --arena          serve the BOF's heap allocations from a per-job arena, reclaimed when it ends)" << std::endl;
         return EXIT_FAILURE;
     }
 
-    if (!std::filesystem::exists(argv[1]) || (std::filesystem::path(argv[1]).extension().string() != ".o" && // only permit .o or .obj
-            std::filesystem::path(argv[1]).extension().string() != ".obj")
+    job single;
+    single.object_path = argv[first];
+
+    //
+    // A stream can only be read once, and leaves no file behind to trace against
+    //
+    const bool streamed = input_stream::is_stream_name(single.object_path);
+
+    if (streamed && (watching || trace_recording())) {
+        std::cerr << "[!] ERROR, --watch and --record need an object file, not a stream." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!streamed && !resolve_catalog_name(cat ? &*cat : nullptr, single.object_path) && (
+            !std::filesystem::exists(argv[first]) || (std::filesystem::path(argv[first]).extension().string() != ".o" && // only permit .o or .obj
+            std::filesystem::path(argv[first]).extension().string() != ".obj"))
     ) {
         std::cerr << "[!] ERROR, Input file does not exist, or is not an object file." << std::endl;
         return EXIT_FAILURE;
     }
 
-    auto input_file = read_from_disk(argv[1]);
-    if (!input_file) {
-        return EXIT_FAILURE;
+    single.arguments   = argc > first + 1 ? argv[first + 1] : "";
+    single.timeout_ms  = timeout_ms;
+
+    if (!log_quiet()) {
+        std::cout << "[*] Executing object file: " << single.object_path << "...\n";
+        std::cout << "[*] Arguments provided: " << (single.arguments.empty() ? "None" : single.arguments) << "\n";
     }
 
-    std::vector<char> packed;
-    if (argc > 2) {
-        if (!pack_arguments(argv[2], packed)) {
-            std::cerr << "[!] ERROR, invalid BOF arguments passed." << std::endl;
-            return EXIT_FAILURE;
-        }
+    if (watching) {
+        return run_watch(single.object_path, single.arguments);
+    }
+
+    //
+    // Without a time budget the BOF simply runs on this thread.
+    //
+    if (timeout_ms != 0) {
+        worker_pool pool(1);
+        pool.submit(&single);
+        pool.wait();
+    } else {
+        job_result result = run_job(single.object_path, single.arguments);
+        metrics_record_status(result.status);
+        single.status = result.status;
+        single.output = std::move(result.output);
+        single.arena  = result.arena;
+        single.perf   = result.perf;
+        single.footprint = result.footprint;
+    }
+
+    if (arena_enabled()) {
+        print_arena_stats(single.arena);
+    }
+    if (perf_enabled()) {
+        print_perf_stats(single.perf);
+    }
+    if (footprint_enabled()) {
+        print_footprint_stats(single.footprint, single.arena);
     }
 
-    std::cout << "[*] Executing object file: " << argv[1] << "..." << std::endl;
-    std::cout << "[*] Arguments provided: " << (argc > 2 ? argv[2] : "None") << std::endl;
-    std::cout << "[*] Argument size (packed): " << packed.size() << std::endl;
+    if (single.status != JOB_SUCCEEDED) {
+        if (single.status == JOB_TIMED_OUT) {
+            std::cerr << "[!] ERROR, BOF timed out after " << timeout_ms << " ms." << std::endl;
+        } else {
+            std::cerr << "[!] ERROR, failed to execute BOF." << std::endl;
+        }
 
-    if (!load_object(
-         input_file->data(),
-         "go",
-         packed.empty() ? nullptr : packed.data(),
-         packed.size())
-    ){
-        std::cerr << "[!] ERROR, failed to execute BOF." << std::endl;
+        if (!single.output.empty()) {
+            write_results(log_quiet() ? single.output : "[*] Partial BOF output:\n\n" + single.output + "\n\n");
+        }
         return EXIT_FAILURE;
     }
 
-    const std::string output = get_beacon_output();
-    std::cout << "[*] BOF output:"
-              << "\n\n";
-    std::cout << output << "\n\n";
-    std::cout << "[+] Finished executing BOF." << std::endl;
+    //
+    // Quiet runs print the BOF output as is, for whatever reads it
+    //
+    if (log_quiet()) {
+        write_results(single.output);
+    } else {
+        write_results("[*] BOF output:\n\n" + single.output + "\n\n[+] Finished executing BOF.\n");
+    }
 
     return EXIT_SUCCESS;
 }
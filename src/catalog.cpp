@@ -0,0 +1,541 @@
+#include <catalog.hpp>
+#include <inspect.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <unordered_map>
+
+namespace {
+
+//
+// SHA-256 (FIPS 180-4), only used to name the stored objects.
+//
+class sha256 {
+    static constexpr uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+
+    uint32_t state_[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    static uint32_t rotr(const uint32_t x, const int n) { return (x >> n) | (x << (32 - n)); }
+
+    void block(const uint8_t* p) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = uint32_t(p[i * 4]) << 24 | uint32_t(p[i * 4 + 1]) << 16 | uint32_t(p[i * 4 + 2]) << 8 | p[i * 4 + 3];
+        }
+        for (int i = 16; i < 64; i++) {
+            const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+        uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+        for (int i = 0; i < 64; i++) {
+            const uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        state_[0] += a; state_[1] += b; state_[2] += c; state_[3] += d;
+        state_[4] += e; state_[5] += f; state_[6] += g; state_[7] += h;
+    }
+
+public:
+    void digest(const uint8_t* data, const size_t size, uint8_t out[32]) {
+        uint8_t tail[128] = { 0 };
+        const size_t full = size / 64 * 64;
+        const size_t rest = size - full;
+        const uint64_t bits = static_cast<uint64_t>(size) * 8;
+
+        for (size_t i = 0; i < full; i += 64) {
+            block(data + i);
+        }
+
+        //
+        // the remaining bytes, a single 1 bit, zeros and the big endian bit length
+        //
+        memcpy(tail, data + full, rest);
+        tail[rest] = 0x80;
+        const size_t tail_size = rest < 56 ? 64 : 128;
+        for (int i = 0; i < 8; i++) {
+            tail[tail_size - 1 - i] = static_cast<uint8_t>(bits >> (i * 8));
+        }
+        for (size_t i = 0; i < tail_size; i += 64) {
+            block(tail + i);
+        }
+
+        for (int i = 0; i < 8; i++) {
+            out[i * 4]     = static_cast<uint8_t>(state_[i] >> 24);
+            out[i * 4 + 1] = static_cast<uint8_t>(state_[i] >> 16);
+            out[i * 4 + 2] = static_cast<uint8_t>(state_[i] >> 8);
+            out[i * 4 + 3] = static_cast<uint8_t>(state_[i]);
+        }
+    }
+};
+
+uint64_t name_hash(const std::string_view name)
+{
+    uint64_t hash = 0xcbf29ce484222325; // FNV-1a
+    for (const char c : name) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3;
+    }
+    return hash;
+}
+
+uint64_t align_8(const uint64_t value)
+{
+    return (value + 7) & ~uint64_t(7);
+}
+
+//
+// Catalog entry while the index is being rebuilt.
+//
+struct pending_section {
+    std::string name;
+    uint32_t    relocations;
+    uint64_t    offset;
+    uint64_t    size;
+    uint64_t    flags;
+};
+
+struct pending_record {
+    uint8_t                         hash[32];
+    uint32_t                        format;
+    uint32_t                        flags;
+    uint64_t                        file_size;
+    uint64_t                        virtual_size;
+    uint64_t                        import_offset;
+    std::vector<pending_section>    sections;
+    std::vector<std::string>        imports;
+    std::vector<std::string>        entry_points;
+};
+
+void load_records(const catalog& cat, std::map<std::string, pending_record>& records)
+{
+    for (uint32_t i = 0; i < cat.size(); i++) {
+        const catalog_record* found = cat.at(i);
+        if (found == nullptr) {
+            continue;
+        }
+
+        const catalog_record& record = *found;
+        pending_record& pending = records[cat.string(record.name)];
+
+        memcpy(pending.hash, record.hash, sizeof(pending.hash));
+        pending.format        = record.format;
+        pending.flags         = record.flags;
+        pending.file_size     = record.file_size;
+        pending.virtual_size  = record.virtual_size;
+        pending.import_offset = record.import_offset;
+
+        for (uint32_t j = 0; j < record.section_count; j++) {
+            const catalog_section& section = cat.section(record, j);
+            pending.sections.push_back({ cat.string(section.name), section.relocations, section.offset, section.size, section.flags });
+        }
+        for (uint32_t j = 0; j < record.import_count; j++) {
+            pending.imports.emplace_back(cat.import(record, j));
+        }
+        for (uint32_t j = 0; j < record.entry_point_count; j++) {
+            pending.entry_points.emplace_back(cat.entry_point(record, j));
+        }
+    }
+}
+
+bool write_index(const std::string& file_name, const std::map<std::string, pending_record>& records)
+{
+    std::vector<uint32_t> buckets(8);
+    std::vector<catalog_record> out_records;
+    std::vector<catalog_section> out_sections;
+    std::vector<uint32_t> references;
+    std::string strings(1, '\0');
+    std::unordered_map<std::string, uint32_t> interned;
+
+    const auto intern = [&](const std::string& str) {
+        auto [entry, inserted] = interned.try_emplace(str, static_cast<uint32_t>(strings.size()));
+        if (inserted) {
+            strings.append(str.c_str(), str.size() + 1);
+        }
+        return entry->second;
+    };
+
+    while (buckets.size() < records.size() * 2) {
+        buckets.resize(buckets.size() * 2);
+    }
+
+    for (const auto& [name, pending] : records) {
+        catalog_record record = {};
+
+        record.name_hash     = name_hash(name);
+        record.name          = intern(name);
+        record.format        = pending.format;
+        record.flags         = pending.flags;
+        record.file_size     = pending.file_size;
+        record.virtual_size  = pending.virtual_size;
+        record.import_offset = pending.import_offset;
+        memcpy(record.hash, pending.hash, sizeof(record.hash));
+
+        record.first_section = static_cast<uint32_t>(out_sections.size());
+        record.section_count = static_cast<uint32_t>(pending.sections.size());
+        for (const pending_section& section : pending.sections) {
+            out_sections.push_back({ intern(section.name), section.relocations, section.offset, section.size, section.flags });
+        }
+
+        record.first_import = static_cast<uint32_t>(references.size());
+        record.import_count = static_cast<uint32_t>(pending.imports.size());
+        for (const std::string& imported : pending.imports) {
+            references.push_back(intern(imported));
+        }
+
+        record.first_entry_point = static_cast<uint32_t>(references.size());
+        record.entry_point_count = static_cast<uint32_t>(pending.entry_points.size());
+        for (const std::string& entry_point : pending.entry_points) {
+            references.push_back(intern(entry_point));
+        }
+
+        size_t bucket = record.name_hash & (buckets.size() - 1);
+        while (buckets[bucket] != 0) {
+            bucket = (bucket + 1) & (buckets.size() - 1);
+        }
+        buckets[bucket] = static_cast<uint32_t>(out_records.size() + 1);
+        out_records.push_back(record);
+    }
+
+    catalog_header header = {};
+    header.magic             = catalog_magic;
+    header.version           = catalog_version;
+    header.record_count      = static_cast<uint32_t>(out_records.size());
+    header.bucket_count      = static_cast<uint32_t>(buckets.size());
+    header.section_count     = static_cast<uint32_t>(out_sections.size());
+    header.reference_count   = static_cast<uint32_t>(references.size());
+    header.buckets_offset    = align_8(sizeof(header));
+    header.records_offset    = align_8(header.buckets_offset + buckets.size() * sizeof(uint32_t));
+    header.sections_offset   = align_8(header.records_offset + out_records.size() * sizeof(catalog_record));
+    header.references_offset = align_8(header.sections_offset + out_sections.size() * sizeof(catalog_section));
+    header.strings_offset    = align_8(header.references_offset + references.size() * sizeof(uint32_t));
+    header.strings_size      = strings.size();
+
+    std::vector<char> image(header.strings_offset + header.strings_size);
+    const auto place = [&](const uint64_t offset, const void* data, const size_t size) {
+        if (size != 0) {
+            memcpy(image.data() + offset, data, size);
+        }
+    };
+
+    place(0, &header, sizeof(header));
+    place(header.buckets_offset, buckets.data(), buckets.size() * sizeof(uint32_t));
+    place(header.records_offset, out_records.data(), out_records.size() * sizeof(catalog_record));
+    place(header.sections_offset, out_sections.data(), out_sections.size() * sizeof(catalog_section));
+    place(header.references_offset, references.data(), references.size() * sizeof(uint32_t));
+    place(header.strings_offset, strings.data(), strings.size());
+
+    //
+    // Readers either see the old index or the new one, never half of it.
+    //
+    const std::string temporary = file_name + ".tmp";
+    {
+        std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+        if (!output.write(image.data(), static_cast<std::streamsize>(image.size()))) {
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temporary, file_name, ec);
+    return !ec;
+}
+
+bool store_object(const std::string& root, const std::string& path, pending_record& pending)
+{
+    auto file = mapped_file::open(path);
+    if (!file) {
+        std::cerr << "[!] ERROR, failed to open object file: " << path << std::endl;
+        return false;
+    }
+
+    sha256().digest(reinterpret_cast<const uint8_t*>(file->data()), file->size(), pending.hash);
+
+    const std::filesystem::path stored = std::filesystem::path(root) / "objects" / (catalog_hash_string(pending.hash) + ".o");
+    std::error_code ec;
+    bool created = false;
+
+    if (!std::filesystem::exists(stored, ec)) {
+        const std::string temporary = stored.string() + ".tmp";
+        {
+            std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+            if (!output.write(file->data(), static_cast<std::streamsize>(file->size()))) {
+                std::cerr << "[!] ERROR, failed to write: " << temporary << std::endl;
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporary, stored, ec);
+        if (ec) {
+            std::cerr << "[!] ERROR, failed to store object: " << stored.string() << " (" << ec.message() << ")" << std::endl;
+            return false;
+        }
+        created = true;
+    }
+
+    //
+    // Metadata comes from the stored copy, so it always matches the hash.
+    //
+    const inspect_report report = inspect_object(stored.string());
+    if (!report.error.empty()) {
+        std::cerr << "[!] ERROR, " << path << ": " << report.error << std::endl;
+        if (created) {
+            std::filesystem::remove(stored, ec);
+        }
+        return false;
+    }
+
+    pending.format        = report.format == "elf" ? CATALOG_ELF : CATALOG_COFF;
+    pending.flags         = report.ok() ? CATALOG_LOADABLE : 0;
+    pending.file_size     = report.file_size;
+    pending.virtual_size  = report.virtual_size;
+    pending.import_offset = report.import_offset;
+    pending.imports       = report.imports;
+    pending.entry_points  = report.entry_points;
+    pending.sections.clear();
+    for (const inspect_section& section : report.sections) {
+        pending.sections.push_back({ section.name, section.relocations, section.offset, section.size, section.flags });
+    }
+
+    return true;
+}
+
+} // namespace
+
+std::string catalog_hash_string(const uint8_t hash[32])
+{
+    static const char hex[] = "0123456789abcdef";
+    std::string out;
+
+    for (size_t i = 0; i < 32; i++) {
+        out += hex[hash[i] >> 4];
+        out += hex[hash[i] & 0xF];
+    }
+    return out;
+}
+
+std::optional<catalog> catalog::open(const std::string& root)
+{
+    catalog cat;
+    std::error_code ec;
+    const std::string index_path = (std::filesystem::path(root) / "index.bin").string();
+
+    cat.root_ = root;
+    if (!std::filesystem::exists(index_path, ec)) {
+        return cat;
+    }
+
+    auto index = mapped_file::open(index_path);
+    if (!index) {
+        std::cerr << "[!] ERROR, failed to map catalog index: " << index_path << std::endl;
+        return std::nullopt;
+    }
+
+    //
+    // Check that every table lies inside of the file; records are checked
+    // when they are looked up.
+    //
+    const uint64_t size = index->size();
+    const auto* header = reinterpret_cast<const catalog_header*>(index->data());
+    const auto fits = [&](const uint64_t offset, const uint64_t count, const uint64_t element) {
+        return offset <= size && count <= (size - offset) / element;
+    };
+
+    if (size < sizeof(catalog_header) || header->magic != catalog_magic || header->version != catalog_version
+        || header->bucket_count == 0 || (header->bucket_count & (header->bucket_count - 1)) != 0
+        || header->record_count >= header->bucket_count
+        || !fits(header->buckets_offset, header->bucket_count, sizeof(uint32_t))
+        || !fits(header->records_offset, header->record_count, sizeof(catalog_record))
+        || !fits(header->sections_offset, header->section_count, sizeof(catalog_section))
+        || !fits(header->references_offset, header->reference_count, sizeof(uint32_t))
+        || !fits(header->strings_offset, header->strings_size, 1)
+        || header->strings_size == 0 || index->data()[header->strings_offset + header->strings_size - 1] != '\0') {
+        std::cerr << "[!] ERROR, malformed catalog index: " << index_path << std::endl;
+        return std::nullopt;
+    }
+
+    cat.index_      = std::move(*index);
+    cat.header_     = reinterpret_cast<const catalog_header*>(cat.index_.data());
+    cat.buckets_    = reinterpret_cast<const uint32_t*>(cat.index_.data() + header->buckets_offset);
+    cat.records_    = reinterpret_cast<const catalog_record*>(cat.index_.data() + header->records_offset);
+    cat.sections_   = reinterpret_cast<const catalog_section*>(cat.index_.data() + header->sections_offset);
+    cat.references_ = reinterpret_cast<const uint32_t*>(cat.index_.data() + header->references_offset);
+    cat.strings_    = cat.index_.data() + header->strings_offset;
+
+    return cat;
+}
+
+const catalog_record* catalog::find(const std::string_view name) const
+{
+    if (header_ == nullptr) {
+        return nullptr;
+    }
+
+    const uint64_t hash = name_hash(name);
+    const uint32_t mask = header_->bucket_count - 1;
+    uint32_t bucket = hash & mask;
+
+    //
+    // A written index always has empty buckets, a corrupted one may not: visit each bucket once at most
+    //
+    for (uint32_t probe = 0; probe < header_->bucket_count && buckets_[bucket] != 0; probe++, bucket = (bucket + 1) & mask) {
+        const uint32_t index = buckets_[bucket] - 1;
+        if (index >= header_->record_count) {
+            return nullptr;
+        }
+
+        const catalog_record& candidate = records_[index];
+        if (candidate.name_hash != hash || candidate.name >= header_->strings_size || name != string(candidate.name)) {
+            continue;
+        }
+
+        return valid(candidate) ? &candidate : nullptr;
+    }
+
+    return nullptr;
+}
+
+const catalog_record* catalog::at(const uint32_t index) const
+{
+    return index < size() && valid(records_[index]) ? &records_[index] : nullptr;
+}
+
+bool catalog::valid(const catalog_record& record) const
+{
+    const auto in_range = [](const uint32_t first, const uint32_t count, const uint32_t total) {
+        return first <= total && count <= total - first;
+    };
+
+    if (record.name >= header_->strings_size
+        || !in_range(record.first_section, record.section_count, header_->section_count)
+        || !in_range(record.first_import, record.import_count, header_->reference_count)
+        || !in_range(record.first_entry_point, record.entry_point_count, header_->reference_count)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < record.section_count; i++) {
+        if (sections_[record.first_section + i].name >= header_->strings_size) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < record.import_count; i++) {
+        if (references_[record.first_import + i] >= header_->strings_size) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < record.entry_point_count; i++) {
+        if (references_[record.first_entry_point + i] >= header_->strings_size) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::string catalog::object_path(const catalog_record& record) const
+{
+    return (std::filesystem::path(root_) / "objects" / (catalog_hash_string(record.hash) + ".o")).string();
+}
+
+bool catalog_add(const std::string& root, const std::vector<std::string>& paths)
+{
+    std::map<std::string, pending_record> records;
+    std::vector<std::string> files;
+    std::error_code ec;
+    bool succeeded = true;
+
+    std::filesystem::create_directories(std::filesystem::path(root) / "objects", ec);
+    if (ec) {
+        std::cerr << "[!] ERROR, failed to create catalog: " << root << " (" << ec.message() << ")" << std::endl;
+        return false;
+    }
+
+    {
+        const auto existing = catalog::open(root);
+        if (!existing) {
+            return false;
+        }
+        load_records(*existing, records);
+    }
+
+    for (const std::string& path : paths) {
+        if (!std::filesystem::is_directory(path, ec)) {
+            files.push_back(path);
+            continue;
+        }
+
+        for (auto it = std::filesystem::recursive_directory_iterator(path, std::filesystem::directory_options::skip_permission_denied, ec);
+             !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            const std::string extension = it->path().extension().string();
+            if (it->is_regular_file(ec) && (extension == ".o" || extension == ".obj")) {
+                files.push_back(it->path().string());
+            }
+        }
+    }
+
+    std::sort(files.begin(), files.end());
+
+    for (const std::string& file : files) {
+        const std::string name = std::filesystem::path(file).stem().string();
+        pending_record pending = {};
+
+        if (!store_object(root, file, pending)) {
+            succeeded = false;
+            continue;
+        }
+
+        std::cout << "[+] Cataloged " << name << " -> " << catalog_hash_string(pending.hash)
+                  << ((pending.flags & CATALOG_LOADABLE) ? "" : " (has issues, see --inspect)") << std::endl;
+        records[name] = std::move(pending);
+    }
+
+    if (!write_index((std::filesystem::path(root) / "index.bin").string(), records)) {
+        std::cerr << "[!] ERROR, failed to write catalog index in: " << root << std::endl;
+        return false;
+    }
+
+    return succeeded;
+}
+
+void catalog_list(const catalog& cat, std::ostream& out)
+{
+    static const char* formats[] = { "coff", "elf" };
+
+    for (uint32_t i = 0; i < cat.size(); i++) {
+        const catalog_record* found = cat.at(i);
+        if (found == nullptr) {
+            continue;
+        }
+
+        const catalog_record& record = *found;
+        const char* name = cat.string(record.name);
+
+        out << "[*] " << name << "  " << catalog_hash_string(record.hash).substr(0, 16)
+            << "  " << (record.format <= CATALOG_ELF ? formats[record.format] : "unknown")
+            << "  " << record.file_size << " bytes, image " << record.virtual_size << " bytes, "
+            << record.section_count << " sections, " << record.import_count << " imports"
+            << ((record.flags & CATALOG_LOADABLE) ? "" : ", has issues") << std::endl;
+
+        for (uint32_t j = 0; j < record.entry_point_count; j++) {
+            out << (j == 0 ? "    entry points: " : ", ") << cat.entry_point(record, j);
+        }
+        if (record.entry_point_count != 0) {
+            out << std::endl;
+        }
+    }
+}
@@ -0,0 +1,443 @@
+#include <elf_loader.hpp>
+
+namespace {
+
+bool elf_section_allocated(const Elf64_Shdr& section)
+{
+    return (section.sh_flags & SHF_ALLOC) && section.sh_size != 0;
+}
+
+//
+// Whether the relocation needs an entry in the import area.
+//
+bool elf_needs_import_entry(const elf_context* ctx, const Elf64_Rela& relocation)
+{
+    const Elf64_Sym& symbol = ctx->sym_table[ELF64_R_SYM(relocation.r_info)];
+
+    switch (ELF64_R_TYPE(relocation.r_info)) {
+    case R_X86_64_GOTPCREL:
+    case R_X86_64_GOTPCRELX:
+    case R_X86_64_REX_GOTPCRELX:
+        return true;
+    case R_X86_64_NONE:
+        return false;
+    default:
+        return symbol.st_shndx == SHN_UNDEF && ELF64_R_SYM(relocation.r_info) != 0;
+    }
+}
+
+template<typename T>
+bool elf_write_checked(void* target, const int64_t value)
+{
+    if (static_cast<int64_t>(static_cast<T>(value)) != value) { // does not fit
+        return false;
+    }
+
+    const T narrowed = static_cast<T>(value);
+    memcpy(target, &narrowed, sizeof(T));
+    return true;
+}
+
+//
+// Bytes a relocation writes at r_offset
+//
+size_t elf_relocation_width(const uint32_t type)
+{
+    switch (type) {
+    case R_X86_64_64:
+    case R_X86_64_PC64:
+        return sizeof(uint64_t);
+    default:
+        return sizeof(uint32_t);
+    }
+}
+
+} // namespace
+
+bool elf_parse(elf_context* ctx, void* pobject, const size_t object_size)
+{
+    if (ctx == nullptr || pobject == nullptr || object_size < sizeof(Elf64_Ehdr)) {
+        return false;
+    }
+
+    ctx->header = static_cast<Elf64_Ehdr*>(pobject);
+    ctx->size   = object_size;
+
+    if (memcmp(ctx->header->e_ident, ELFMAG, SELFMAG) != 0
+        || ctx->header->e_ident[EI_CLASS] != ELFCLASS64
+        || ctx->header->e_ident[EI_DATA] != ELFDATA2LSB
+        || ctx->header->e_type != ET_REL
+        || ctx->header->e_machine != EM_X86_64
+        || ctx->header->e_shentsize != sizeof(Elf64_Shdr)) {
+        return false;
+    }
+
+    if (ctx->header->e_shoff + INT_TO_U64(ctx->header->e_shnum) * sizeof(Elf64_Shdr) > object_size) {
+        return false;
+    }
+
+    ctx->sections = reinterpret_cast<Elf64_Shdr*>(ctx->base + ctx->header->e_shoff);
+
+    if (ctx->header->e_shstrndx >= ctx->header->e_shnum) {
+        return false;
+    }
+
+    const Elf64_Shdr& section_names = ctx->sections[ctx->header->e_shstrndx];
+    if (section_names.sh_offset + section_names.sh_size > object_size) {
+        return false;
+    }
+
+    for (size_t i = 0; i < ctx->header->e_shnum; i++) {
+        const Elf64_Shdr& section = ctx->sections[i];
+
+        if (section.sh_type != SHT_NOBITS && section.sh_offset + section.sh_size > object_size) {
+            return false;
+        }
+
+        if (section.sh_name >= section_names.sh_size) {
+            return false;
+        }
+
+        if (section.sh_type == SHT_SYMTAB) {
+            if (section.sh_link >= ctx->header->e_shnum || section.sh_entsize != sizeof(Elf64_Sym)) {
+                return false;
+            }
+
+            const Elf64_Shdr& strings = ctx->sections[section.sh_link];
+            if (strings.sh_offset + strings.sh_size > object_size) {
+                return false;
+            }
+
+            ctx->sym_table = reinterpret_cast<Elf64_Sym*>(ctx->base + section.sh_offset);
+            ctx->sym_count = section.sh_size / sizeof(Elf64_Sym);
+            ctx->str_table = reinterpret_cast<const char*>(ctx->base + strings.sh_offset);
+            ctx->str_size  = strings.sh_size;
+        }
+    }
+
+    if (ctx->sym_table == nullptr) {
+        return false;
+    }
+
+    //
+    // Relocation sections must reference the symbol table and a valid section.
+    //
+    for (size_t i = 0; i < ctx->header->e_shnum; i++) {
+        const Elf64_Shdr& section = ctx->sections[i];
+
+        if (section.sh_type == SHT_REL) { // x86-64 only ever uses RELA
+            return false;
+        }
+
+        if (section.sh_type != SHT_RELA) {
+            continue;
+        }
+
+        if (section.sh_info >= ctx->header->e_shnum || section.sh_entsize != sizeof(Elf64_Rela)) {
+            return false;
+        }
+
+        const auto* relocation = reinterpret_cast<Elf64_Rela*>(ctx->base + section.sh_offset);
+        for (size_t j = 0; j < section.sh_size / sizeof(Elf64_Rela); j++) {
+            if (ELF64_R_SYM(relocation[j].r_info) >= ctx->sym_count) {
+                return false;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < ctx->sym_count; i++) {
+        const Elf64_Sym& symbol = ctx->sym_table[i];
+        if (symbol.st_name >= ctx->str_size) {
+            return false;
+        }
+
+        if (symbol.st_shndx == SHN_COMMON) { // built with -fcommon, not supported
+            return false;
+        }
+
+        //
+        // Of the reserved indices only SHN_ABS means anything here, SHN_XINDEX
+        // and the processor/OS specific ones would index past the sections.
+        //
+        if (symbol.st_shndx != SHN_UNDEF && symbol.st_shndx != SHN_ABS && symbol.st_shndx >= ctx->header->e_shnum) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const char* elf_symbol_name(const elf_context* ctx, const Elf64_Sym* symbol)
+{
+    //
+    // Section symbols are unnamed, use the name of their section instead.
+    //
+    if (ELF64_ST_TYPE(symbol->st_info) == STT_SECTION && symbol->st_shndx < ctx->header->e_shnum) {
+        const Elf64_Shdr& section_names = ctx->sections[ctx->header->e_shstrndx];
+        return reinterpret_cast<const char*>(ctx->base + section_names.sh_offset + ctx->sections[symbol->st_shndx].sh_name);
+    }
+
+    return ctx->str_table + symbol->st_name;
+}
+
+uint64_t elf_virtual_size(elf_context* ctx)
+{
+    uint64_t total_size = 0;
+
+    //
+    // Add up each page aligned allocated section (SHT_NOBITS included).
+    //
+    for (size_t i = 0; i < ctx->header->e_shnum; i++) {
+        if (elf_section_allocated(ctx->sections[i])) {
+            total_size += PAGE_ALIGN(ctx->sections[i].sh_size);
+        }
+    }
+
+    for (size_t i = 0; i < ctx->header->e_shnum; i++) {
+        const Elf64_Shdr& section = ctx->sections[i];
+        if (section.sh_type != SHT_RELA || !elf_section_allocated(ctx->sections[section.sh_info])) {
+            continue;
+        }
+
+        const auto* relocation = reinterpret_cast<Elf64_Rela*>(ctx->base + section.sh_offset);
+        for (size_t j = 0; j < section.sh_size / sizeof(Elf64_Rela); j++) {
+            if (elf_needs_import_entry(ctx, relocation[j])) {
+                total_size += sizeof(elf_import_entry);
+            }
+        }
+    }
+
+    return PAGE_ALIGN(total_size);
+}
+
+void elf_map_sections(elf_context* ctx, void* virtual_addr)
+{
+    void* section_base = virtual_addr;
+
+    //
+    // ctx->sec_map must hold e_shnum entries. Memory from platform_alloc is
+    // already zeroed, which takes care of SHT_NOBITS (.bss).
+    //
+    for (size_t i = 0; i < ctx->header->e_shnum; i++) {
+        const Elf64_Shdr& section = ctx->sections[i];
+        if (!elf_section_allocated(section)) {
+            continue;
+        }
+
+        ctx->sec_map[i].base = section_base;
+        ctx->sec_map[i].size = section.sh_size;
+
+        if (section.sh_type != SHT_NOBITS) {
+            memcpy(section_base, reinterpret_cast<void*>(ctx->base + section.sh_offset), section.sh_size);
+        }
+
+        section_base = reinterpret_cast<void*>(PAGE_ALIGN(PTR_TO_U64(section_base) + section.sh_size));
+    }
+
+    ctx->imports = static_cast<elf_import_entry*>(section_base);
+}
+
+std::vector<protection_range> elf_protection_plan(const elf_context* ctx, void* image, const uint64_t image_size)
+{
+    std::vector<protection_range> plan;
+
+    for (size_t i = 0; i < ctx->header->e_shnum; i++) {
+        const Elf64_Shdr& section = ctx->sections[i];
+        page_protection protection = PROTECT_READ_ONLY;
+
+        if (ctx->sec_map[i].base == nullptr) {
+            continue;
+        }
+
+        if (section.sh_flags & SHF_EXECINSTR) {
+            protection = PROTECT_READ_EXECUTE;
+        } else if (section.sh_flags & SHF_WRITE) {
+            protection = PROTECT_READ_WRITE;
+        }
+
+        protection_plan_add(plan, ctx->sec_map[i].base, PAGE_ALIGN(ctx->sec_map[i].size), protection);
+    }
+
+    const uint64_t image_end = PTR_TO_U64(image) + image_size;
+    if (PTR_TO_U64(ctx->imports) < image_end) {
+        protection_plan_add(plan, ctx->imports, image_end - PTR_TO_U64(ctx->imports),
+            ctx->import_count != 0 ? PROTECT_READ_EXECUTE : PROTECT_READ_ONLY);
+    }
+
+    return plan;
+}
+
+bool elf_relocation_supported(const uint32_t type)
+{
+    switch (type) {
+    case R_X86_64_NONE:
+    case R_X86_64_64:
+    case R_X86_64_PC64:
+    case R_X86_64_PC32:
+    case R_X86_64_PLT32:
+    case R_X86_64_GOTPCREL:
+    case R_X86_64_GOTPCRELX:
+    case R_X86_64_REX_GOTPCRELX:
+    case R_X86_64_32:
+    case R_X86_64_32S:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool elf_process_relocations(elf_context* ctx, symbol_resolver resolve)
+{
+    size_t import_index = 0;
+
+    for (size_t i = 0; i < ctx->header->e_shnum; i++) {
+        const Elf64_Shdr& section = ctx->sections[i];
+        if (section.sh_type != SHT_RELA || !elf_section_allocated(ctx->sections[section.sh_info])) {
+            continue;
+        }
+
+        const auto* relocation = reinterpret_cast<Elf64_Rela*>(ctx->base + section.sh_offset);
+        void* target_base = ctx->sec_map[section.sh_info].base;
+
+        for (size_t j = 0; j < section.sh_size / sizeof(Elf64_Rela); j++) {
+            const Elf64_Rela& rel    = relocation[j];
+            const Elf64_Sym& symbol  = ctx->sym_table[ELF64_R_SYM(rel.r_info)];
+            const uint32_t type      = ELF64_R_TYPE(rel.r_info);
+            const uint64_t place     = PTR_TO_U64(target_base) + rel.r_offset;
+            uint64_t symbol_addr     = 0;
+            elf_import_entry* entry  = nullptr;
+
+            if (type == R_X86_64_NONE) {
+                continue;
+            }
+
+            const uint64_t target_size = ctx->sections[section.sh_info].sh_size;
+            if (rel.r_offset > target_size || elf_relocation_width(type) > target_size - rel.r_offset) {
+                return false;
+            }
+
+            //
+            // S: the symbol's address, either inside of the image or resolved.
+            //
+            if (symbol.st_shndx == SHN_UNDEF) {
+                symbol_addr = PTR_TO_U64(resolve(elf_symbol_name(ctx, &symbol)));
+                if (symbol_addr == 0) {
+                    return false;
+                }
+            } else if (symbol.st_shndx == SHN_ABS) {
+                symbol_addr = symbol.st_value;
+            } else {
+                if (symbol.st_shndx >= ctx->header->e_shnum || ctx->sec_map[symbol.st_shndx].base == nullptr) {
+                    return false;
+                }
+                symbol_addr = PTR_TO_U64(ctx->sec_map[symbol.st_shndx].base) + symbol.st_value;
+            }
+
+            if (elf_needs_import_entry(ctx, rel)) {
+                entry = &ctx->imports[import_index++];
+                entry->address = symbol_addr;
+                memcpy(entry->stub, "\xFF\x25\xF2\xFF\xFF\xFF\xCC\xCC", sizeof(entry->stub)); // jmp [rip - 14]
+            }
+
+            const auto addend = static_cast<int64_t>(rel.r_addend);
+            void* target = reinterpret_cast<void*>(place);
+
+            switch (type) {
+            case R_X86_64_64:
+                *static_cast<uint64_t*>(target) = symbol_addr + addend;
+                break;
+            case R_X86_64_PC64:
+                *static_cast<uint64_t*>(target) = symbol_addr + addend - place;
+                break;
+            case R_X86_64_PC32:
+            case R_X86_64_PLT32:
+                //
+                // Symbols in reach (e.g. data of a library object) are referenced directly,
+                // anything further away can only be called through the stub.
+                //
+                if (entry != nullptr && static_cast<int64_t>(symbol_addr + addend - place) != static_cast<int32_t>(symbol_addr + addend - place)) {
+                    symbol_addr = PTR_TO_U64(entry->stub);
+                }
+                if (!elf_write_checked<int32_t>(target, static_cast<int64_t>(symbol_addr + addend - place))) {
+                    return false;
+                }
+                break;
+            case R_X86_64_GOTPCREL:
+            case R_X86_64_GOTPCRELX:
+            case R_X86_64_REX_GOTPCRELX:
+                if (!elf_write_checked<int32_t>(target, static_cast<int64_t>(PTR_TO_U64(&entry->address) + addend - place))) {
+                    return false;
+                }
+                break;
+            case R_X86_64_32:
+                if (symbol_addr + addend > UINT32_MAX) {
+                    return false;
+                }
+                *static_cast<uint32_t*>(target) = static_cast<uint32_t>(symbol_addr + addend);
+                break;
+            case R_X86_64_32S:
+                if (!elf_write_checked<int32_t>(target, static_cast<int64_t>(symbol_addr + addend))) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+            }
+        }
+    }
+
+    ctx->import_count = import_index;
+    return true;
+}
+
+void* elf_find_function(elf_context* ctx, const char* name)
+{
+    for (size_t i = 0; i < ctx->sym_count; i++) {
+        const Elf64_Sym& symbol = ctx->sym_table[i];
+
+        if (ELF64_ST_TYPE(symbol.st_info) == STT_FUNC
+            && symbol.st_shndx != SHN_UNDEF
+            && symbol.st_shndx < ctx->header->e_shnum
+            && ctx->sec_map[symbol.st_shndx].base != nullptr
+            && strcmp(name, elf_symbol_name(ctx, &symbol)) == 0) {
+            return reinterpret_cast<void*>(PTR_TO_U64(ctx->sec_map[symbol.st_shndx].base) + symbol.st_value);
+        }
+    }
+
+    return nullptr;
+}
+
+const Elf64_Sym* elf_nearest_symbol(const elf_context* ctx, const uint64_t address, uint64_t* offset)
+{
+    const Elf64_Sym* nearest = nullptr;
+    uint64_t nearest_addr    = 0;
+
+    for (size_t i = 0; i < ctx->sym_count; i++) {
+        const Elf64_Sym& symbol = ctx->sym_table[i];
+
+        if (symbol.st_shndx == SHN_UNDEF || symbol.st_shndx >= ctx->header->e_shnum
+            || ctx->sec_map[symbol.st_shndx].base == nullptr
+            || ELF64_ST_TYPE(symbol.st_info) == STT_FILE) {
+            continue;
+        }
+
+        const section_map& section = ctx->sec_map[symbol.st_shndx];
+        const uint64_t symbol_addr = PTR_TO_U64(section.base) + symbol.st_value;
+
+        if (address < PTR_TO_U64(section.base) || address >= PTR_TO_U64(section.base) + section.size || symbol_addr > address) {
+            continue;
+        }
+
+        if (nearest == nullptr || symbol_addr > nearest_addr
+            || (symbol_addr == nearest_addr && ELF64_ST_TYPE(nearest->st_info) == STT_SECTION)) {
+            nearest = &symbol;
+            nearest_addr = symbol_addr;
+        }
+    }
+
+    if (nearest != nullptr && offset != nullptr) {
+        *offset = address - nearest_addr;
+    }
+
+    return nearest;
+}
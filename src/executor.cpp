@@ -0,0 +1,801 @@
+#include <bof-exec.hpp>
+
+//
+// The entry call goes through platform_guarded_call, which takes a plain
+// function and a context pointer.
+//
+struct entry_call {
+    void (BOF_API *main)(char*, uint32_t);
+    char* args;
+    uint32_t argc;
+};
+
+void call_entry(void* context)
+{
+    const auto* call = static_cast<entry_call*>(context);
+    call->main(call->args, call->argc);
+}
+
+namespace {
+
+std::atomic<bool> forking { false };
+
+struct forked_entry {
+    void (*function)(void*);
+    void* context;
+};
+
+//
+// Runs in the child: Beacon output goes to the parent as it is produced, and
+// BeaconIsCancelled() follows the parent's cancel flag
+//
+void call_forked_entry(void* context)
+{
+    const auto* entry = static_cast<forked_entry*>(context);
+    set_beacon_output_sink(platform_forked_output);
+    set_beacon_cancel_flag(platform_forked_cancel_flag());
+    entry->function(entry->context);
+}
+
+//
+// Runs in the parent, on the thread that owns the job's output buffer
+//
+void receive_forked_output(const char* data, const size_t size)
+{
+    std::string chunk(data, size);
+    manip_beacon_output(chunk.data(), false, false, nullptr);
+}
+
+//
+// The BOF's entry call, on this thread or in a forked child
+//
+bool run_entry(void (*function)(void*), void* context, platform_fault* fault, platform_guard* guard)
+{
+    if (!forking.load(std::memory_order_relaxed)) {
+        return platform_guarded_call(function, context, fault, guard);
+    }
+
+    forked_entry entry = { function, context };
+    return platform_forked_call(call_forked_entry, &entry, fault, guard, receive_forked_output, get_beacon_cancel_flag());
+}
+
+} // namespace
+
+void fork_set_enabled(const bool enabled)
+{
+    static std::once_flag handlers;
+
+    if (enabled) {
+        std::call_once(handlers, []() { platform_at_fork(beacon_fork_prepare, beacon_fork_parent, beacon_fork_child); });
+    }
+    forking.store(enabled, std::memory_order_relaxed);
+}
+
+bool fork_enabled()
+{
+    return forking.load(std::memory_order_relaxed);
+}
+
+void report_fault(const platform_fault& fault, const std::string& symbol_name, const uint64_t offset)
+{
+    if (fault.code == PLATFORM_FAULT_ABORTED) {
+        std::cerr << "[!] ERROR, BOF was stopped after running out of time" << std::hex;
+    } else {
+        std::cerr << "[!] ERROR, BOF crashed: " << platform_fault_name(fault.code)
+                  << " (0x" << std::hex << fault.code << ")";
+    }
+
+    if (fault.pc != 0) {
+        std::cerr << " at 0x" << fault.pc;
+        if (!symbol_name.empty()) {
+            std::cerr << " (" << symbol_name << "+0x" << offset << ")";
+        } else {
+            std::cerr << " (outside of the object)";
+        }
+    }
+
+    if (fault.address != 0) {
+        std::cerr << ", accessing 0x" << fault.address;
+    }
+
+    std::cerr << std::dec << std::endl;
+}
+
+//
+// platform_protect on the image, accounted for by --memory
+//
+bool protect_image(void* address, const uint64_t size, const page_protection protection)
+{
+    if (!platform_protect(address, size, protection)) {
+        return false;
+    }
+
+    footprint_protect(address, size, protection);
+    return true;
+}
+
+//
+// Applies a protection plan. Images start out read/write (fresh, or reset by
+// reserve_image), so read/write ranges take no call.
+//
+bool protect_image_plan(const std::vector<protection_range>& plan)
+{
+    for (const protection_range& range : plan) {
+        if (range.protection != PROTECT_READ_WRITE && !protect_image(range.address, range.size, range.protection)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+loaded_image::~loaded_image()
+{
+    platform_free(address, size);
+}
+
+//
+// Memory for an image of layout. Without keep that is a fresh allocation the
+// caller frees, with it the kept image if the layout matches.
+//
+void* reserve_image(loaded_image* keep, std::vector<uint64_t>&& layout, const uint64_t size)
+{
+    if (keep == nullptr) {
+        return platform_alloc(size);
+    }
+
+    keep->reused = keep->address != nullptr && keep->size == size && keep->layout == layout;
+    metrics_add(keep->reused ? METRIC_IMAGE_REUSED : METRIC_IMAGE_RELAID);
+
+    if (keep->reused) {
+        //
+        // Same layout: back to read/write and cleared, like a fresh allocation
+        //
+        if (!platform_protect(keep->address, keep->size, PROTECT_READ_WRITE)) {
+            return nullptr;
+        }
+        memset(keep->address, 0, keep->size);
+        return keep->address;
+    }
+
+    platform_free(keep->address, keep->size);
+    keep->address = platform_alloc(size);
+    keep->size    = keep->address != nullptr ? size : 0;
+    keep->layout  = std::move(layout);
+    return keep->address;
+}
+
+bool object_execute(object_context* ctx, const char* entry, char* args, const uint32_t argc, platform_guard* guard)
+{
+    void (BOF_API *main)(char*, uint32_t) = nullptr;
+    char* symbol_name              = nullptr;
+    void* section_base             = nullptr;
+
+#if !BOF_NATIVE_EXECUTION
+    std::cerr << "[!] ERROR, BOFs can only be executed on x86-64." << std::endl;
+    return false;
+#endif
+
+    for (size_t i = 0; i < ctx->symbol_count; i++) {
+        const object_symbol symbol = object_symbol_at(ctx, i);
+        symbol_name = object_symbol_name(ctx, symbol);
+
+        if (ISFCN(symbol.type) && symbol.section > 0 && strcmp(entry, symbol_name) == 0) {
+            section_base = ctx->sec_map[symbol.section - 1].base;
+
+            //
+            // Call the function, the image is already protected for good. A fault inside of the BOF fails the job instead of the process,
+            // the caller then frees the image as usual.
+            //
+            main = reinterpret_cast<decltype(main)>(PTR_TO_U64(section_base) + symbol.value);
+
+            entry_call call = { main, args, argc };
+            platform_fault fault = {};
+
+            footprint_entry();
+            perf_phase_start(PERF_PHASE_EXECUTE);
+            const bool completed = run_entry(call_entry, &call, &fault, guard);
+            perf_phase_stop(PERF_PHASE_EXECUTE);
+
+            if (!completed) {
+                uint64_t offset = 0;
+                object_symbol nearest = {};
+                std::string name;
+
+                if (object_nearest_symbol(ctx, fault.pc, &nearest, &offset)) {
+                    const char* nearest_name = object_symbol_name(ctx, nearest);
+                    name = nearest.short_name != nullptr // short names are not always terminated
+                        ? std::string(nearest_name, strnlen(nearest_name, IMAGE_SIZEOF_SHORT_NAME))
+                        : std::string(nearest_name);
+                } else {
+                    link_describe_address(fault.pc, &name, &offset);
+                }
+
+                report_fault(fault, name, offset);
+                return false;
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#if BOF_ELF_SUPPORT
+//
+// ELF objects are System V code: "go" is called as void go(char*, int), and the
+// Beacon API they import is bound to the System V entry points.
+//
+struct elf_entry_call {
+    void (*main)(char*, int);
+    char* args;
+    int argc;
+};
+
+void call_elf_entry(void* context)
+{
+    const auto* call = static_cast<elf_entry_call*>(context);
+    call->main(call->args, call->argc);
+}
+
+bool elf_execute(elf_context* ctx, const char* entry, char* args, const uint32_t argc, platform_guard* guard)
+{
+    void (*main)(char*, int) = nullptr;
+
+    main = reinterpret_cast<decltype(main)>(elf_find_function(ctx, entry));
+    if (main == nullptr) {
+        return false;
+    }
+
+    elf_entry_call call = { main, args, static_cast<int>(argc) };
+    platform_fault fault = {};
+
+    footprint_entry();
+    perf_phase_start(PERF_PHASE_EXECUTE);
+    const bool completed = run_entry(call_elf_entry, &call, &fault, guard);
+    perf_phase_stop(PERF_PHASE_EXECUTE);
+
+    if (!completed) {
+        uint64_t offset = 0;
+        std::string name;
+
+        if (const Elf64_Sym* nearest = elf_nearest_symbol(ctx, fault.pc, &offset)) {
+            name = elf_symbol_name(ctx, nearest);
+        } else {
+            link_describe_address(fault.pc, &name, &offset);
+        }
+
+        report_fault(fault, name, offset);
+        return false;
+    }
+
+    return true;
+}
+
+bool load_elf_object(
+    void* pobject,
+    const size_t object_size,
+    const std::string& func_name,
+    char* arguments,
+    const uint32_t argc,
+    platform_guard* guard,
+    loaded_image* keep)
+{
+    elf_context ctx = {};
+    uint64_t virtual_size = 0;
+    void* virtual_addr = nullptr;
+
+    //------------------------------------//
+
+    auto _ = defer([&]() {
+        if (virtual_addr != nullptr && keep == nullptr) {
+            platform_free(virtual_addr, virtual_size);
+        }
+        if (ctx.sec_map != nullptr) {
+            free(ctx.sec_map);
+            ctx.sec_map = nullptr;
+        }
+    });
+
+    perf_phase_start(PERF_PHASE_PARSE);
+    const bool parsed = elf_parse(&ctx, pobject, object_size);
+    perf_phase_stop(PERF_PHASE_PARSE);
+
+    if (!parsed) {
+        std::cerr << "[!] ERROR, Malformed or unsupported ELF object." << std::endl;
+        return false;
+    }
+
+    perf_phase_start(PERF_PHASE_LAYOUT);
+    auto laid_out = defer([]() { perf_phase_stop(PERF_PHASE_LAYOUT); });
+
+    virtual_size = elf_virtual_size(&ctx);
+
+    std::vector<uint64_t> layout = { ELFMAG0 };
+    for (size_t i = 0; i < ctx.header->e_shnum; i++) {
+        layout.push_back(ctx.sections[i].sh_size);
+    }
+    virtual_addr = reserve_image(keep, std::move(layout), virtual_size);
+
+    if (virtual_addr == nullptr) {
+        return false;
+    }
+
+    ctx.sec_map = static_cast<section_map*>(calloc(
+        ctx.header->e_shnum,
+        sizeof(section_map)));
+
+    if (ctx.sec_map == nullptr) {
+        return false;
+    }
+
+    elf_map_sections(&ctx, virtual_addr);
+    laid_out.call();
+
+    if (footprint_enabled()) {
+        footprint_image(object_size, virtual_addr, virtual_size);
+        for (size_t i = 0; i < ctx.header->e_shnum; i++) {
+            if (ctx.sec_map[i].base != nullptr) {
+                footprint_section(ctx.sec_map[i].size);
+            }
+        }
+    }
+
+    perf_phase_start(PERF_PHASE_RELOCATE);
+    auto relocated = defer([]() { perf_phase_stop(PERF_PHASE_RELOCATE); });
+
+    if (!elf_process_relocations(&ctx, trace_active() ? trace_resolve_elf_symbol : resolve_elf_symbol)) {
+        std::cerr << "[!] ERROR, Failed to relocate ELF object." << std::endl;
+        return false;
+    }
+
+    //
+    // Every entry is an address and a stub, both always written
+    //
+    footprint_imports(ctx.imports, 2 * ctx.import_count, 2 * ctx.import_count);
+
+    //
+    // Final protection for the whole image, nothing changes it while the BOF runs
+    //
+    if (!protect_image_plan(elf_protection_plan(&ctx, virtual_addr, virtual_size))) {
+        return false;
+    }
+
+    relocated.call();
+    return elf_execute(&ctx, func_name.c_str(), arguments, argc, guard);
+}
+#endif
+
+//
+// The steps after the sections are in the image, shared by file and stream loads
+//
+bool relocate_and_execute(
+    object_context* ctx,
+    void* virtual_addr,
+    const uint64_t virtual_size,
+    const std::string& func_name,
+    char* arguments,
+    const uint32_t argc,
+    platform_guard* guard)
+{
+    //
+    // Process COFF sections
+    //
+    perf_phase_start(PERF_PHASE_RELOCATE);
+    auto relocated = defer([]() { perf_phase_stop(PERF_PHASE_RELOCATE); });
+
+    if (!process_object_sections(ctx, trace_active() ? trace_resolve_object_symbol : resolve_object_symbol)) {
+        if (const std::string error = object_fixup_error_string(ctx); !error.empty()) {
+            std::cerr << "[!] ERROR, Failed to relocate COFF object: " << error << std::endl;
+        }
+        return false;
+    }
+
+    //
+    // References into other objects reserve a second slot for a call stub,
+    // which stays empty while the target is in reach
+    //
+    if (footprint_enabled()) {
+        const uint32_t filled = static_cast<uint32_t>(std::count_if(
+            ctx->sym_map, ctx->sym_map + ctx->import_slots, [](const PVOID slot) { return slot != nullptr; }));
+        footprint_imports(ctx->sym_map, ctx->import_slots, filled);
+    }
+
+    //
+    // Final protection for the whole image, nothing changes it while the BOF runs
+    //
+    if (!protect_image_plan(object_protection_plan(ctx, virtual_addr, virtual_size))) {
+        return false;
+    }
+
+    relocated.call();
+
+    //
+    // Execute "go"
+    //
+    return object_execute(ctx, func_name.c_str(), arguments, argc, guard);
+}
+
+bool load_object(
+    void* pobject,
+    const size_t object_size,
+    const std::string& func_name,
+    char* arguments,
+    const uint32_t argc,
+    platform_guard* guard,
+    loaded_image* keep)
+{
+
+    object_context ctx = {};
+    uint64_t virtual_size = 0;
+    void* virtual_addr = nullptr;
+
+    //------------------------------------//
+
+    auto _ = defer([&]() {
+        if (virtual_addr != nullptr && keep == nullptr) {
+            platform_free(virtual_addr, virtual_size);
+        }
+        if (ctx.sec_map != nullptr) {
+            free(ctx.sec_map);
+            ctx.sec_map = nullptr;
+        }
+    });
+
+    if (!pobject || func_name.empty()) {
+        return false;
+    }
+
+    //
+    // The format is picked from the header: ELF objects start with "\x7f""ELF",
+    // anything else is treated as COFF.
+    //
+    if (object_size >= 4 && memcmp(pobject, "\x7f""ELF", 4) == 0) {
+#if BOF_ELF_SUPPORT
+        return load_elf_object(pobject, object_size, func_name, arguments, argc, guard, keep);
+#else
+        std::cerr << "[!] ERROR, ELF objects can only be executed on x86-64 Linux." << std::endl;
+        return false;
+#endif
+    }
+
+    perf_phase_start(PERF_PHASE_PARSE);
+    const bool parsed = object_parse(&ctx, pobject, object_size);
+    perf_phase_stop(PERF_PHASE_PARSE);
+
+    if (!parsed) {
+        return false;
+    }
+
+    //
+    // allocate memory
+    //
+    perf_phase_start(PERF_PHASE_LAYOUT);
+    auto laid_out = defer([]() { perf_phase_stop(PERF_PHASE_LAYOUT); });
+
+    virtual_size = object_virtual_size(&ctx);
+
+    std::vector<uint64_t> layout = { IMAGE_FILE_MACHINE_AMD64 };
+    for (size_t i = 0; i < ctx.section_count; i++) {
+        layout.push_back(ctx.sections[i].SizeOfRawData);
+    }
+    virtual_addr = reserve_image(keep, std::move(layout), virtual_size);
+
+    if (virtual_addr == nullptr) {
+        return false;
+    }
+
+    ctx.sec_map = static_cast<section_map*>(calloc(
+        ctx.section_count,
+        sizeof(section_map)));
+
+    if (ctx.sec_map == nullptr) {
+        return false;
+    }
+
+    //
+    // copy over sections from the object file
+    //
+    object_map_sections(&ctx, virtual_addr);
+    laid_out.call();
+
+    if (footprint_enabled()) {
+        footprint_image(object_size, virtual_addr, virtual_size);
+        for (size_t i = 0; i < ctx.section_count; i++) {
+            footprint_section(ctx.sec_map[i].size);
+        }
+    }
+
+    return relocate_and_execute(&ctx, virtual_addr, virtual_size, func_name, arguments, argc, guard);
+}
+
+
+namespace {
+
+//
+// A part of a streamed COFF object, in file order once sorted
+//
+enum stream_part_kind : uint32_t {
+    STREAM_SECTION_DATA,
+    STREAM_RELOCATIONS,
+    STREAM_SYMBOLS,         // the symbol table, and the string table right after it
+};
+
+struct stream_part {
+    uint64_t         offset;
+    uint64_t         size;
+    stream_part_kind kind;
+    uint32_t         section;
+};
+
+//
+// Appends size bytes of the stream to out, growing it as the data arrives so
+// that a bogus size in a header cannot make it allocate up front
+//
+bool stream_append(input_stream& stream, std::vector<char>& out, uint64_t size)
+{
+    constexpr uint64_t step = 1024 * 1024;
+
+    while (size != 0) {
+        const size_t chunk = static_cast<size_t>(std::min(size, step));
+        const size_t old_size = out.size();
+
+        out.resize(old_size + chunk);
+        if (stream.read(out.data() + old_size, chunk) != chunk) {
+            return false;
+        }
+        size -= chunk;
+    }
+
+    return true;
+}
+
+//
+// Everything the stream still holds, after what was already read of it
+//
+void stream_remainder(input_stream& stream, std::vector<char>& out)
+{
+    char buffer[64 * 1024];
+
+    for (size_t read = 0; (read = stream.read(buffer, sizeof(buffer))) != 0;) {
+        out.insert(out.end(), buffer, buffer + read);
+    }
+}
+
+} // namespace
+
+bool load_object_stream(
+    input_stream& stream,
+    const std::string& func_name,
+    char* arguments,
+    const uint32_t argc,
+    platform_guard* guard)
+{
+    object_context ctx = {};
+    std::vector<char> metadata;
+    std::vector<stream_part> parts;
+    uint64_t virtual_size = 0;
+    void* virtual_addr = nullptr;
+
+    uint64_t headers_size = sizeof(IMAGE_FILE_HEADER);
+    uint64_t symbol_table = 0;
+    uint64_t relocation_total = 0;
+    uint32_t section_count = 0;
+    uint32_t symbol_count = 0;
+    uint32_t symbol_size = IMAGE_SIZEOF_SYMBOL;
+    bool streamable = true;
+
+    //------------------------------------//
+
+    auto _ = defer([&]() {
+        if (virtual_addr != nullptr) {
+            platform_free(virtual_addr, virtual_size);
+        }
+        if (ctx.sec_map != nullptr) {
+            free(ctx.sec_map);
+            ctx.sec_map = nullptr;
+        }
+    });
+
+    if (func_name.empty()) {
+        return false;
+    }
+
+    perf_phase_start(PERF_PHASE_PARSE);
+
+    if (!stream_append(stream, metadata, headers_size)) {
+        perf_phase_stop(PERF_PHASE_PARSE);
+        std::cerr << "[!] ERROR, Object stream ended inside of the file header." << std::endl;
+        return false;
+    }
+
+    //
+    // Big objects start with Sig1 = 0 and Sig2 = 0xFFFF where classic ones
+    // have their machine and section count
+    //
+    const auto* classic = reinterpret_cast<const IMAGE_FILE_HEADER*>(metadata.data());
+    const bool big_object = classic->Machine == IMAGE_FILE_MACHINE_UNKNOWN && classic->NumberOfSections == 0xFFFF;
+
+    if (memcmp(metadata.data(), "\x7f""ELF", 4) == 0) {
+        streamable = false;
+    } else if (big_object) {
+        headers_size = sizeof(ANON_OBJECT_HEADER_BIGOBJ);
+        if (!stream_append(stream, metadata, headers_size - sizeof(IMAGE_FILE_HEADER))) {
+            perf_phase_stop(PERF_PHASE_PARSE);
+            std::cerr << "[!] ERROR, Object stream ended inside of the file header." << std::endl;
+            return false;
+        }
+
+        const auto* header = reinterpret_cast<const ANON_OBJECT_HEADER_BIGOBJ*>(metadata.data());
+        streamable    = header->Machine == IMAGE_FILE_MACHINE_AMD64;
+        section_count = header->NumberOfSections;
+        symbol_count  = header->NumberOfSymbols;
+        symbol_table  = header->PointerToSymbolTable;
+        symbol_size   = IMAGE_SIZEOF_SYMBOL_EX;
+    } else {
+        streamable    = classic->Machine == IMAGE_FILE_MACHINE_AMD64;
+        section_count = classic->NumberOfSections;
+        symbol_count  = classic->NumberOfSymbols;
+        symbol_table  = classic->PointerToSymbolTable;
+    }
+
+    if (streamable && !stream_append(stream, metadata, INT_TO_U64(section_count) * sizeof(IMAGE_SECTION_HEADER))) {
+        perf_phase_stop(PERF_PHASE_PARSE);
+        std::cerr << "[!] ERROR, Object stream ended inside of the section table." << std::endl;
+        return false;
+    }
+
+    //
+    // Lay out the parts of the file that follow the section table. The stream
+    // can only go forward, so they have to come in order without overlapping,
+    // with the symbol and string table last.
+    //
+    const uint64_t tables_end = metadata.size();
+
+    for (uint32_t i = 0; streamable && i < section_count; i++) {
+        const auto& section = reinterpret_cast<const IMAGE_SECTION_HEADER*>(metadata.data() + headers_size)[i];
+
+        if (section.PointerToRawData != 0 && section.SizeOfRawData != 0) {
+            parts.push_back({ section.PointerToRawData, section.SizeOfRawData, STREAM_SECTION_DATA, i });
+        }
+        if (section.NumberOfRelocations != 0) {
+            parts.push_back({ section.PointerToRelocations, INT_TO_U64(section.NumberOfRelocations) * sizeof(IMAGE_RELOCATION), STREAM_RELOCATIONS, i });
+            relocation_total += section.NumberOfRelocations;
+        }
+        streamable = !(section.Characteristics & IMAGE_SCN_LNK_NRELOC_OVFL);
+    }
+
+    std::stable_sort(parts.begin(), parts.end(), [](const stream_part& a, const stream_part& b) { return a.offset < b.offset; });
+    parts.push_back({ symbol_table, INT_TO_U64(symbol_count) * symbol_size, STREAM_SYMBOLS, 0 });
+
+    for (size_t i = 0; streamable && i < parts.size(); i++) {
+        streamable = parts[i].offset >= (i == 0 ? tables_end : parts[i - 1].offset + parts[i - 1].size);
+    }
+
+    perf_phase_stop(PERF_PHASE_PARSE);
+
+    if (!streamable) {
+        stream_remainder(stream, metadata);
+        return load_object(metadata.data(), metadata.size(), func_name, arguments, argc, guard);
+    }
+
+    //
+    // Reserve the image before any section data arrives: every section page
+    // aligned, then room for the worst case of two slots per relocation
+    //
+    perf_phase_start(PERF_PHASE_LAYOUT);
+    auto laid_out = defer([]() { perf_phase_stop(PERF_PHASE_LAYOUT); });
+
+    std::vector<uint64_t> section_offsets(section_count, 0);
+    std::vector<uint64_t> relocation_offsets(section_count, 0);
+
+    for (uint32_t i = 0; i < section_count; i++) {
+        section_offsets[i] = virtual_size;
+        virtual_size += PAGE_ALIGN(reinterpret_cast<const IMAGE_SECTION_HEADER*>(metadata.data() + headers_size)[i].SizeOfRawData);
+    }
+    const uint64_t import_offset = virtual_size;
+    virtual_size = PAGE_ALIGN(virtual_size + relocation_total * 2 * sizeof(void*));
+
+    if ((virtual_addr = platform_alloc(virtual_size)) == nullptr) {
+        return false;
+    }
+
+    //
+    // Section data goes straight into the image, everything else into metadata
+    //
+    for (const stream_part& part : parts) {
+        if (!stream.skip(part.offset - stream.offset())) {
+            std::cerr << "[!] ERROR, Object stream ended early." << std::endl;
+            return false;
+        }
+
+        switch (part.kind) {
+        case STREAM_SECTION_DATA:
+            if (stream.read(static_cast<char*>(virtual_addr) + section_offsets[part.section], part.size) != part.size) {
+                std::cerr << "[!] ERROR, Object stream ended inside of a section." << std::endl;
+                return false;
+            }
+            break;
+
+        case STREAM_RELOCATIONS:
+            relocation_offsets[part.section] = metadata.size();
+            if (!stream_append(stream, metadata, part.size)) {
+                std::cerr << "[!] ERROR, Object stream ended inside of a relocation table." << std::endl;
+                return false;
+            }
+            break;
+
+        case STREAM_SYMBOLS: {
+            uint32_t string_size = 0;
+            symbol_table = metadata.size();
+
+            if (!stream_append(stream, metadata, part.size + sizeof(uint32_t))) {
+                std::cerr << "[!] ERROR, Object stream ended inside of the symbol table." << std::endl;
+                return false;
+            }
+
+            memcpy(&string_size, metadata.data() + metadata.size() - sizeof(uint32_t), sizeof(uint32_t));
+            if (string_size > sizeof(uint32_t) && !stream_append(stream, metadata, string_size - sizeof(uint32_t))) {
+                std::cerr << "[!] ERROR, Object stream ended inside of the string table." << std::endl;
+                return false;
+            }
+            break;
+        }
+        }
+    }
+
+    //
+    // Point the headers at the metadata copies. Section data is in the image
+    // already, parsing must not look for it.
+    //
+    if (metadata.size() > UINT32_MAX) {
+        std::cerr << "[!] ERROR, Object metadata is too large." << std::endl;
+        return false;
+    }
+
+    if (big_object) {
+        reinterpret_cast<ANON_OBJECT_HEADER_BIGOBJ*>(metadata.data())->PointerToSymbolTable = static_cast<DWORD>(symbol_table);
+    } else {
+        reinterpret_cast<IMAGE_FILE_HEADER*>(metadata.data())->PointerToSymbolTable = static_cast<DWORD>(symbol_table);
+    }
+
+    for (uint32_t i = 0; i < section_count; i++) {
+        auto& section = reinterpret_cast<IMAGE_SECTION_HEADER*>(metadata.data() + headers_size)[i];
+        section.PointerToRawData     = 0;
+        section.PointerToRelocations = static_cast<DWORD>(relocation_offsets[i]);
+    }
+
+    laid_out.call();
+
+    perf_phase_start(PERF_PHASE_PARSE);
+    const bool parsed = object_parse(&ctx, metadata.data(), metadata.size());
+    perf_phase_stop(PERF_PHASE_PARSE);
+
+    if (!parsed) {
+        return false;
+    }
+
+    ctx.sec_map = static_cast<section_map*>(calloc(
+        ctx.section_count,
+        sizeof(section_map)));
+
+    if (ctx.sec_map == nullptr) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < ctx.section_count; i++) {
+        ctx.sec_map[i].base = static_cast<char*>(virtual_addr) + section_offsets[i];
+        ctx.sec_map[i].size = ctx.sections[i].SizeOfRawData;
+    }
+    ctx.sym_map = reinterpret_cast<PVOID*>(static_cast<char*>(virtual_addr) + import_offset);
+
+    if (footprint_enabled()) {
+        footprint_image(stream.offset(), virtual_addr, virtual_size);
+        for (size_t i = 0; i < ctx.section_count; i++) {
+            footprint_section(ctx.sec_map[i].size);
+        }
+    }
+
+    return relocate_and_execute(&ctx, virtual_addr, virtual_size, func_name, arguments, argc, guard);
+}
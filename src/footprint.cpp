@@ -0,0 +1,143 @@
+#include <footprint.hpp>
+#include <beacon_api.hpp>
+#include <macro.hpp>
+#include <atomic>
+#include <vector>
+
+namespace {
+
+struct footprint_state {
+    footprint_stats      stats = {};
+    uint64_t             base  = 0;
+    std::vector<uint8_t> pages;             // footprint_class of every image page
+    int64_t              format_live = 0;
+};
+
+std::atomic<bool> enabled { false };
+thread_local footprint_state footprint;
+
+footprint_class class_of(const page_protection protection)
+{
+    switch (protection) {
+    case PROTECT_READ_EXECUTE: return FOOTPRINT_READ_EXECUTE;
+    case PROTECT_READ_ONLY:    return FOOTPRINT_READ_ONLY;
+    default:                   return FOOTPRINT_READ_WRITE;
+    }
+}
+
+}
+
+void footprint_set_enabled(const bool on)
+{
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+bool footprint_enabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void footprint_begin()
+{
+    footprint.stats = {};
+    footprint.base  = 0;
+    footprint.pages.clear();
+    footprint.format_live = 0;
+}
+
+void footprint_image(const uint64_t object_bytes, void* base, const uint64_t image_bytes)
+{
+    if (!footprint_enabled()) {
+        return;
+    }
+
+    //
+    // Images start out read/write, see platform_alloc
+    //
+    footprint.stats.object_bytes = object_bytes;
+    footprint.stats.image_bytes  = image_bytes;
+    footprint.base = PTR_TO_U64(base);
+    footprint.pages.assign(PAGE_ALIGN(image_bytes) / SIZE_OF_PAGE, FOOTPRINT_READ_WRITE);
+}
+
+void footprint_section(const uint64_t size)
+{
+    if (footprint_enabled()) {
+        footprint.stats.section_bytes += size;
+        footprint.stats.padding_bytes += PAGE_ALIGN(size) - size;
+    }
+}
+
+void footprint_imports(void* area, const uint64_t slots, const uint64_t filled)
+{
+    if (!footprint_enabled() || footprint.pages.empty()) {
+        return;
+    }
+
+    const uint64_t end = footprint.base + footprint.stats.image_bytes;
+    const uint64_t size = PTR_TO_U64(area) < end ? end - PTR_TO_U64(area) : 0;
+
+    footprint.stats.import_area_bytes   = size;
+    footprint.stats.import_slots        = slots;
+    footprint.stats.import_slots_filled = filled;
+    footprint.stats.padding_bytes      += size > slots * sizeof(void*) ? size - slots * sizeof(void*) : 0;
+}
+
+void footprint_protect(void* address, const uint64_t size, const page_protection protection)
+{
+    if (!footprint_enabled() || footprint.pages.empty() || PTR_TO_U64(address) < footprint.base) {
+        return;
+    }
+
+    //
+    // Protection applies to whole pages, as in platform_protect
+    //
+    const uint64_t first = (PTR_TO_U64(address) - footprint.base) / SIZE_OF_PAGE;
+    const uint64_t last  = (PAGE_ALIGN(PTR_TO_U64(address) + size) - footprint.base) / SIZE_OF_PAGE;
+
+    for (uint64_t i = first; i < last && i < footprint.pages.size(); i++) {
+        footprint.pages[i] = static_cast<uint8_t>(class_of(protection));
+    }
+}
+
+void footprint_entry()
+{
+    if (!footprint_enabled()) {
+        return;
+    }
+
+    for (uint64_t& committed : footprint.stats.committed) {
+        committed = 0;
+    }
+    for (const uint8_t page : footprint.pages) {
+        footprint.stats.committed[page] += SIZE_OF_PAGE;
+    }
+}
+
+void footprint_format(const int64_t bytes)
+{
+    if (!footprint_enabled()) {
+        return;
+    }
+
+    footprint.format_live += bytes;
+    if (footprint.format_live > static_cast<int64_t>(footprint.stats.format_high_water)) {
+        footprint.stats.format_high_water = static_cast<uint64_t>(footprint.format_live);
+    }
+}
+
+footprint_stats footprint_end()
+{
+    footprint.stats.output_high_water = beacon_output_capacity();
+    return footprint.stats;
+}
+
+const char* footprint_class_name(const footprint_class protection)
+{
+    switch (protection) {
+    case FOOTPRINT_READ_EXECUTE: return "rx";
+    case FOOTPRINT_READ_ONLY:    return "r";
+    case FOOTPRINT_READ_WRITE:   return "rw";
+    default:                     return "unknown";
+    }
+}
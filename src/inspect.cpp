@@ -0,0 +1,446 @@
+#include <inspect.hpp>
+#include <loader.hpp>
+#include <resolver.hpp>
+#include <beacon_api.hpp>
+#include <util.hpp>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <thread>
+
+#if BOF_ELF_SUPPORT
+#include <elf_loader.hpp>
+#endif
+
+namespace {
+
+#if BOF_ELF_SUPPORT
+const char* elf_relocation_name(const uint32_t type)
+{
+    switch (type) {
+    case R_X86_64_NONE:             return "NONE";
+    case R_X86_64_64:               return "64";
+    case R_X86_64_PC32:             return "PC32";
+    case R_X86_64_GOT32:            return "GOT32";
+    case R_X86_64_PLT32:            return "PLT32";
+    case R_X86_64_GOTPCREL:         return "GOTPCREL";
+    case R_X86_64_32:               return "32";
+    case R_X86_64_32S:              return "32S";
+    case R_X86_64_16:               return "16";
+    case R_X86_64_PC16:             return "PC16";
+    case R_X86_64_8:                return "8";
+    case R_X86_64_PC8:              return "PC8";
+    case R_X86_64_TLSGD:            return "TLSGD";
+    case R_X86_64_TLSLD:            return "TLSLD";
+    case R_X86_64_DTPOFF32:         return "DTPOFF32";
+    case R_X86_64_GOTTPOFF:         return "GOTTPOFF";
+    case R_X86_64_TPOFF32:          return "TPOFF32";
+    case R_X86_64_PC64:             return "PC64";
+    case R_X86_64_GOTOFF64:         return "GOTOFF64";
+    case R_X86_64_GOTPC32:          return "GOTPC32";
+    case R_X86_64_SIZE32:           return "SIZE32";
+    case R_X86_64_SIZE64:           return "SIZE64";
+    case R_X86_64_GOTPCRELX:        return "GOTPCRELX";
+    case R_X86_64_REX_GOTPCRELX:    return "REX_GOTPCRELX";
+    default:                        return "UNKNOWN";
+    }
+}
+#endif
+
+std::string relocation_type(const char* prefix, const char* name, const uint32_t type)
+{
+    return std::string(prefix) + name + " (" + std::to_string(type) + ")";
+}
+
+std::string coff_section_name(const object_context* ctx, const IMAGE_SECTION_HEADER& section)
+{
+    const char* name = reinterpret_cast<const char*>(section.Name);
+    std::string short_name(name, strnlen(name, IMAGE_SIZEOF_SHORT_NAME));
+
+    //
+    // "/123" is an offset into the string table
+    //
+    if (short_name.size() > 1 && short_name[0] == '/') {
+        uint32_t offset = 0;
+        uint32_t string_size = 0;
+        const char* strings = ctx->str_table;
+
+        memcpy(&string_size, strings, sizeof(uint32_t));
+        if (std::from_chars(short_name.data() + 1, short_name.data() + short_name.size(), offset).ec == std::errc()
+            && offset < string_size) {
+            return std::string(strings + offset, strnlen(strings + offset, string_size - offset));
+        }
+    }
+
+    return short_name;
+}
+
+std::string coff_symbol_name(const object_context* ctx, const object_symbol& symbol)
+{
+    const char* name = object_symbol_name(ctx, symbol);
+    return symbol.short_name != nullptr ? std::string(name, strnlen(name, IMAGE_SIZEOF_SHORT_NAME)) : std::string(name);
+}
+
+void inspect_coff(inspect_report& report, void* data, const size_t size)
+{
+    object_context ctx = {};
+    std::set<std::string> imports;
+    std::set<std::string> unsupported;
+    std::set<std::string> unresolved;
+
+    if (!object_parse(&ctx, data, size)) {
+        report.error = "malformed or unsupported COFF object";
+        return;
+    }
+
+    report.virtual_size = object_virtual_size(&ctx);
+
+    for (size_t i = 0; i < ctx.symbol_count; i++) {
+        const object_symbol symbol = object_symbol_at(&ctx, i);
+        if (ISFCN(symbol.type) && symbol.section > 0) {
+            const std::string name = coff_symbol_name(&ctx, symbol);
+            if (symbol.storage_class == IMAGE_SYM_CLASS_EXTERNAL) {
+                report.entry_points.push_back(name);
+            }
+            report.has_entry = report.has_entry || name == "go";
+        }
+        i += symbol.aux_count;
+    }
+
+    for (size_t i = 0; i < ctx.section_count; i++) {
+        const IMAGE_SECTION_HEADER& section = ctx.sections[i];
+        const std::string section_name = coff_section_name(&ctx, section);
+        uint32_t relocation_count = 0;
+        const auto* relocation = object_section_relocations(&ctx, section, &relocation_count);
+
+        report.sections.push_back({ section_name, section.SizeOfRawData, report.import_offset,
+            relocation_count, section.Characteristics });
+        report.import_offset = PAGE_ALIGN(report.import_offset + static_cast<uint64_t>(section.SizeOfRawData));
+
+        for (size_t j = 0; j < relocation_count; j++) {
+            const object_symbol symbol = object_symbol_at(&ctx, relocation[j].SymbolTableIndex);
+            const std::string name = coff_symbol_name(&ctx, symbol);
+            const auto unsupported_relocation = [&] {
+                report.unsupported_relocations.push_back({ section_name, relocation[j].VirtualAddress,
+                    relocation_type("IMAGE_REL_AMD64_", object_relocation_name(relocation[j].Type), relocation[j].Type), name });
+            };
+
+            if (name.compare(0, 6, "__imp_") == 0) {
+                const std::string imported = name.substr(6);
+                imports.insert(imported);
+
+                if (imported.find('$') == std::string::npos && !is_supported_beacon_function(imported.c_str())) {
+                    unsupported.insert(imported);
+                }
+
+                if (!object_relocation_supported(relocation[j].Type)) {
+                    unsupported_relocation();
+                }
+                continue;
+            }
+
+            if (symbol.section <= 0) {
+                unresolved.insert(name);
+            } else if (!object_relocation_supported(relocation[j].Type)) {
+                unsupported_relocation();
+            }
+        }
+    }
+
+    report.imports.assign(imports.begin(), imports.end());
+    report.unsupported_beacon.assign(unsupported.begin(), unsupported.end());
+    report.unresolved_symbols.assign(unresolved.begin(), unresolved.end());
+}
+
+#if BOF_ELF_SUPPORT
+void inspect_elf(inspect_report& report, void* data, const size_t size)
+{
+    elf_context ctx = {};
+    std::set<std::string> imports;
+    std::set<std::string> unsupported;
+
+    if (!elf_parse(&ctx, data, size)) {
+        report.error = "malformed or unsupported ELF object";
+        return;
+    }
+
+    report.virtual_size = elf_virtual_size(&ctx);
+
+    for (size_t i = 0; i < ctx.sym_count; i++) {
+        const Elf64_Sym& symbol = ctx.sym_table[i];
+        if (ELF64_ST_TYPE(symbol.st_info) == STT_FUNC && symbol.st_shndx != SHN_UNDEF) {
+            const char* name = elf_symbol_name(&ctx, &symbol);
+            if (ELF64_ST_BIND(symbol.st_info) != STB_LOCAL) {
+                report.entry_points.push_back(name);
+            }
+            report.has_entry = report.has_entry || strcmp(name, "go") == 0;
+        }
+    }
+
+    const Elf64_Shdr& names = ctx.sections[ctx.header->e_shstrndx];
+    const auto section_name = [&](const Elf64_Shdr& section) {
+        return std::string(reinterpret_cast<const char*>(ctx.base + names.sh_offset + section.sh_name));
+    };
+
+    for (size_t i = 0; i < ctx.header->e_shnum; i++) {
+        const Elf64_Shdr& section = ctx.sections[i];
+        if ((section.sh_flags & SHF_ALLOC) && section.sh_size != 0) {
+            report.sections.push_back({ section_name(section), section.sh_size, report.import_offset, 0, section.sh_flags });
+            report.import_offset = PAGE_ALIGN(report.import_offset + section.sh_size);
+        }
+    }
+
+    for (size_t i = 0; i < ctx.header->e_shnum; i++) {
+        const Elf64_Shdr& section = ctx.sections[i];
+        const Elf64_Shdr& target = ctx.sections[section.sh_info];
+        if (section.sh_type != SHT_RELA || !(target.sh_flags & SHF_ALLOC) || target.sh_size == 0) {
+            continue;
+        }
+
+        const std::string target_name = section_name(target);
+        const auto* relocation = reinterpret_cast<Elf64_Rela*>(ctx.base + section.sh_offset);
+        const size_t count = section.sh_size / sizeof(Elf64_Rela);
+
+        for (inspect_section& listed : report.sections) {
+            if (listed.name == target_name) {
+                listed.relocations += static_cast<uint32_t>(count);
+            }
+        }
+
+        for (size_t j = 0; j < count; j++) {
+            const Elf64_Sym& symbol = ctx.sym_table[ELF64_R_SYM(relocation[j].r_info)];
+            const uint32_t type = ELF64_R_TYPE(relocation[j].r_info);
+            const std::string name = elf_symbol_name(&ctx, &symbol);
+
+            if (symbol.st_shndx == SHN_UNDEF && ELF64_R_SYM(relocation[j].r_info) != 0) {
+                imports.insert(name);
+                if (name.compare(0, 6, "Beacon") == 0 && beacon_sysv_function(name.c_str()) == nullptr) {
+                    unsupported.insert(name);
+                }
+            }
+
+            if (!elf_relocation_supported(type)) {
+                report.unsupported_relocations.push_back({ target_name, relocation[j].r_offset,
+                    relocation_type("R_X86_64_", elf_relocation_name(type), type), name });
+            }
+        }
+    }
+
+    report.imports.assign(imports.begin(), imports.end());
+    report.unsupported_beacon.assign(unsupported.begin(), unsupported.end());
+}
+#endif
+
+void write_json_string(std::ostream& out, const std::string& str)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out << '"';
+    for (const char c : str) {
+        switch (c) {
+        case '"':  out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\r': out << "\\r"; break;
+        case '\t': out << "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out << "\\u00" << hex[(c >> 4) & 0xF] << hex[c & 0xF];
+            } else {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+}
+
+void write_json_strings(std::ostream& out, const std::vector<std::string>& strings)
+{
+    out << '[';
+    for (size_t i = 0; i < strings.size(); i++) {
+        out << (i ? "," : "");
+        write_json_string(out, strings[i]);
+    }
+    out << ']';
+}
+
+void write_json_counts(std::ostream& out, const std::map<std::string, uint64_t>& counts)
+{
+    bool first = true;
+
+    out << '{';
+    for (const auto& [name, count] : counts) {
+        out << (first ? "" : ",");
+        write_json_string(out, name);
+        out << ':' << count;
+        first = false;
+    }
+    out << '}';
+}
+
+} // namespace
+
+inspect_report inspect_object(const std::string& path)
+{
+    inspect_report report;
+    report.path   = path;
+    report.format = "unknown";
+
+    auto file = mapped_file::open(path);
+    if (!file) {
+        report.error = "could not open file";
+        return report;
+    }
+
+    report.file_size = file->size();
+    if (file->size() >= 4 && memcmp(file->data(), "\x7f""ELF", 4) == 0) {
+        report.format = "elf";
+#if BOF_ELF_SUPPORT
+        inspect_elf(report, file->data(), file->size());
+#else
+        report.error = "ELF objects are only supported on x86-64 Linux";
+#endif
+    } else {
+        report.format = "coff";
+        inspect_coff(report, file->data(), file->size());
+    }
+
+    return report;
+}
+
+void inspect_write_json(std::ostream& out, const inspect_report& report)
+{
+    out << "{\"path\":";
+    write_json_string(out, report.path);
+    out << ",\"format\":\"" << report.format << "\"";
+    out << ",\"ok\":" << (report.ok() ? "true" : "false");
+    if (!report.error.empty()) {
+        out << ",\"error\":";
+        write_json_string(out, report.error);
+    }
+    out << ",\"file_size\":" << report.file_size;
+    out << ",\"virtual_size\":" << report.virtual_size;
+    out << ",\"import_offset\":" << report.import_offset;
+    out << ",\"has_entry\":" << (report.has_entry ? "true" : "false");
+    out << ",\"entry_points\":";
+    write_json_strings(out, report.entry_points);
+
+    out << ",\"sections\":[";
+    for (size_t i = 0; i < report.sections.size(); i++) {
+        const inspect_section& section = report.sections[i];
+        out << (i ? "," : "") << "{\"name\":";
+        write_json_string(out, section.name);
+        out << ",\"size\":" << section.size << ",\"offset\":" << section.offset << ",\"relocations\":" << section.relocations
+            << ",\"flags\":" << section.flags << '}';
+    }
+    out << ']';
+
+    out << ",\"imports\":";
+    write_json_strings(out, report.imports);
+    out << ",\"unsupported_beacon\":";
+    write_json_strings(out, report.unsupported_beacon);
+    out << ",\"unresolved_symbols\":";
+    write_json_strings(out, report.unresolved_symbols);
+
+    out << ",\"unsupported_relocations\":[";
+    for (size_t i = 0; i < report.unsupported_relocations.size(); i++) {
+        const inspect_relocation& relocation = report.unsupported_relocations[i];
+        out << (i ? "," : "") << "{\"section\":";
+        write_json_string(out, relocation.section);
+        out << ",\"offset\":" << relocation.offset << ",\"type\":";
+        write_json_string(out, relocation.type);
+        out << ",\"symbol\":";
+        write_json_string(out, relocation.symbol);
+        out << '}';
+    }
+    out << "]}";
+}
+
+bool inspect_directory(const std::string& directory, const uint32_t workers, std::ostream& out)
+{
+    std::vector<std::string> paths;
+    std::error_code ec;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (auto it = std::filesystem::recursive_directory_iterator(directory, std::filesystem::directory_options::skip_permission_denied, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        const std::string extension = it->path().extension().string();
+        if (it->is_regular_file(ec) && (extension == ".o" || extension == ".obj")) {
+            paths.push_back(it->path().string());
+        }
+    }
+
+    if (ec) {
+        std::cerr << "[!] ERROR, failed to walk directory: " << directory << " (" << ec.message() << ")" << std::endl;
+        return false;
+    }
+
+    std::sort(paths.begin(), paths.end());
+
+    //
+    // Objects are handed out one at a time through a shared index, results land
+    // in their own slot so the output keeps path order.
+    //
+    std::vector<inspect_report> reports(paths.size());
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next { 0 };
+    const uint32_t thread_count = static_cast<uint32_t>(std::min<size_t>(std::max(1u, workers), std::max<size_t>(1, paths.size())));
+
+    for (uint32_t i = 0; i < thread_count; i++) {
+        threads.emplace_back([&] {
+            for (size_t index = next++; index < paths.size(); index = next++) {
+                reports[index] = inspect_object(paths[index]);
+            }
+        });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::map<std::string, uint64_t> unsupported_beacon;
+    std::map<std::string, uint64_t> unsupported_relocations;
+    std::map<std::string, uint64_t> formats;
+    std::set<std::string> imports;
+    uint64_t failed = 0;
+    uint64_t ok = 0;
+
+    for (const inspect_report& report : reports) {
+        inspect_write_json(out, report);
+        out << '\n';
+
+        formats[report.format]++;
+        failed += report.error.empty() ? 0 : 1;
+        ok += report.ok() ? 1 : 0;
+        imports.insert(report.imports.begin(), report.imports.end());
+        for (const std::string& name : report.unsupported_beacon) {
+            unsupported_beacon[name]++;
+        }
+        for (const inspect_relocation& relocation : report.unsupported_relocations) {
+            unsupported_relocations[relocation.type]++;
+        }
+    }
+
+    out << "{\"summary\":{\"objects\":" << reports.size()
+        << ",\"ok\":" << ok
+        << ",\"with_issues\":" << reports.size() - ok
+        << ",\"unparsed\":" << failed
+        << ",\"formats\":";
+    write_json_counts(out, formats);
+    out << ",\"distinct_imports\":" << imports.size()
+        << ",\"unsupported_beacon\":";
+    write_json_counts(out, unsupported_beacon);
+    out << ",\"unsupported_relocation_types\":";
+    write_json_counts(out, unsupported_relocations);
+    out << ",\"workers\":" << thread_count
+        << ",\"elapsed_ms\":" << elapsed_ms << "}}\n";
+
+    return true;
+}
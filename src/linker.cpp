@@ -0,0 +1,266 @@
+#include <linker.hpp>
+#include <loader.hpp>
+#include <platform.hpp>
+#include <resolver.hpp>
+#include <util.hpp>
+#include <memory>
+#include <unordered_map>
+
+#if BOF_ELF_SUPPORT
+#include <elf_loader.hpp>
+#endif
+
+namespace {
+
+struct link_symbol {
+    void* address;
+    bool  function;
+};
+
+struct library {
+    std::string                 path;
+    link_format                 format = LINK_COFF;
+    std::vector<char>           file;           // parsed in place, kept for the symbol tables
+    void*                       image = nullptr;
+    uint64_t                    image_size = 0;
+    std::vector<section_map>    sec_map;
+    object_context              coff = {};
+#if BOF_ELF_SUPPORT
+    elf_context                 elf = {};
+#endif
+    std::vector<std::pair<uint64_t, std::string>> functions; // exported, for describing addresses
+};
+
+std::vector<std::unique_ptr<library>>& libraries()
+{
+    static std::vector<std::unique_ptr<library>> loaded;
+    return loaded;
+}
+
+std::unordered_map<std::string, link_symbol>& exports(const link_format format)
+{
+    static std::unordered_map<std::string, link_symbol> tables[2];
+    return tables[format];
+}
+
+bool export_symbol(library& lib, const std::string& name, void* address, const bool function)
+{
+    if (!exports(lib.format).try_emplace(name, link_symbol { address, function }).second) {
+        std::cerr << "[!] ERROR, " << lib.path << ": symbol is already defined by another library: " << name << std::endl;
+        return false;
+    }
+
+    if (function) {
+        lib.functions.emplace_back(PTR_TO_U64(address), name);
+    }
+    return true;
+}
+
+//
+// Libraries come from platform_alloc, read/write, and keep their plan for as long as they are loaded
+//
+bool protect_library(const std::vector<protection_range>& plan)
+{
+    for (const protection_range& range : plan) {
+        if (range.protection != PROTECT_READ_WRITE && !platform_protect(range.address, range.size, range.protection)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool map_coff_library(library& lib)
+{
+    object_context& ctx = lib.coff;
+
+    if (!object_parse(&ctx, lib.file.data(), lib.file.size())) {
+        std::cerr << "[!] ERROR, Malformed or unsupported COFF object: " << lib.path << std::endl;
+        return false;
+    }
+
+    lib.image_size = object_virtual_size(&ctx);
+    if ((lib.image = platform_alloc(lib.image_size)) == nullptr) {
+        return false;
+    }
+
+    lib.sec_map.assign(ctx.section_count, section_map {});
+    ctx.sec_map = lib.sec_map.data();
+    object_map_sections(&ctx, lib.image);
+
+    for (size_t i = 0; i < ctx.symbol_count; i++) {
+        const object_symbol symbol = object_symbol_at(&ctx, i);
+        i += symbol.aux_count;
+
+        if (symbol.storage_class != IMAGE_SYM_CLASS_EXTERNAL || symbol.section <= 0) {
+            continue;
+        }
+
+        const char* name = object_symbol_name(&ctx, symbol);
+        void* address = reinterpret_cast<void*>(PTR_TO_U64(ctx.sec_map[symbol.section - 1].base) + symbol.value);
+        const std::string exported = symbol.short_name != nullptr ? std::string(name, strnlen(name, IMAGE_SIZEOF_SHORT_NAME)) : std::string(name);
+
+        if (!export_symbol(lib, exported, address, ISFCN(symbol.type))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool relocate_coff_library(library& lib)
+{
+    object_context& ctx = lib.coff;
+
+    if (!process_object_sections(&ctx, resolve_object_symbol)) {
+        const std::string error = object_fixup_error_string(&ctx);
+        std::cerr << "[!] ERROR, Failed to relocate library: " << lib.path << (error.empty() ? "" : ": " + error) << std::endl;
+        return false;
+    }
+
+    return protect_library(object_protection_plan(&ctx, lib.image, lib.image_size));
+}
+
+#if BOF_ELF_SUPPORT
+bool map_elf_library(library& lib)
+{
+    elf_context& ctx = lib.elf;
+
+    if (!elf_parse(&ctx, lib.file.data(), lib.file.size())) {
+        std::cerr << "[!] ERROR, Malformed or unsupported ELF object: " << lib.path << std::endl;
+        return false;
+    }
+
+    lib.image_size = elf_virtual_size(&ctx);
+    if ((lib.image = platform_alloc(lib.image_size)) == nullptr) {
+        return false;
+    }
+
+    lib.sec_map.assign(ctx.header->e_shnum, section_map {});
+    ctx.sec_map = lib.sec_map.data();
+    elf_map_sections(&ctx, lib.image);
+
+    for (size_t i = 0; i < ctx.sym_count; i++) {
+        const Elf64_Sym& symbol = ctx.sym_table[i];
+        const uint32_t type = ELF64_ST_TYPE(symbol.st_info);
+
+        if (ELF64_ST_BIND(symbol.st_info) == STB_LOCAL || symbol.st_shndx == SHN_UNDEF
+            || symbol.st_shndx >= ctx.header->e_shnum || ctx.sec_map[symbol.st_shndx].base == nullptr
+            || (type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE)) {
+            continue;
+        }
+
+        void* address = reinterpret_cast<void*>(PTR_TO_U64(ctx.sec_map[symbol.st_shndx].base) + symbol.st_value);
+        if (!export_symbol(lib, elf_symbol_name(&ctx, &symbol), address, type == STT_FUNC)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool relocate_elf_library(library& lib)
+{
+    elf_context& ctx = lib.elf;
+
+    if (!elf_process_relocations(&ctx, resolve_elf_symbol)) {
+        std::cerr << "[!] ERROR, Failed to relocate library: " << lib.path << std::endl;
+        return false;
+    }
+
+    return protect_library(elf_protection_plan(&ctx, lib.image, lib.image_size));
+}
+#endif
+
+} // namespace
+
+bool link_load_libraries(const std::vector<std::string>& paths)
+{
+    std::vector<library*> loading;
+
+    //
+    // Map every library and publish its exports first, so relocations can
+    // refer to any library of the set.
+    //
+    for (const std::string& path : paths) {
+        auto lib = std::make_unique<library>();
+        auto file = read_from_disk(path);
+        if (!file) {
+            return false;
+        }
+
+        lib->path = path;
+        lib->file = std::move(*file);
+        lib->format = lib->file.size() >= 4 && memcmp(lib->file.data(), "\x7f""ELF", 4) == 0 ? LINK_ELF : LINK_COFF;
+
+        if (lib->format == LINK_ELF) {
+#if BOF_ELF_SUPPORT
+            if (!map_elf_library(*lib)) {
+                return false;
+            }
+#else
+            std::cerr << "[!] ERROR, ELF objects can only be loaded on x86-64 Linux: " << path << std::endl;
+            return false;
+#endif
+        } else if (!map_coff_library(*lib)) {
+            return false;
+        }
+
+        loading.push_back(lib.get());
+        libraries().push_back(std::move(lib));
+    }
+
+    for (library* lib : loading) {
+#if BOF_ELF_SUPPORT
+        const bool relocated = lib->format == LINK_ELF ? relocate_elf_library(*lib) : relocate_coff_library(*lib);
+#else
+        const bool relocated = relocate_coff_library(*lib);
+#endif
+        if (!relocated) {
+            return false;
+        }
+
+        if (!log_quiet()) {
+            std::cout << "[+] Loaded library: " << lib->path << " (" << lib->functions.size() << " exported functions)" << std::endl;
+        }
+    }
+
+    return true;
+}
+
+void* link_find_symbol(const link_format format, const char* name)
+{
+    const auto& table = exports(format);
+    const auto found = table.find(name);
+    return found != table.end() ? found->second.address : nullptr;
+}
+
+size_t link_library_count()
+{
+    return libraries().size();
+}
+
+bool link_describe_address(const uint64_t address, std::string* name, uint64_t* offset)
+{
+    for (const auto& lib : libraries()) {
+        if (address < PTR_TO_U64(lib->image) || address >= PTR_TO_U64(lib->image) + lib->image_size) {
+            continue;
+        }
+
+        const std::pair<uint64_t, std::string>* nearest = nullptr;
+        for (const auto& function : lib->functions) {
+            if (function.first <= address && (nearest == nullptr || function.first > nearest->first)) {
+                nearest = &function;
+            }
+        }
+
+        if (nearest == nullptr) {
+            return false;
+        }
+
+        *name = nearest->second;
+        *offset = address - nearest->first;
+        return true;
+    }
+
+    return false;
+}
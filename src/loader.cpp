@@ -0,0 +1,829 @@
+#include <loader.hpp>
+#include <parallel.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+//
+// {D1BAA1C7-BAEE-4ba9-AF20-FAF66AA4DCB8}, as it is stored in big object headers
+//
+const BYTE big_object_class_id[16] = {
+    0xC7, 0xA1, 0xBA, 0xD1, 0xEE, 0xBA, 0xA9, 0x4B, 0xAF, 0x20, 0xFA, 0xF6, 0x6A, 0xA4, 0xDC, 0xB8,
+};
+
+bool is_big_object(const void* pobject, const size_t object_size)
+{
+    const auto* header = static_cast<const ANON_OBJECT_HEADER_BIGOBJ*>(pobject);
+
+    return object_size >= sizeof(ANON_OBJECT_HEADER_BIGOBJ)
+        && header->Sig1 == IMAGE_FILE_MACHINE_UNKNOWN && header->Sig2 == 0xFFFF && header->Version >= 2
+        && memcmp(&header->ClassID, big_object_class_id, sizeof(big_object_class_id)) == 0;
+}
+
+} // namespace
+
+bool object_parse(object_context* ctx, void* pobject, const size_t object_size)
+{
+    uint64_t headers_size   = 0;
+    uint64_t symbol_table   = 0;
+    uint64_t string_table   = 0;
+    uint32_t string_size    = 0;
+    uint32_t machine        = 0;
+
+    if (ctx == nullptr || pobject == nullptr || object_size < sizeof(IMAGE_FILE_HEADER)) {
+        return false;
+    }
+
+    ctx->base = PTR_TO_U64(pobject);
+    ctx->size = object_size;
+
+    //
+    // Everything after the headers is the same in both formats, apart from
+    // the size of a symbol.
+    //
+    if (is_big_object(pobject, object_size)) {
+        const auto* header = static_cast<const ANON_OBJECT_HEADER_BIGOBJ*>(pobject);
+        machine             = header->Machine;
+        headers_size        = sizeof(ANON_OBJECT_HEADER_BIGOBJ);
+        symbol_table        = header->PointerToSymbolTable;
+        ctx->section_count  = header->NumberOfSections;
+        ctx->symbol_count   = header->NumberOfSymbols;
+        ctx->symbol_size    = IMAGE_SIZEOF_SYMBOL_EX;
+    } else {
+        const auto* header = static_cast<const IMAGE_FILE_HEADER*>(pobject);
+        machine             = header->Machine;
+        headers_size        = sizeof(IMAGE_FILE_HEADER);
+        symbol_table        = header->PointerToSymbolTable;
+        ctx->section_count  = header->NumberOfSections;
+        ctx->symbol_count   = header->NumberOfSymbols;
+        ctx->symbol_size    = IMAGE_SIZEOF_SYMBOL;
+    }
+
+    if (machine != IMAGE_FILE_MACHINE_AMD64) { // do not support 32 bit
+        return false;
+    }
+
+    ctx->sections  = reinterpret_cast<PIMAGE_SECTION_HEADER>(ctx->base + headers_size);
+    ctx->sym_table = reinterpret_cast<BYTE*>(ctx->base + symbol_table);
+
+    //
+    // The section table, symbol table and the string table's size field
+    // all have to lie inside of the file.
+    //
+    if (headers_size + INT_TO_U64(ctx->section_count) * sizeof(IMAGE_SECTION_HEADER) > object_size) {
+        return false;
+    }
+
+    string_table = symbol_table + INT_TO_U64(ctx->symbol_count) * ctx->symbol_size;
+    if (string_table + sizeof(uint32_t) > object_size) {
+        return false;
+    }
+
+    memcpy(&string_size, reinterpret_cast<void*>(ctx->base + string_table), sizeof(uint32_t));
+    if (string_table + string_size > object_size) {
+        return false;
+    }
+    ctx->str_table = reinterpret_cast<const char*>(ctx->base + string_table);
+
+    for (size_t i = 0; i < ctx->section_count; i++) {
+        const IMAGE_SECTION_HEADER& section = ctx->sections[i];
+        uint32_t count = 0;
+
+        if (section.PointerToRawData != 0 && INT_TO_U64(section.PointerToRawData) + section.SizeOfRawData > object_size) {
+            return false;
+        }
+
+        //
+        // the first entry may hold the count, see object_section_relocations
+        //
+        if (section.NumberOfRelocations != 0 && INT_TO_U64(section.PointerToRelocations) + sizeof(IMAGE_RELOCATION) > object_size) {
+            return false;
+        }
+
+        const PIMAGE_RELOCATION relocation = object_section_relocations(ctx, section, &count);
+        if (PTR_TO_U64(relocation) - ctx->base + INT_TO_U64(count) * sizeof(IMAGE_RELOCATION) > object_size) {
+            return false;
+        }
+
+        for (size_t j = 0; j < count; j++) {
+            if (relocation[j].SymbolTableIndex >= ctx->symbol_count) {
+                return false;
+            }
+        }
+    }
+
+    //
+    // Long symbol names are offsets into the string table.
+    //
+    for (size_t i = 0; i < ctx->symbol_count; i++) {
+        const object_symbol symbol = object_symbol_at(ctx, i);
+        if (symbol.short_name == nullptr && symbol.name_offset >= string_size) {
+            return false;
+        }
+
+        if (symbol.section > 0 && INT_TO_U64(symbol.section) > ctx->section_count) {
+            return false;
+        }
+
+        i += symbol.aux_count;
+    }
+
+    return true;
+}
+
+char* object_symbol_name(const object_context* ctx, const object_symbol& symbol)
+{
+    if (symbol.short_name != nullptr) { // short name (<= 8 bytes)
+        return reinterpret_cast<char*>(const_cast<BYTE*>(symbol.short_name));
+    }
+
+    return const_cast<char*>(ctx->str_table) + symbol.name_offset;
+}
+
+uint64_t object_virtual_size(object_context* ctx)
+{
+    PIMAGE_RELOCATION obj_rel  = nullptr;
+    char* symbol_name          = nullptr;
+    uint32_t count             = 0;
+    uint64_t total_size        = 0;
+
+    //
+    // Add up each page aligned section size.
+    //
+    for (size_t i = 0; i < ctx->section_count; i++) {
+        total_size += PAGE_ALIGN(ctx->sections[i].SizeOfRawData);
+    }
+
+    for (size_t i = 0; i < ctx->section_count; i++) {
+        obj_rel = object_section_relocations(ctx, ctx->sections[i], &count);
+        for (size_t j = 0; j < count; j++, obj_rel++) {
+            const object_symbol obj_sym = object_symbol_at(ctx, obj_rel->SymbolTableIndex);
+            symbol_name = object_symbol_name(ctx, obj_sym);
+
+            //
+            // Only if the symbol is external: one slot per import, and an address
+            // slot plus a call stub per reference into another object.
+            //
+            if (strncmp("__imp_", symbol_name, 6) == 0) {
+                total_size += sizeof(void*);
+            } else if (obj_sym.section == IMAGE_SYM_UNDEFINED) {
+                total_size += 2 * sizeof(void*);
+            }
+        }
+    }
+
+    return PAGE_ALIGN(total_size); // align the size to a page boundary on return
+}
+
+namespace {
+
+//
+// Work units of a parallel load: sections are copied in chunks of at most
+// this many bytes and relocated in ranges of at most this many relocations,
+// so one huge section still spreads over the pool.
+//
+constexpr uint64_t parallel_copy_chunk      = 1024 * 1024;
+constexpr uint32_t parallel_relocation_range = 8192;
+
+struct copy_chunk {
+    void*       destination;
+    const void* source;
+    uint64_t    size;
+};
+
+void copy_sections_parallel(const object_context* ctx)
+{
+    std::vector<copy_chunk> chunks;
+
+    for (size_t i = 0; i < ctx->section_count; i++) {
+        if (ctx->sections[i].PointerToRawData == 0) {
+            continue; // nothing in the file, stays zero
+        }
+
+        const auto* source = reinterpret_cast<const char*>(ctx->base + ctx->sections[i].PointerToRawData);
+        auto* destination  = static_cast<char*>(ctx->sec_map[i].base);
+
+        for (uint64_t offset = 0; offset < ctx->sec_map[i].size; offset += parallel_copy_chunk) {
+            chunks.push_back({ destination + offset, source + offset, std::min(parallel_copy_chunk, ctx->sec_map[i].size - offset) });
+        }
+    }
+
+    parallel_for(chunks.size(), [&](const size_t i) {
+        memcpy(chunks[i].destination, chunks[i].source, chunks[i].size);
+    });
+}
+
+} // namespace
+
+void object_map_sections(object_context* ctx, void* virtual_addr)
+{
+    void* section_base = virtual_addr;
+    uint64_t section_size = 0;
+    uint64_t total_size = 0;
+
+    //
+    // copy over sections from the object file. ctx->sec_map must already
+    // hold section_count entries.
+    //
+    for (size_t i = 0; i < ctx->section_count; i++) {
+        total_size += ctx->sections[i].SizeOfRawData;
+    }
+
+    const bool parallel = parallel_load_threads() > 1 && total_size >= parallel_load_min_bytes;
+
+    for (size_t i = 0; i < ctx->section_count; i++) {
+
+        section_size = ctx->sections[i].SizeOfRawData;
+        ctx->sec_map[i].size = section_size;
+        ctx->sec_map[i].base = section_base;
+
+        //
+        // Sections without raw data (.bss) stay zero, the image is zeroed already
+        //
+        if (!parallel && ctx->sections[i].PointerToRawData != 0) {
+            memcpy( // copy over the section
+                section_base,
+                reinterpret_cast<void*>(ctx->base + ctx->sections[i].PointerToRawData),
+                section_size);
+        }
+
+        section_base = reinterpret_cast<void*>(PAGE_ALIGN(PTR_TO_U64(section_base) + section_size));
+    }
+
+    if (parallel) {
+        copy_sections_parallel(ctx);
+    }
+
+    //
+    // import slots live right after the last section
+    //
+    ctx->sym_map = static_cast<PVOID*>(section_base);
+}
+
+namespace {
+
+enum fixup_kind : uint8_t {
+    FIXUP_UNSUPPORTED,
+    FIXUP_NONE,             // IMAGE_REL_AMD64_ABSOLUTE, ignored
+    FIXUP_ADDRESS,          // S + A
+    FIXUP_IMAGE_RELATIVE,   // S + A - image base
+    FIXUP_PC_RELATIVE,      // S + A - (P + 4 + bias)
+    FIXUP_SECTION_INDEX,    // section number of S
+    FIXUP_SECTION_RELATIVE, // S + A - base of the section of S
+};
+
+struct relocation_info {
+    const char* name;
+    fixup_kind  kind;
+    uint8_t     width;      // bytes patched
+    uint8_t     bias;       // REL32_n: bytes between the field and the next instruction
+    bool        is_signed;  // range of the result
+};
+
+//
+// Indexed by IMAGE_REL_AMD64_* type.
+//
+const relocation_info relocation_table[] = {
+    { "ABSOLUTE", FIXUP_NONE,             0, 0, false },
+    { "ADDR64",   FIXUP_ADDRESS,          8, 0, false },
+    { "ADDR32",   FIXUP_ADDRESS,          4, 0, false },
+    { "ADDR32NB", FIXUP_IMAGE_RELATIVE,   4, 0, false },
+    { "REL32",    FIXUP_PC_RELATIVE,      4, 0, true  },
+    { "REL32_1",  FIXUP_PC_RELATIVE,      4, 1, true  },
+    { "REL32_2",  FIXUP_PC_RELATIVE,      4, 2, true  },
+    { "REL32_3",  FIXUP_PC_RELATIVE,      4, 3, true  },
+    { "REL32_4",  FIXUP_PC_RELATIVE,      4, 4, true  },
+    { "REL32_5",  FIXUP_PC_RELATIVE,      4, 5, true  },
+    { "SECTION",  FIXUP_SECTION_INDEX,    2, 0, false },
+    { "SECREL",   FIXUP_SECTION_RELATIVE, 4, 0, false },
+    { "SECREL7",  FIXUP_SECTION_RELATIVE, 1, 0, false },
+    { "TOKEN",    FIXUP_UNSUPPORTED,      0, 0, false }, // CLR tokens
+    { "SREL32",   FIXUP_UNSUPPORTED,      0, 0, false }, // span relocations are for the linker
+    { "PAIR",     FIXUP_UNSUPPORTED,      0, 0, false },
+    { "SSPAN32",  FIXUP_UNSUPPORTED,      0, 0, false },
+};
+
+const relocation_info* relocation_lookup(const uint32_t type)
+{
+    return type < sizeof(relocation_table) / sizeof(relocation_table[0]) ? &relocation_table[type] : nullptr;
+}
+
+bool fail_fixup(object_context* ctx, const uint32_t error, const uint32_t type, const size_t section, const uint32_t offset)
+{
+    ctx->fixup_error = { error, type, static_cast<uint32_t>(section + 1), offset };
+    return false;
+}
+
+} // namespace
+
+const char* object_relocation_name(const uint32_t type)
+{
+    const relocation_info* info = relocation_lookup(type);
+    return info != nullptr ? info->name : "UNKNOWN";
+}
+
+bool object_relocation_supported(const uint32_t type)
+{
+    const relocation_info* info = relocation_lookup(type);
+    return info != nullptr && info->kind != FIXUP_UNSUPPORTED;
+}
+
+bool object_apply_fixup(const object_fixup& fixup, const uint64_t image_base)
+{
+    const relocation_info* info = relocation_lookup(fixup.type);
+    auto* field = reinterpret_cast<uint8_t*>(fixup.target);
+    int64_t value = 0;
+
+    if (info == nullptr || info->kind == FIXUP_UNSUPPORTED) {
+        return false;
+    }
+
+    //
+    // The addend is whatever the field already holds
+    //
+    int64_t addend = 0;
+    if (info->width == 8) {
+        memcpy(&addend, field, sizeof(int64_t));
+    } else if (info->width == 4) {
+        uint32_t stored = 0;
+        memcpy(&stored, field, sizeof(stored));
+        addend = info->is_signed ? static_cast<int32_t>(stored) : static_cast<int64_t>(stored);
+    } else if (info->width == 1) {
+        addend = *field & 0x7f;
+    }
+
+    switch (info->kind) {
+    case FIXUP_NONE:
+        return true;
+    case FIXUP_ADDRESS:
+        value = static_cast<int64_t>(fixup.symbol) + addend;
+        break;
+    case FIXUP_IMAGE_RELATIVE:
+        value = static_cast<int64_t>(fixup.symbol - image_base) + addend;
+        break;
+    case FIXUP_PC_RELATIVE:
+        value = static_cast<int64_t>(fixup.symbol - (fixup.target + sizeof(uint32_t) + info->bias)) + addend;
+        break;
+    case FIXUP_SECTION_INDEX:
+        if (fixup.section == 0) {
+            return false;
+        }
+        value = fixup.section;
+        break;
+    case FIXUP_SECTION_RELATIVE:
+        if (fixup.section_base == 0) {
+            return false;
+        }
+        value = static_cast<int64_t>(fixup.symbol - fixup.section_base) + addend;
+        break;
+    default:
+        return false;
+    }
+
+    //
+    // Overflow checks, 64 bit fields always fit
+    //
+    switch (info->width) {
+    case 8:
+        memcpy(field, &value, sizeof(value));
+        return true;
+    case 4:
+        if (info->is_signed ? value != static_cast<int32_t>(value) : (value < 0 || value > UINT32_MAX)) {
+            return false;
+        }
+        memcpy(field, &value, sizeof(uint32_t)); // little endian
+        return true;
+    case 2:
+        if (value < 0 || value > UINT16_MAX) {
+            return false;
+        }
+        memcpy(field, &value, sizeof(uint16_t));
+        return true;
+    case 1:
+        if (value < 0 || value > 0x7f) {
+            return false;
+        }
+        *field = static_cast<uint8_t>((*field & 0x80) | value);
+        return true;
+    default:
+        return false;
+    }
+}
+
+size_t object_apply_fixups(object_fixup* fixups, const size_t count, const uint64_t image_base)
+{
+    //
+    // Patch in address order, one forward sweep over the image. Relocations
+    // are mostly sorted per section already.
+    //
+    const auto by_target = [](const object_fixup& a, const object_fixup& b) { return a.target < b.target; };
+    if (!std::is_sorted(fixups, fixups + count, by_target)) {
+        std::sort(fixups, fixups + count, by_target);
+    }
+
+    if (parallel_load_threads() <= 1 || count < parallel_load_min_relocations) {
+        for (size_t i = 0; i < count; i++) {
+            if (!object_apply_fixup(fixups[i], image_base)) {
+                return i;
+            }
+        }
+        return count;
+    }
+
+    //
+    // Slices of the sorted fixups, cut where no field can straddle the cut.
+    // Each slice stops at its first failure; slices after the first failed
+    // fixup may still have been patched, the load fails either way.
+    //
+    std::vector<size_t> cuts = { 0 };
+    for (size_t cut = parallel_relocation_range; cut < count; cut += parallel_relocation_range) {
+        while (cut < count && fixups[cut].target < fixups[cut - 1].target + sizeof(uint64_t)) {
+            cut++;
+        }
+        if (cut < count) {
+            cuts.push_back(cut);
+        }
+    }
+    cuts.push_back(count);
+
+    std::vector<size_t> failed(cuts.size() - 1, count);
+    parallel_for(failed.size(), [&](const size_t slice) {
+        for (size_t i = cuts[slice]; i < cuts[slice + 1]; i++) {
+            if (!object_apply_fixup(fixups[i], image_base)) {
+                failed[slice] = i;
+                return;
+            }
+        }
+    });
+
+    return *std::min_element(failed.begin(), failed.end());
+}
+
+std::string object_fixup_error_string(const object_context* ctx)
+{
+    const object_fixup_error& error = ctx->fixup_error;
+    const char* reason = nullptr;
+
+    switch (error.status) {
+    case OBJECT_FIXUP_UNSUPPORTED:   reason = "unsupported relocation"; break;
+    case OBJECT_FIXUP_OUT_OF_BOUNDS: reason = "relocation outside of its section"; break;
+    case OBJECT_FIXUP_BAD_SYMBOL:    reason = "relocation against a symbol it cannot refer to"; break;
+    case OBJECT_FIXUP_OVERFLOW:      reason = "relocation overflow"; break;
+    default:                         return {};
+    }
+
+    char offset[16];
+    snprintf(offset, sizeof(offset), "0x%x", error.offset);
+
+    return std::string(reason) + " IMAGE_REL_AMD64_" + object_relocation_name(error.type)
+        + " (" + std::to_string(error.type) + ") in section " + std::to_string(error.section) + " at " + offset;
+}
+
+//
+// Address a relocation against a symbol defined by another object refers to.
+// Calls that are out of reach of a 32 bit displacement go through a
+// "jmp [rip - 14]" stub in the second of the two slots, right after the
+// address in the first. Data has to be in reach.
+//
+uint64_t object_link_target(const uint32_t type, const void* needs_relocating, const object_symbol& symbol, void* resolved, PVOID* slots)
+{
+    const relocation_info* info = relocation_lookup(type);
+    int32_t addend = 0;
+
+    if (info == nullptr || info->kind != FIXUP_PC_RELATIVE || !ISFCN(symbol.type)) {
+        return PTR_TO_U64(resolved);
+    }
+
+    memcpy(&addend, needs_relocating, sizeof(addend));
+
+    const uint64_t next_instruction = PTR_TO_U64(needs_relocating) + sizeof(uint32_t) + info->bias;
+    const int64_t displacement = static_cast<int64_t>(PTR_TO_U64(resolved) - next_instruction) + addend;
+
+    if (displacement == static_cast<int32_t>(displacement)) {
+        return PTR_TO_U64(resolved);
+    }
+
+    slots[0] = resolved;
+    memcpy(&slots[1], "\xFF\x25\xF2\xFF\xFF\xFF\xCC\xCC", sizeof(void*));
+    return PTR_TO_U64(&slots[1]);
+}
+
+namespace {
+
+//
+// Relocations [first, first + count) of one section, turned into the fixups
+// starting at fixups[fixup].
+//
+struct relocation_range {
+    uint32_t section;
+    uint32_t first;
+    uint32_t count;
+    size_t   fixup;
+};
+
+//
+// A fixup against an import or a symbol of another object, left for the
+// loading thread to resolve.
+//
+struct external_fixup {
+    size_t   fixup;
+    uint32_t symbol;    // symbol table index
+};
+
+//
+// What prepare_fixups leaves behind for one range: its external fixups in
+// relocation order, and where it stopped if it failed.
+//
+struct prepared_range {
+    std::vector<external_fixup> externals;
+    size_t                      error_at;   // fixup index, SIZE_MAX if none failed
+    object_fixup_error          error;
+};
+
+//
+// Turns a range of relocations into fixups without resolving anything, so
+// ranges can be prepared on any thread.
+//
+void prepare_fixups(const object_context* ctx, const relocation_range& range, object_fixup* fixups, prepared_range& prepared)
+{
+    uint32_t count = 0;
+    const PIMAGE_RELOCATION relocations = object_section_relocations(ctx, ctx->sections[range.section], &count);
+    const section_map& section = ctx->sec_map[range.section];
+
+    prepared.externals.clear();
+    prepared.error_at = SIZE_MAX;
+
+    for (uint32_t j = range.first; j < range.first + range.count; j++) {
+        const IMAGE_RELOCATION& relocation = relocations[j];
+        const object_symbol symbol = object_symbol_at(ctx, relocation.SymbolTableIndex);
+        const char* symbol_name = object_symbol_name(ctx, symbol);
+        const size_t index = range.fixup + (j - range.first);
+        object_fixup& fixup = fixups[index];
+
+        const auto fail = [&](const uint32_t status) {
+            prepared.error_at = index;
+            prepared.error = { status, relocation.Type, range.section + 1, relocation.VirtualAddress };
+        };
+
+        if (!object_relocation_supported(relocation.Type)) {
+            return fail(OBJECT_FIXUP_UNSUPPORTED);
+        }
+
+        //
+        // RVA for the relocation needs to be applied to the base of the section.
+        //
+        if (INT_TO_U64(relocation.VirtualAddress) + relocation_table[relocation.Type].width > section.size) {
+            return fail(OBJECT_FIXUP_OUT_OF_BOUNDS);
+        }
+
+        fixup = {};
+        fixup.target = PTR_TO_U64(section.base) + relocation.VirtualAddress;
+        fixup.type   = static_cast<uint16_t>(relocation.Type);
+
+        //
+        // imports refer to their slot, which holds the resolved address. Symbols
+        // defined by another object, e.g. a resident library, get a slot too.
+        //
+        if (strncmp("__imp_", symbol_name, 6) == 0 || symbol.section == IMAGE_SYM_UNDEFINED) {
+            prepared.externals.push_back({ index, relocation.SymbolTableIndex });
+        }
+
+        else if (symbol.section == IMAGE_SYM_ABSOLUTE) {
+            fixup.symbol = symbol.value;
+        }
+
+        else if (symbol.section > 0) {
+            fixup.section_base = PTR_TO_U64(ctx->sec_map[symbol.section - 1].base);
+            fixup.symbol       = fixup.section_base + symbol.value;
+            fixup.section      = static_cast<uint32_t>(symbol.section);
+        }
+
+        else {
+            return fail(OBJECT_FIXUP_BAD_SYMBOL);
+        }
+
+        //
+        // section relative forms need a symbol inside of a section of this object
+        //
+        const fixup_kind kind = relocation_table[relocation.Type].kind;
+        if ((kind == FIXUP_SECTION_INDEX || kind == FIXUP_SECTION_RELATIVE) && fixup.section == 0) {
+            return fail(OBJECT_FIXUP_BAD_SYMBOL);
+        }
+    }
+}
+
+} // namespace
+
+bool process_object_sections(object_context* ctx, symbol_resolver resolve)
+{
+    void* resolved_addr            = nullptr;
+    uint32_t func_index            = 0;
+    uint32_t count                 = 0;
+    size_t fixup_count             = 0;
+    char* symbol_name              = nullptr;
+
+    thread_local std::vector<object_fixup> fixups; // reused by every load on this thread
+    thread_local std::vector<relocation_range> ranges;
+    thread_local std::vector<prepared_range> prepared;
+    ranges.clear();
+    ctx->fixup_error = {};
+    ctx->call_stubs  = 0;
+
+    //---------------------------------------------------//
+
+    //
+    // Split the relocations into ranges, one per section unless the load is
+    // big enough to spread over the helper threads.
+    //
+    for (uint32_t i = 0; i < ctx->section_count; i++) {
+        object_section_relocations(ctx, ctx->sections[i], &count);
+        fixup_count += count;
+    }
+
+    const bool parallel = parallel_load_threads() > 1 && fixup_count >= parallel_load_min_relocations;
+    const uint32_t range_size = parallel ? parallel_relocation_range : UINT32_MAX;
+
+    size_t fixup = 0;
+    for (uint32_t i = 0; i < ctx->section_count; i++) {
+        object_section_relocations(ctx, ctx->sections[i], &count);
+        for (uint32_t first = 0; first < count; first += range_size) {
+            const uint32_t length = std::min(range_size, count - first);
+            ranges.push_back({ i, first, length, fixup });
+            fixup += length;
+        }
+    }
+
+    fixups.resize(fixup_count);
+    if (prepared.size() < ranges.size()) {
+        prepared.resize(ranges.size());
+    }
+
+    //
+    // First turn every relocation into a fixup, then patch them all in one sweep.
+    //
+    if (parallel) {
+        //
+        // the helpers have thread_locals of their own, hand them this thread's
+        //
+        const relocation_range* load_ranges = ranges.data();
+        object_fixup* load_fixups           = fixups.data();
+        prepared_range* load_prepared       = prepared.data();
+
+        parallel_for(ranges.size(), [=](const size_t i) { prepare_fixups(ctx, load_ranges[i], load_fixups, load_prepared[i]); });
+    } else {
+        for (size_t i = 0; i < ranges.size(); i++) {
+            prepare_fixups(ctx, ranges[i], fixups.data(), prepared[i]);
+        }
+    }
+
+    //
+    // Resolve on this thread, in relocation order, up to the first relocation
+    // that failed. Import slots are handed out in that order too.
+    //
+    for (size_t i = 0; i < ranges.size(); i++) {
+        for (const external_fixup& external : prepared[i].externals) {
+            const object_symbol symbol = object_symbol_at(ctx, external.symbol);
+            object_fixup& fixup = fixups[external.fixup];
+            symbol_name = object_symbol_name(ctx, symbol);
+
+            if (strncmp("__imp_", symbol_name, 6) == 0) {
+                if ((resolved_addr = resolve(symbol_name)) == nullptr) {
+                    return false;
+                }
+
+                ctx->sym_map[func_index] = resolved_addr;
+                fixup.symbol = PTR_TO_U64(&ctx->sym_map[func_index]);
+                func_index++;
+                continue;
+            }
+
+            char short_name[IMAGE_SIZEOF_SHORT_NAME + 1] = { 0 };
+            if (symbol.short_name != nullptr) { // eight character names are not terminated
+                memcpy(short_name, symbol.short_name, IMAGE_SIZEOF_SHORT_NAME);
+                symbol_name = short_name;
+            }
+
+            if ((resolved_addr = resolve(symbol_name)) == nullptr) {
+                return false;
+            }
+
+            fixup.symbol = object_link_target(fixup.type, reinterpret_cast<void*>(fixup.target), symbol, resolved_addr, &ctx->sym_map[func_index]);
+            if (fixup.symbol == PTR_TO_U64(&ctx->sym_map[func_index + 1])) {
+                ctx->call_stubs++;
+            }
+            func_index += 2;
+        }
+
+        if (prepared[i].error_at != SIZE_MAX) {
+            ctx->fixup_error = prepared[i].error;
+            return false;
+        }
+    }
+
+    //
+    // Sections are laid out from the first one on, that is the image base
+    // image relative relocations count from.
+    //
+    const uint64_t image_base = ctx->section_count != 0 ? PTR_TO_U64(ctx->sec_map[0].base) : 0;
+    ctx->import_slots = func_index;
+
+    const size_t applied = object_apply_fixups(fixups.data(), fixups.size(), image_base);
+
+    if (applied != fixups.size()) {
+        const object_fixup& failed = fixups[applied];
+
+        for (size_t i = 0; i < ctx->section_count; i++) {
+            const uint64_t base = PTR_TO_U64(ctx->sec_map[i].base);
+            if (failed.target >= base && failed.target < base + ctx->sec_map[i].size) {
+                return fail_fixup(ctx, OBJECT_FIXUP_OVERFLOW, failed.type, i, static_cast<uint32_t>(failed.target - base));
+            }
+        }
+        return fail_fixup(ctx, OBJECT_FIXUP_OVERFLOW, failed.type, 0, 0);
+    }
+
+    return true;
+}
+
+void protection_plan_add(std::vector<protection_range>& plan, void* address, const uint64_t size, const page_protection protection)
+{
+    if (size == 0) {
+        return;
+    }
+
+    if (!plan.empty() && plan.back().protection == protection
+        && PTR_TO_U64(plan.back().address) + plan.back().size == PTR_TO_U64(address)) {
+        plan.back().size += size;
+        return;
+    }
+
+    plan.push_back({ address, size, protection });
+}
+
+std::vector<protection_range> object_protection_plan(const object_context* ctx, void* image, const uint64_t image_size)
+{
+    std::vector<protection_range> plan;
+
+    for (size_t i = 0; i < ctx->section_count; i++) {
+        const DWORD characteristics = ctx->sections[i].Characteristics;
+        page_protection protection = PROTECT_READ_ONLY;
+
+        if (characteristics & (IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_CNT_CODE)) {
+            protection = PROTECT_READ_EXECUTE;
+        } else if (characteristics & IMAGE_SCN_MEM_WRITE) {
+            protection = PROTECT_READ_WRITE;
+        }
+
+        protection_plan_add(plan, ctx->sec_map[i].base, PAGE_ALIGN(ctx->sec_map[i].size), protection);
+    }
+
+    //
+    // The import slots and the padding after them, up to the end of the image
+    //
+    const uint64_t image_end = PTR_TO_U64(image) + image_size;
+    if (PTR_TO_U64(ctx->sym_map) < image_end) {
+        protection_plan_add(plan, ctx->sym_map, image_end - PTR_TO_U64(ctx->sym_map),
+            ctx->call_stubs != 0 ? PROTECT_READ_EXECUTE : PROTECT_READ_ONLY);
+    }
+
+    return plan;
+}
+
+bool object_nearest_symbol(const object_context* ctx, const uint64_t address, object_symbol* nearest, uint64_t* offset)
+{
+    bool found            = false;
+    uint64_t nearest_addr = 0;
+
+    for (size_t i = 0; i < ctx->symbol_count; i++) {
+        const object_symbol symbol = object_symbol_at(ctx, i);
+        i += symbol.aux_count;
+
+        if (symbol.section <= 0 || ctx->sec_map[symbol.section - 1].base == nullptr) {
+            continue;
+        }
+
+        const section_map& section = ctx->sec_map[symbol.section - 1];
+        const uint64_t symbol_addr = PTR_TO_U64(section.base) + symbol.value;
+
+        if (address < PTR_TO_U64(section.base) || address >= PTR_TO_U64(section.base) + section.size || symbol_addr > address) {
+            continue;
+        }
+
+        //
+        // Section symbols sit at offset 0, prefer anything more specific at the same address.
+        //
+        if (!found || symbol_addr > nearest_addr
+            || (symbol_addr == nearest_addr && nearest->aux_count != 0)) {
+            *nearest = symbol;
+            nearest_addr = symbol_addr;
+            found = true;
+        }
+    }
+
+    if (found && offset != nullptr) {
+        *offset = address - nearest_addr;
+    }
+
+    return found;
+}
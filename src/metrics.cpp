@@ -0,0 +1,388 @@
+#include <metrics.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <csignal>
+
+namespace {
+
+//
+// Upper bounds of the histogram buckets in milliseconds, the last bucket is +Inf
+//
+const double bucket_bounds_ms[] = { 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000 };
+constexpr size_t bucket_count = sizeof(bucket_bounds_ms) / sizeof(bucket_bounds_ms[0]) + 1;
+
+struct counter_info {
+    const char* name;
+    const char* labels;
+    const char* help;
+};
+
+const counter_info counter_infos[METRIC_COUNTER_COUNT] = {
+    { "bof_jobs_total",                     "status=\"succeeded\"", "Jobs by outcome." },
+    { "bof_jobs_total",                     "status=\"failed\"",    "Jobs by outcome." },
+    { "bof_jobs_total",                     "status=\"timed_out\"", "Jobs by outcome." },
+    { "bof_output_bytes_total",             "",                     "Beacon output produced." },
+    { "bof_image_cache_total",              "result=\"hit\"",       "--watch reloads, by whether the mapped image was kept." },
+    { "bof_image_cache_total",              "result=\"miss\"",      "--watch reloads, by whether the mapped image was kept." },
+    { "bof_catalog_lookups_total",          "result=\"hit\"",       "Catalog name lookups." },
+    { "bof_catalog_lookups_total",          "result=\"miss\"",      "Catalog name lookups." },
+    { "bof_symbol_resolutions_total",       "result=\"resolved\"",  "Import and external symbol resolutions." },
+    { "bof_symbol_resolutions_total",       "result=\"unresolved\"","Import and external symbol resolutions." },
+    { "bof_arena_allocations_total",        "",                     "Allocations served by the job arena." },
+    { "bof_arena_reclaimed_bytes_total",    "",                     "Leaked arena bytes reclaimed at the end of a job." },
+};
+
+const counter_info gauge_infos[METRIC_GAUGE_COUNT] = {
+    { "bof_jobs_queued",                    "", "Jobs waiting for a worker." },
+    { "bof_jobs_running",                   "", "Jobs being executed." },
+    { "bof_workers",                        "", "Worker threads." },
+    { "bof_arena_peak_bytes",               "", "Peak arena usage of the last job that used the arena." },
+};
+
+const counter_info histogram_infos[METRIC_HISTOGRAM_COUNT] = {
+    { "bof_phase_duration_seconds",         "phase=\"parse\"",    "Loader phase times." },
+    { "bof_phase_duration_seconds",         "phase=\"layout\"",   "Loader phase times." },
+    { "bof_phase_duration_seconds",         "phase=\"relocate\"", "Loader phase times." },
+    { "bof_phase_duration_seconds",         "phase=\"execute\"",  "Loader phase times." },
+    { "bof_job_duration_seconds",           "",                   "Load and execution time of a job." },
+    { "bof_queue_wait_seconds",             "class=\"interactive\"", "Time jobs waited for a worker, by scheduling class." },
+    { "bof_queue_wait_seconds",             "class=\"normal\"",      "Time jobs waited for a worker, by scheduling class." },
+    { "bof_queue_wait_seconds",             "class=\"bulk\"",        "Time jobs waited for a worker, by scheduling class." },
+};
+
+struct histogram_shard {
+    std::atomic<uint64_t> buckets[bucket_count];
+    std::atomic<uint64_t> sum_ns;
+    std::atomic<uint64_t> count;
+};
+
+struct alignas(64) metrics_shard {
+    std::atomic<uint64_t> counters[METRIC_COUNTER_COUNT] = {};
+    histogram_shard       histograms[METRIC_HISTOGRAM_COUNT] = {};
+};
+
+struct histogram_snapshot {
+    uint64_t buckets[bucket_count];
+    uint64_t sum_ns;
+    uint64_t count;
+};
+
+struct metrics_snapshot {
+    uint64_t           counters[METRIC_COUNTER_COUNT];
+    int64_t            gauges[METRIC_GAUGE_COUNT];
+    histogram_snapshot histograms[METRIC_HISTOGRAM_COUNT];
+};
+
+std::atomic<bool> enabled { false };
+
+std::atomic<int64_t> gauges[METRIC_GAUGE_COUNT];
+
+//
+// Shards are never freed, a thread that went away keeps its counts.
+//
+std::mutex shard_lock;
+std::vector<std::unique_ptr<metrics_shard>> shards;
+thread_local metrics_shard* local_shard = nullptr;
+
+metrics_shard& shard()
+{
+    if (local_shard == nullptr) {
+        std::lock_guard<std::mutex> guard(shard_lock);
+        local_shard = shards.emplace_back(std::make_unique<metrics_shard>()).get();
+    }
+    return *local_shard;
+}
+
+//
+// Only the owning thread writes a shard value, no read-modify-write needed
+//
+void bump(std::atomic<uint64_t>& value, const uint64_t by)
+{
+    value.store(value.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+
+metrics_snapshot snapshot()
+{
+    metrics_snapshot taken = {};
+    std::lock_guard<std::mutex> guard(shard_lock);
+
+    for (const auto& s : shards) {
+        for (uint32_t i = 0; i < METRIC_COUNTER_COUNT; i++) {
+            taken.counters[i] += s->counters[i].load(std::memory_order_relaxed);
+        }
+        for (uint32_t i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+            for (size_t b = 0; b < bucket_count; b++) {
+                taken.histograms[i].buckets[b] += s->histograms[i].buckets[b].load(std::memory_order_relaxed);
+            }
+            taken.histograms[i].sum_ns += s->histograms[i].sum_ns.load(std::memory_order_relaxed);
+            taken.histograms[i].count  += s->histograms[i].count.load(std::memory_order_relaxed);
+        }
+    }
+
+    for (uint32_t i = 0; i < METRIC_GAUGE_COUNT; i++) {
+        taken.gauges[i] = gauges[i].load(std::memory_order_relaxed);
+    }
+    return taken;
+}
+
+std::string labelled(const char* name, const char* suffix, const std::string& labels)
+{
+    return std::string(name) + suffix + (labels.empty() ? "" : "{" + labels + "}");
+}
+
+//
+// Family header once per metric name, the tables keep a family together.
+//
+void write_family(std::ostream& out, const counter_info& info, const char* type, const char*& last)
+{
+    if (last == nullptr || strcmp(last, info.name) != 0) {
+        out << "# HELP " << info.name << " " << info.help << "\n";
+        out << "# TYPE " << info.name << " " << type << "\n";
+        last = info.name;
+    }
+}
+
+//
+// Background export
+//
+struct exporter {
+    std::string             prometheus_file;
+    std::string             json_file;
+    uint32_t                interval_ms = 0;
+    std::thread             thread;
+    std::mutex              lock;
+    std::condition_variable wake;
+    bool                    stopping = false;
+};
+
+std::unique_ptr<exporter> active_exporter;
+volatile std::sig_atomic_t json_requested = 0;
+
+bool write_file(const std::string& file_name, void (*writer)(std::ostream&))
+{
+    const std::string temporary = file_name + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+        writer(out);
+        if (!out.good()) {
+            return false;
+        }
+    }
+
+#ifdef _WIN32
+    std::remove(file_name.c_str()); // rename does not replace an existing file here
+#endif
+    return std::rename(temporary.c_str(), file_name.c_str()) == 0;
+}
+
+void export_loop(exporter* e)
+{
+    auto next = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> guard(e->lock);
+
+    while (!e->stopping) {
+        if (!e->prometheus_file.empty() && std::chrono::steady_clock::now() >= next) {
+            if (!write_file(e->prometheus_file, metrics_write_prometheus)) {
+                std::cerr << "[!] ERROR, Failed to write metrics: " << e->prometheus_file << std::endl;
+            }
+            next += std::chrono::milliseconds(e->interval_ms);
+        }
+
+        if (json_requested && !e->json_file.empty()) {
+            json_requested = 0;
+            write_file(e->json_file, metrics_write_json);
+        }
+
+        //
+        // Wakes up often enough to notice a snapshot request
+        //
+        e->wake.wait_for(guard, std::chrono::milliseconds(std::min<uint32_t>(e->interval_ms, 100)));
+    }
+}
+
+} // namespace
+
+void metrics_set_enabled(const bool on)
+{
+    enabled = on;
+}
+
+bool metrics_enabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void metrics_add(const metric_counter counter, const uint64_t value)
+{
+    if (metrics_enabled()) {
+        bump(shard().counters[counter], value);
+    }
+}
+
+void metrics_set(const metric_gauge gauge, const int64_t value)
+{
+    if (metrics_enabled()) {
+        gauges[gauge].store(value, std::memory_order_relaxed);
+    }
+}
+
+void metrics_observe(const metric_histogram histogram, const double elapsed_ms)
+{
+    if (!metrics_enabled()) {
+        return;
+    }
+
+    size_t bucket = 0;
+    while (bucket < bucket_count - 1 && elapsed_ms > bucket_bounds_ms[bucket]) {
+        bucket++;
+    }
+
+    histogram_shard& h = shard().histograms[histogram];
+    bump(h.buckets[bucket], 1);
+    bump(h.sum_ns, static_cast<uint64_t>(elapsed_ms * 1e6));
+    bump(h.count, 1);
+}
+
+void metrics_write_prometheus(std::ostream& out)
+{
+    const metrics_snapshot taken = snapshot();
+    const char* last = nullptr;
+
+    for (uint32_t i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        write_family(out, counter_infos[i], "counter", last);
+        out << labelled(counter_infos[i].name, "", counter_infos[i].labels) << " " << taken.counters[i] << "\n";
+    }
+
+    for (uint32_t i = 0; i < METRIC_GAUGE_COUNT; i++) {
+        write_family(out, gauge_infos[i], "gauge", last);
+        out << labelled(gauge_infos[i].name, "", gauge_infos[i].labels) << " " << taken.gauges[i] << "\n";
+    }
+
+    for (uint32_t i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        const counter_info& info = histogram_infos[i];
+        const histogram_snapshot& h = taken.histograms[i];
+        const std::string labels = info.labels;
+        uint64_t cumulative = 0;
+
+        write_family(out, info, "histogram", last);
+        for (size_t b = 0; b < bucket_count; b++) {
+            std::ostringstream bound;
+            if (b == bucket_count - 1) {
+                bound << "+Inf";
+            } else {
+                bound << bucket_bounds_ms[b] / 1000.0;
+            }
+
+            cumulative += h.buckets[b];
+            out << labelled(info.name, "_bucket", labels + (labels.empty() ? "" : ",") + "le=\"" + bound.str() + "\"")
+                << " " << cumulative << "\n";
+        }
+        out << labelled(info.name, "_sum", labels) << " " << static_cast<double>(h.sum_ns) / 1e9 << "\n";
+        out << labelled(info.name, "_count", labels) << " " << h.count << "\n";
+    }
+}
+
+void metrics_write_json(std::ostream& out)
+{
+    const metrics_snapshot taken = snapshot();
+    const auto key = [](const counter_info& info) {
+        std::string labels = info.labels;
+        for (char& c : labels) {
+            c = c == '"' ? '\'' : c;
+        }
+        return std::string("\"") + info.name + (labels.empty() ? "" : "{" + labels + "}") + "\"";
+    };
+
+    out << "{\"counters\":{";
+    for (uint32_t i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        out << (i ? "," : "") << key(counter_infos[i]) << ":" << taken.counters[i];
+    }
+
+    out << "},\"gauges\":{";
+    for (uint32_t i = 0; i < METRIC_GAUGE_COUNT; i++) {
+        out << (i ? "," : "") << key(gauge_infos[i]) << ":" << taken.gauges[i];
+    }
+
+    out << "},\"histograms\":{";
+    for (uint32_t i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        const histogram_snapshot& h = taken.histograms[i];
+
+        out << (i ? "," : "") << key(histogram_infos[i]) << ":{\"count\":" << h.count
+            << ",\"sum_ms\":" << static_cast<double>(h.sum_ns) / 1e6 << ",\"buckets_ms\":[";
+        for (size_t b = 0; b < bucket_count; b++) {
+            out << (b ? "," : "") << "[";
+            if (b == bucket_count - 1) {
+                out << "\"+Inf\"";
+            } else {
+                out << bucket_bounds_ms[b];
+            }
+            out << "," << h.buckets[b] << "]";
+        }
+        out << "]}";
+    }
+    out << "}}\n";
+}
+
+bool metrics_start_export(const std::string& prometheus_file, const std::string& json_file, const uint32_t interval_ms)
+{
+    metrics_set_enabled(true);
+
+    if (prometheus_file.empty() && json_file.empty()) {
+        return true;
+    }
+
+    active_exporter = std::make_unique<exporter>();
+    active_exporter->prometheus_file = prometheus_file;
+    active_exporter->json_file       = json_file;
+    active_exporter->interval_ms     = interval_ms ? interval_ms : 1;
+
+#ifndef _WIN32
+    if (!json_file.empty()) {
+        std::signal(SIGUSR1, [](int) { json_requested = 1; });
+    }
+#endif
+
+    active_exporter->thread = std::thread(export_loop, active_exporter.get());
+    return true;
+}
+
+void metrics_stop_export()
+{
+    if (!active_exporter) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(active_exporter->lock);
+        active_exporter->stopping = true;
+    }
+    active_exporter->wake.notify_all();
+    active_exporter->thread.join();
+
+    //
+    // Final values
+    //
+    if (!active_exporter->prometheus_file.empty() && !write_file(active_exporter->prometheus_file, metrics_write_prometheus)) {
+        std::cerr << "[!] ERROR, Failed to write metrics: " << active_exporter->prometheus_file << std::endl;
+    }
+    if (!active_exporter->json_file.empty() && !write_file(active_exporter->json_file, metrics_write_json)) {
+        std::cerr << "[!] ERROR, Failed to write metrics: " << active_exporter->json_file << std::endl;
+    }
+
+    active_exporter.reset();
+}
@@ -0,0 +1,140 @@
+#include <parallel.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+//
+// One parallel_for call. Items are claimed through next, whoever finishes the
+// last one wakes the caller.
+//
+struct parallel_batch {
+    const std::function<void(size_t)>* fn;
+    size_t                             count;
+    std::atomic<size_t>                next { 0 };
+    std::atomic<size_t>                done { 0 };
+};
+
+class helper_pool {
+    std::mutex                                   mutex_;
+    std::condition_variable                      work_;
+    std::condition_variable                      finished_;
+    std::deque<std::shared_ptr<parallel_batch>>  batches_;
+    std::vector<std::thread>                     threads_;
+    bool                                         stopping_ = false;
+
+    //
+    // Runs items of batch until none are left, returns whether this call ran the last one.
+    //
+    static bool drain(parallel_batch& batch)
+    {
+        bool last = false;
+        for (size_t i = batch.next++; i < batch.count; i = batch.next++) {
+            (*batch.fn)(i);
+            last = batch.done.fetch_add(1) + 1 == batch.count;
+        }
+        return last;
+    }
+
+    void helper_loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        for (;;) {
+            work_.wait(lock, [this] { return stopping_ || !batches_.empty(); });
+            if (stopping_) {
+                return;
+            }
+
+            std::shared_ptr<parallel_batch> batch = batches_.front();
+            lock.unlock();
+            const bool last = drain(*batch);
+            lock.lock();
+
+            //
+            // Every item is claimed, nothing left to hand out
+            //
+            if (!batches_.empty() && batches_.front() == batch) {
+                batches_.pop_front();
+            }
+            if (last) {
+                finished_.notify_all();
+            }
+        }
+    }
+
+public:
+    ~helper_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_.notify_all();
+
+        for (std::thread& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void run(const size_t count, const std::function<void(size_t)>& fn, const uint32_t helpers)
+    {
+        auto batch = std::make_shared<parallel_batch>();
+        batch->fn    = &fn;
+        batch->count = count;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            while (threads_.size() < helpers) {
+                threads_.emplace_back(&helper_pool::helper_loop, this);
+            }
+            batches_.push_back(batch);
+        }
+        work_.notify_all();
+
+        drain(*batch);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        finished_.wait(lock, [&] { return batch->done.load() == batch->count; });
+
+        const auto queued = std::find(batches_.begin(), batches_.end(), batch);
+        if (queued != batches_.end()) {
+            batches_.erase(queued);
+        }
+    }
+};
+
+std::atomic<uint32_t> load_threads { 0 };
+
+} // namespace
+
+void parallel_load_set_threads(const uint32_t threads)
+{
+    load_threads.store(threads);
+}
+
+uint32_t parallel_load_threads()
+{
+    return load_threads.load();
+}
+
+void parallel_for(const size_t count, const std::function<void(size_t)>& fn)
+{
+    static helper_pool pool;
+    const uint32_t threads = load_threads.load();
+
+    if (threads <= 1 || count <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    pool.run(count, fn, threads - 1);
+}
@@ -0,0 +1,247 @@
+#include <perf.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::atomic<bool> enabled { false };
+std::atomic<bool> timing { false };     // phase times without counters
+
+bool active()
+{
+    return enabled.load(std::memory_order_relaxed) || timing.load(std::memory_order_relaxed);
+}
+
+//
+// One reading of every counter: { value, time enabled, time running }
+//
+struct perf_reading {
+    uint64_t values[PERF_COUNTER_COUNT][3];
+    std::chrono::steady_clock::time_point time;
+};
+
+#ifdef __linux__
+struct counter_config {
+    uint32_t type;
+    uint64_t config;
+};
+
+const counter_config counter_configs[PERF_COUNTER_COUNT] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+};
+
+std::atomic<bool> reported_unavailable { false };
+#endif
+
+struct perf_state {
+    bool            opened = false;
+    int             fds[PERF_COUNTER_COUNT];
+    uint32_t        available = 0;
+    bool            rusage_switches = false;   // context switches from getrusage instead
+    uint32_t        running = 0;        // bit per phase between start and stop
+    perf_stats      stats = {};
+    perf_reading    started[PERF_PHASE_COUNT] = {};
+
+    perf_state() {
+        for (int& fd : fds) {
+            fd = -1;
+        }
+    }
+
+    ~perf_state() {
+#ifdef __linux__
+        for (const int fd : fds) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    //
+    // Counters only ever count the thread that opened them.
+    //
+    void open() {
+        opened = true;
+
+#ifdef __linux__
+        int error = 0;
+
+        for (uint32_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+            perf_event_attr attr = {};
+            attr.size           = sizeof(attr);
+            attr.type           = counter_configs[i].type;
+            attr.config         = counter_configs[i].config;
+            attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.exclude_kernel = counter_configs[i].type == PERF_TYPE_HARDWARE; // the BOF's own code
+            attr.exclude_hv     = 1;
+
+            //
+            // Software events happen in the kernel on the thread's behalf. If that is
+            // not allowed, page faults are still seen from user mode, context switches
+            // are not and come from getrusage instead.
+            //
+            fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+            if (fds[i] == -1 && !attr.exclude_kernel && (errno == EACCES || errno == EPERM)) {
+                if (i == PERF_CONTEXT_SWITCHES) {
+                    rusage_switches = true;
+                    available |= 1u << i;
+                    continue;
+                }
+
+                attr.exclude_kernel = 1;
+                fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+            }
+
+            if (fds[i] == -1) {
+                error = errno;
+                continue;
+            }
+            available |= 1u << i;
+        }
+
+        if (available != (1u << PERF_COUNTER_COUNT) - 1 && !reported_unavailable.exchange(true)) {
+            std::cerr << "[*] " << (available == 0 ? "Performance counters are" : "Some performance counters are")
+                      << " unavailable (" << strerror(error) << ", see /proc/sys/kernel/perf_event_paranoid), "
+                      << (available == 0 ? "only timing phases." : "reporting the rest.") << std::endl;
+        }
+#endif
+    }
+
+    void read(perf_reading& reading) const {
+        memset(reading.values, 0, sizeof(reading.values));
+
+#ifdef __linux__
+        for (uint32_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+            if (fds[i] != -1 && ::read(fds[i], reading.values[i], sizeof(reading.values[i])) != sizeof(reading.values[i])) {
+                memset(reading.values[i], 0, sizeof(reading.values[i]));
+            }
+        }
+
+        rusage usage = {};
+        if (rusage_switches && getrusage(RUSAGE_THREAD, &usage) == 0) {
+            reading.values[PERF_CONTEXT_SWITCHES][0] = usage.ru_nvcsw + usage.ru_nivcsw;
+        }
+#endif
+        reading.time = std::chrono::steady_clock::now();
+    }
+};
+
+thread_local perf_state perf;
+
+} // namespace
+
+void perf_set_enabled(const bool on)
+{
+    enabled = on;
+}
+
+bool perf_enabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void perf_set_timing(const bool on)
+{
+    timing = on;
+}
+
+void perf_begin()
+{
+    if (!active()) {
+        return;
+    }
+
+    if (!perf.opened && perf_enabled()) {
+        perf.open();
+    }
+
+    perf.stats = {};
+    perf.stats.available = perf.available;
+    perf.running = 0;
+}
+
+void perf_phase_start(const perf_phase phase)
+{
+    if (active()) {
+        perf.running |= 1u << phase;
+        perf.read(perf.started[phase]);
+    }
+}
+
+void perf_phase_stop(const perf_phase phase)
+{
+    perf_reading now;
+
+    if (!active() || !(perf.running & (1u << phase))) {
+        return; // stopping twice is fine
+    }
+
+    perf.read(now);
+    perf.running &= ~(1u << phase);
+
+    const perf_reading& started = perf.started[phase];
+    perf_sample& sample = perf.stats.phases[phase];
+
+    sample.elapsed_ms += std::chrono::duration<double, std::milli>(now.time - started.time).count();
+
+    for (uint32_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        const uint64_t value   = now.values[i][0] - started.values[i][0];
+        const uint64_t enabled_time = now.values[i][1] - started.values[i][1];
+        const uint64_t running = now.values[i][2] - started.values[i][2];
+
+        //
+        // With more counters than the PMU has, the kernel time-slices them;
+        // scale up to the time the counter was enabled.
+        //
+        if (running != 0 && running < enabled_time) {
+            sample.values[i] += static_cast<uint64_t>(static_cast<double>(value) * enabled_time / running);
+        } else {
+            sample.values[i] += value;
+        }
+    }
+}
+
+perf_stats perf_end()
+{
+    return active() ? perf.stats : perf_stats {};
+}
+
+const char* perf_counter_name(const perf_counter counter)
+{
+    switch (counter) {
+    case PERF_CYCLES:           return "cycles";
+    case PERF_INSTRUCTIONS:     return "instructions";
+    case PERF_CACHE_MISSES:     return "cache-misses";
+    case PERF_BRANCH_MISSES:    return "branch-misses";
+    case PERF_PAGE_FAULTS:      return "page-faults";
+    case PERF_CONTEXT_SWITCHES: return "context-switches";
+    default:                    return "unknown";
+    }
+}
+
+const char* perf_phase_name(const perf_phase phase)
+{
+    switch (phase) {
+    case PERF_PHASE_PARSE:      return "parse";
+    case PERF_PHASE_LAYOUT:     return "layout";
+    case PERF_PHASE_RELOCATE:   return "relocate";
+    case PERF_PHASE_EXECUTE:    return "execute";
+    default:                    return "unknown";
+    }
+}
@@ -0,0 +1,574 @@
+#include <platform.hpp>
+#include <sys/mman.h>
+#include <dlfcn.h>
+#include <csetjmp>
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <ucontext.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <string>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+void* platform_alloc(const size_t size)
+{
+    void* address = mmap(
+        nullptr,
+        size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0);
+
+    return address == MAP_FAILED ? nullptr : address;
+}
+
+bool platform_protect(void* address, const size_t size, const page_protection protection)
+{
+    int prot = PROT_READ | PROT_WRITE;
+
+    switch (protection) {
+    case PROTECT_READ_EXECUTE:
+        prot = PROT_READ | PROT_EXEC;
+        break;
+    case PROTECT_READ_ONLY:
+        prot = PROT_READ;
+        break;
+    default:
+        break;
+    }
+
+    return mprotect(address, size, prot) == 0;
+}
+
+void platform_free(void* address, const size_t size)
+{
+    if (address != nullptr) {
+        munmap(address, size);
+    }
+}
+
+uint64_t platform_peak_working_set()
+{
+    rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss); // bytes
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+}
+
+//
+// BOFs import Windows DLL exports (KERNEL32$..., MSVCRT$...). There is nothing to
+// bind those to here, so only Beacon-API-only COFF objects can run on this backend.
+// ELF objects pass no library and get whatever the process has loaded (libc, ...).
+//
+void* platform_resolve_import(const char* library, const char* function)
+{
+    if (library != nullptr || function == nullptr) {
+        return nullptr;
+    }
+
+    return dlsym(RTLD_DEFAULT, function);
+}
+
+namespace {
+
+const int guarded_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGTRAP, SIGUSR2 };
+
+//
+// platform_abort_guarded_call interrupts the worker thread with this signal
+//
+constexpr int abort_signal = SIGUSR2;
+
+constexpr size_t alt_stack_size = 64 * 1024;
+
+struct guard_frame {
+    sigjmp_buf      jump;
+    platform_fault* fault;
+    pthread_t       thread;
+};
+
+thread_local guard_frame* active_guard = nullptr;
+thread_local std::unique_ptr<char[]> alt_stack;
+
+struct sigaction previous_actions[sizeof(guarded_signals) / sizeof(guarded_signals[0])];
+
+void fault_handler(const int signal, siginfo_t* info, void* ucontext)
+{
+    guard_frame* guard = active_guard;
+
+    //
+    // An abort that arrives after the call finished is dropped. A fault that is
+    // not ours puts the previous handler back and returns, so the faulting
+    // instruction runs again and faults into it.
+    //
+    if (guard == nullptr) {
+        for (size_t i = 0; i < sizeof(guarded_signals) / sizeof(guarded_signals[0]); i++) {
+            if (guarded_signals[i] == signal && signal != abort_signal) {
+                sigaction(signal, &previous_actions[i], nullptr);
+            }
+        }
+        return;
+    }
+
+    guard->fault->code    = signal == abort_signal ? PLATFORM_FAULT_ABORTED : static_cast<uint32_t>(signal);
+    guard->fault->address = signal == abort_signal ? 0 : reinterpret_cast<uint64_t>(info->si_addr);
+    guard->fault->pc      = 0;
+
+#if defined(__linux__) && defined(__x86_64__)
+    guard->fault->pc = static_cast<uint64_t>(static_cast<ucontext_t*>(ucontext)->uc_mcontext.gregs[REG_RIP]);
+#else
+    (void)ucontext;
+#endif
+
+    siglongjmp(guard->jump, 1);
+}
+
+std::once_flag handlers_installed;
+
+void install_fault_handlers()
+{
+    struct sigaction action = {};
+
+    action.sa_sigaction = fault_handler;
+    action.sa_flags     = SA_SIGINFO | SA_ONSTACK | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+
+    for (size_t i = 0; i < sizeof(guarded_signals) / sizeof(guarded_signals[0]); i++) {
+        sigaction(guarded_signals[i], &action, &previous_actions[i]);
+    }
+}
+
+} // namespace
+
+//
+// Faults and aborts are turned into a siglongjmp back here. The handler runs on
+// an alternate stack so stack overflows inside of the call are caught as well.
+//
+bool platform_guarded_call(void (*function)(void*), void* context, platform_fault* fault, platform_guard* guard)
+{
+    guard_frame frame = {};
+    guard_frame* const outer = active_guard;
+
+    std::call_once(handlers_installed, install_fault_handlers);
+
+    if (!alt_stack) {
+        stack_t stack = {};
+
+        alt_stack.reset(new char[alt_stack_size]);
+        stack.ss_sp    = alt_stack.get();
+        stack.ss_size  = alt_stack_size;
+        sigaltstack(&stack, nullptr);
+    }
+
+    frame.fault  = fault;
+    frame.thread = pthread_self();
+    if (sigsetjmp(frame.jump, 1) != 0) {
+        active_guard = outer;
+        if (guard != nullptr) {
+            guard->state.store(GUARD_IDLE);
+        }
+        return false;
+    }
+
+    active_guard = &frame;
+    if (guard != nullptr) {
+        guard->frame = &frame;
+        guard->state.store(GUARD_RUNNING);
+    }
+
+    function(context);
+
+    //
+    // Lost the race against an abort: it is already on its way, wait for it.
+    //
+    if (guard != nullptr) {
+        uint32_t expected = GUARD_RUNNING;
+        while (!guard->state.compare_exchange_strong(expected, GUARD_IDLE)) {
+            sched_yield();
+            expected = GUARD_RUNNING;
+        }
+    }
+
+    active_guard = outer;
+    return true;
+}
+
+bool platform_abort_guarded_call(platform_guard* guard)
+{
+    uint32_t expected = GUARD_RUNNING;
+
+    if (guard == nullptr || !guard->state.compare_exchange_strong(expected, GUARD_ABORTING)) {
+        return false;
+    }
+
+    if (guard->child != 0) {
+        return kill(static_cast<pid_t>(guard->child), SIGKILL) == 0;
+    }
+
+    return pthread_kill(static_cast<guard_frame*>(guard->frame)->thread, abort_signal) == 0;
+}
+
+namespace {
+
+//
+// Held from creating a forked call's pipes until the parent closed its copies
+// of their write ends, so no other child inherits one and keeps the pipe open.
+//
+std::mutex fork_lock;
+
+//
+// Write end of the output pipe, inside of a forked child
+//
+int forked_output_fd = -1;
+
+//
+// Raised by the SIGTERM the parent sends when the call is cancelled, inside of a forked child
+//
+std::atomic<bool> forked_cancelled { false };
+
+void forked_cancel_handler(int)
+{
+    forked_cancelled.store(true);
+}
+
+//
+// How the call ended in the child, sent back before it exits
+//
+struct forked_result {
+    uint32_t       completed;
+    platform_fault fault;
+};
+
+bool open_pipe(int fds[2])
+{
+    if (pipe(fds) != 0) {
+        return false;
+    }
+
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+bool write_all(const int fd, const char* data, size_t size)
+{
+    while (size != 0) {
+        const ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool platform_fork_supported()
+{
+    return true;
+}
+
+void platform_forked_output(const char* data, const size_t size)
+{
+    if (forked_output_fd != -1) {
+        write_all(forked_output_fd, data, size);
+    }
+}
+
+const std::atomic<bool>* platform_forked_cancel_flag()
+{
+    return &forked_cancelled;
+}
+
+void platform_at_fork(void (*prepare)(), void (*parent)(), void (*child)())
+{
+    pthread_atfork(prepare, parent, child);
+}
+
+bool platform_forked_call(void (*function)(void*), void* context, platform_fault* fault, platform_guard* guard,
+                          void (*on_output)(const char* data, size_t size), const std::atomic<bool>* cancel)
+{
+    int output[2] = { -1, -1 };
+    int result[2] = { -1, -1 };
+    pid_t child = -1;
+    sigset_t terminate;
+    sigset_t previous;
+
+    //
+    // Not something the child should be the first to do
+    //
+    std::call_once(handlers_installed, install_fault_handlers);
+
+    {
+        std::lock_guard<std::mutex> forking(fork_lock);
+
+        if (!open_pipe(output)) {
+            return platform_guarded_call(function, context, fault, guard);
+        }
+        //
+        // SIGTERM stays blocked until the child has its handler, a cancel
+        // arriving right after fork() must not kill it
+        //
+        sigemptyset(&terminate);
+        sigaddset(&terminate, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &terminate, &previous);
+
+        if (!open_pipe(result) || (child = fork()) < 0) {
+            pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+            for (const int fd : { output[0], output[1], result[0], result[1] }) {
+                if (fd != -1) {
+                    close(fd);
+                }
+            }
+            return platform_guarded_call(function, context, fault, guard);
+        }
+
+        if (child == 0) {
+            //
+            // Only this thread made it into the child. Report and leave without
+            // running exit handlers, which belong to the parent.
+            //
+            forked_result ended = {};
+            struct sigaction action = {};
+
+            close(output[0]);
+            close(result[0]);
+            forked_output_fd = output[1];
+
+            action.sa_handler = forked_cancel_handler;
+            action.sa_flags   = SA_RESTART;
+            sigemptyset(&action.sa_mask);
+            sigaction(SIGTERM, &action, nullptr);
+            forked_cancelled.store(cancel != nullptr && cancel->load());
+            pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+
+            ended.completed = platform_guarded_call(function, context, &ended.fault) ? 1 : 0;
+            write_all(result[1], reinterpret_cast<const char*>(&ended), sizeof(ended));
+            _exit(0);
+        }
+
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+        close(output[1]);
+        close(result[1]);
+    }
+
+    if (guard != nullptr) {
+        guard->child = child;
+        guard->state.store(GUARD_RUNNING);
+    }
+
+    //
+    // The output pipe ends once the child is gone. While the call may still be
+    // cancelled, the wait wakes up now and then to look at the flag.
+    //
+    char buffer[16 * 1024];
+    bool cancel_sent = false;
+    for (;;) {
+        if (cancel != nullptr && !cancel_sent) {
+            pollfd readable = { output[0], POLLIN, 0 };
+            if (cancel->load()) {
+                kill(child, SIGTERM);
+                cancel_sent = true;
+            } else if (const int ready = poll(&readable, 1, 10); ready == 0 || (ready < 0 && errno == EINTR)) {
+                continue;
+            }
+        }
+
+        const ssize_t received = read(output[0], buffer, sizeof(buffer));
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            break;
+        }
+        if (on_output != nullptr) {
+            on_output(buffer, static_cast<size_t>(received));
+        }
+    }
+
+    forked_result ended = {};
+    ssize_t received = 0;
+    while ((received = read(result[0], &ended, sizeof(ended))) < 0 && errno == EINTR) {
+    }
+
+    int status = 0;
+    while (waitpid(child, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    close(output[0]);
+    close(result[0]);
+
+    bool aborted = false;
+    if (guard != nullptr) {
+        uint32_t expected = GUARD_RUNNING;
+        aborted = !guard->state.compare_exchange_strong(expected, GUARD_IDLE);
+        guard->state.store(GUARD_IDLE);
+        guard->child = 0;
+    }
+
+    if (received == static_cast<ssize_t>(sizeof(ended))) {
+        *fault = ended.fault;
+        return ended.completed != 0;
+    }
+
+    *fault = {};
+    if (aborted) {
+        fault->code = PLATFORM_FAULT_ABORTED;
+    } else if (WIFSIGNALED(status)) {
+        fault->code = static_cast<uint32_t>(WTERMSIG(status));
+    } else {
+        fault->code = PLATFORM_FAULT_EXITED;
+    }
+    return false;
+}
+
+const char* platform_fault_name(const uint32_t code)
+{
+    switch (code) {
+    case SIGSEGV:                   return "segmentation fault";
+    case SIGBUS:                    return "bus error";
+    case SIGILL:                    return "illegal instruction";
+    case SIGFPE:                    return "arithmetic exception";
+    case SIGTRAP:                   return "breakpoint";
+    case PLATFORM_FAULT_ABORTED:    return "aborted";
+    case PLATFORM_FAULT_EXITED:     return "exited";
+    default:                        return "signal";
+    }
+}
+
+struct platform_watch {
+    std::string path;
+    std::string name;       // file name inside of the watched directory
+    int         fd = -1;    // inotify
+    timespec    modified = {};
+};
+
+namespace {
+
+timespec file_modified(const std::string& path)
+{
+    struct stat info = {};
+    if (stat(path.c_str(), &info) != 0) {
+        return {};
+    }
+#ifdef __APPLE__
+    return info.st_mtimespec;
+#else
+    return info.st_mtim;
+#endif
+}
+
+} // namespace
+
+platform_watch* platform_watch_open(const char* path)
+{
+    auto watch = std::make_unique<platform_watch>();
+    const char* slash = strrchr(path, '/');
+    const std::string directory = slash == nullptr ? "." : std::string(path, slash == path ? 1 : slash - path);
+
+    watch->path     = path;
+    watch->name     = slash == nullptr ? path : slash + 1;
+    watch->modified = file_modified(path);
+
+#ifdef __linux__
+    if ((watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1) {
+        return nullptr;
+    }
+
+    if (inotify_add_watch(watch->fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+        close(watch->fd);
+        return nullptr;
+    }
+#endif
+
+    return watch.release();
+}
+
+bool platform_watch_wait(platform_watch* watch, const uint32_t timeout_ms)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+    while (true) {
+        int wait_ms = -1;
+        if (timeout_ms != PLATFORM_WAIT_FOREVER) {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0) {
+                return false;
+            }
+            wait_ms = static_cast<int>(left);
+        }
+
+#ifdef __linux__
+        pollfd ready = { watch->fd, POLLIN, 0 };
+        const int polled = poll(&ready, 1, wait_ms);
+        if (polled == -1 && errno != EINTR) {
+            return false;
+        }
+
+        //
+        // Events name the file inside of the directory, anything else there is ignored
+        //
+        alignas(inotify_event) char events[4096];
+        bool changed = false;
+        ssize_t length = 0;
+
+        while (polled > 0 && (length = read(watch->fd, events, sizeof(events))) > 0) {
+            for (ssize_t offset = 0; offset < length;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(events + offset);
+                changed = changed || (event->len != 0 && watch->name == event->name);
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+        }
+
+        if (changed) {
+            return true;
+        }
+#else
+        usleep(static_cast<useconds_t>(std::min(wait_ms < 0 ? 50 : wait_ms, 50)) * 1000);
+
+        const timespec modified = file_modified(watch->path);
+        if (modified.tv_sec != watch->modified.tv_sec || modified.tv_nsec != watch->modified.tv_nsec) {
+            watch->modified = modified;
+            return true;
+        }
+#endif
+    }
+}
+
+void platform_watch_close(platform_watch* watch)
+{
+    if (watch == nullptr) {
+        return;
+    }
+
+#ifdef __linux__
+    close(watch->fd);
+#endif
+    delete watch;
+}
@@ -0,0 +1,327 @@
+#include <platform.hpp>
+#include <compat.hpp>
+#include <psapi.h>
+#include <malloc.h>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+void* platform_alloc(const size_t size)
+{
+    return VirtualAlloc(
+        nullptr,
+        size,
+        MEM_COMMIT | MEM_RESERVE,
+        PAGE_READWRITE);
+}
+
+bool platform_protect(void* address, const size_t size, const page_protection protection)
+{
+    DWORD old_protect = 0;
+    DWORD new_protect = PAGE_READWRITE;
+
+    switch (protection) {
+    case PROTECT_READ_EXECUTE:
+        new_protect = PAGE_EXECUTE_READ;
+        break;
+    case PROTECT_READ_ONLY:
+        new_protect = PAGE_READONLY;
+        break;
+    default:
+        break;
+    }
+
+    return VirtualProtect(address, size, new_protect, &old_protect) != FALSE;
+}
+
+void platform_free(void* address, size_t)
+{
+    if (address != nullptr) {
+        VirtualFree(address, 0, MEM_RELEASE);
+    }
+}
+
+uint64_t platform_peak_working_set()
+{
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+
+    return counters.PeakWorkingSetSize;
+}
+
+void* platform_resolve_import(const char* library, const char* function)
+{
+    HMODULE hmod = nullptr;
+
+    if (!(hmod = GetModuleHandleA(library)) && !(hmod = LoadLibraryA(library))) {
+        return nullptr;
+    }
+
+    return reinterpret_cast<void*>(GetProcAddress(hmod, function));
+}
+
+namespace {
+
+struct guard_frame {
+    CONTEXT         resume;     // where a fault or an abort continues
+    HANDLE          thread;
+    platform_fault* fault;
+    volatile LONG   faulted;
+};
+
+thread_local guard_frame* active_guard = nullptr;
+
+bool is_hardware_fault(const DWORD code)
+{
+    switch (code) {
+    case EXCEPTION_ACCESS_VIOLATION:
+    case EXCEPTION_IN_PAGE_ERROR:
+    case EXCEPTION_ILLEGAL_INSTRUCTION:
+    case EXCEPTION_PRIV_INSTRUCTION:
+    case EXCEPTION_STACK_OVERFLOW:
+    case EXCEPTION_INT_DIVIDE_BY_ZERO:
+    case EXCEPTION_DATATYPE_MISALIGNMENT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+//
+// Vectored, because BOF code has no unwind information: frame based SEH would
+// have to walk through it to reach a __try in the caller. The handler resumes
+// at the context captured when the guarded call started instead, much like
+// longjmp.
+//
+LONG CALLBACK fault_handler(EXCEPTION_POINTERS* info)
+{
+    guard_frame* guard = active_guard;
+    const EXCEPTION_RECORD* record = info->ExceptionRecord;
+
+    if (guard == nullptr || !is_hardware_fault(record->ExceptionCode)) {
+        return EXCEPTION_CONTINUE_SEARCH;
+    }
+
+    guard->fault->code    = record->ExceptionCode;
+    guard->fault->pc      = reinterpret_cast<uint64_t>(record->ExceptionAddress);
+    guard->fault->address = 0;
+
+    if ((record->ExceptionCode == EXCEPTION_ACCESS_VIOLATION || record->ExceptionCode == EXCEPTION_IN_PAGE_ERROR)
+        && record->NumberParameters >= 2) {
+        guard->fault->address = record->ExceptionInformation[1];
+    }
+
+    guard->faulted = TRUE;
+    memcpy(info->ContextRecord, &guard->resume, sizeof(CONTEXT));
+    return EXCEPTION_CONTINUE_EXECUTION;
+}
+
+} // namespace
+
+bool platform_guarded_call(void (*function)(void*), void* context, platform_fault* fault, platform_guard* guard)
+{
+    static std::once_flag installed;
+    guard_frame frame = {};
+    guard_frame* const outer = active_guard;
+
+    std::call_once(installed, [] { AddVectoredExceptionHandler(TRUE, fault_handler); });
+
+    frame.fault = fault;
+    if (guard != nullptr) {
+        DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &frame.thread, 0, FALSE, DUPLICATE_SAME_ACCESS);
+    }
+
+    RtlCaptureContext(&frame.resume);
+    if (frame.faulted) {
+        active_guard = outer;
+        if (frame.fault->code == EXCEPTION_STACK_OVERFLOW) {
+            _resetstkoflw(); // put the guard page back
+        }
+        if (guard != nullptr) {
+            guard->state.store(GUARD_IDLE);
+            CloseHandle(frame.thread);
+        }
+        return false;
+    }
+
+    active_guard = &frame;
+    if (guard != nullptr) {
+        guard->frame = &frame;
+        guard->state.store(GUARD_RUNNING);
+    }
+
+    function(context);
+
+    //
+    // Lost the race against an abort: it is already on its way, wait for it.
+    //
+    if (guard != nullptr) {
+        uint32_t expected = GUARD_RUNNING;
+        while (!guard->state.compare_exchange_strong(expected, GUARD_IDLE)) {
+            SwitchToThread();
+            expected = GUARD_RUNNING;
+        }
+        CloseHandle(frame.thread);
+    }
+
+    active_guard = outer;
+    return true;
+}
+
+bool platform_fork_supported()
+{
+    return false;
+}
+
+bool platform_forked_call(void (*function)(void*), void* context, platform_fault* fault, platform_guard* guard,
+                          void (*)(const char*, size_t), const std::atomic<bool>*)
+{
+    return platform_guarded_call(function, context, fault, guard);
+}
+
+void platform_forked_output(const char*, size_t)
+{
+}
+
+const std::atomic<bool>* platform_forked_cancel_flag()
+{
+    return nullptr;
+}
+
+void platform_at_fork(void (*)(), void (*)(), void (*)())
+{
+}
+
+//
+// Suspends the thread and moves it to the captured resume context.
+//
+bool platform_abort_guarded_call(platform_guard* guard)
+{
+    uint32_t expected = GUARD_RUNNING;
+    CONTEXT current = {};
+
+    if (guard == nullptr || !guard->state.compare_exchange_strong(expected, GUARD_ABORTING)) {
+        return false;
+    }
+
+    auto* frame = static_cast<guard_frame*>(guard->frame);
+    if (SuspendThread(frame->thread) == static_cast<DWORD>(-1)) {
+        return false;
+    }
+
+    current.ContextFlags = CONTEXT_CONTROL;
+    GetThreadContext(frame->thread, &current);
+
+    frame->fault->code    = PLATFORM_FAULT_ABORTED;
+    frame->fault->pc      = current.Rip;
+    frame->fault->address = 0;
+    frame->faulted        = TRUE;
+
+    const bool moved = SetThreadContext(frame->thread, &frame->resume) != FALSE;
+    ResumeThread(frame->thread);
+    return moved;
+}
+
+const char* platform_fault_name(const uint32_t code)
+{
+    switch (code) {
+    case EXCEPTION_ACCESS_VIOLATION:        return "access violation";
+    case EXCEPTION_IN_PAGE_ERROR:           return "in page error";
+    case EXCEPTION_ILLEGAL_INSTRUCTION:     return "illegal instruction";
+    case EXCEPTION_PRIV_INSTRUCTION:        return "privileged instruction";
+    case EXCEPTION_STACK_OVERFLOW:          return "stack overflow";
+    case EXCEPTION_INT_DIVIDE_BY_ZERO:      return "integer divide by zero";
+    case EXCEPTION_DATATYPE_MISALIGNMENT:   return "datatype misalignment";
+    case PLATFORM_FAULT_ABORTED:            return "aborted";
+    default:                                return "exception";
+    }
+}
+
+struct platform_watch {
+    HANDLE      change = INVALID_HANDLE_VALUE;
+    std::string path;
+    FILETIME    modified = {};
+};
+
+namespace {
+
+FILETIME file_modified(const std::string& path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA info = {};
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info)) {
+        return {};
+    }
+    return info.ftLastWriteTime;
+}
+
+} // namespace
+
+platform_watch* platform_watch_open(const char* path)
+{
+    auto* watch = new platform_watch;
+    const char* separator = strrchr(path, '\\');
+    const char* slash = strrchr(path, '/');
+
+    if (slash != nullptr && (separator == nullptr || slash > separator)) {
+        separator = slash;
+    }
+
+    const std::string directory = separator == nullptr ? "." : std::string(path, separator - path + 1);
+
+    watch->path     = path;
+    watch->modified = file_modified(path);
+    watch->change   = FindFirstChangeNotificationA(directory.c_str(), FALSE,
+        FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+
+    if (watch->change == INVALID_HANDLE_VALUE) {
+        delete watch;
+        return nullptr;
+    }
+
+    return watch;
+}
+
+bool platform_watch_wait(platform_watch* watch, const uint32_t timeout_ms)
+{
+    const ULONGLONG deadline = GetTickCount64() + timeout_ms;
+
+    while (true) {
+        DWORD wait_ms = INFINITE;
+        if (timeout_ms != PLATFORM_WAIT_FOREVER) {
+            const ULONGLONG now = GetTickCount64();
+            if (now >= deadline) {
+                return false;
+            }
+            wait_ms = static_cast<DWORD>(deadline - now);
+        }
+
+        if (WaitForSingleObject(watch->change, wait_ms) != WAIT_OBJECT_0) {
+            return false;
+        }
+
+        if (!FindNextChangeNotification(watch->change)) {
+            return false;
+        }
+
+        //
+        // The notification covers the whole directory
+        //
+        const FILETIME modified = file_modified(watch->path);
+        if (CompareFileTime(&modified, &watch->modified) != 0) {
+            watch->modified = modified;
+            return true;
+        }
+    }
+}
+
+void platform_watch_close(platform_watch* watch)
+{
+    if (watch == nullptr) {
+        return;
+    }
+
+    FindCloseChangeNotification(watch->change);
+    delete watch;
+}
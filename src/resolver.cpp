@@ -0,0 +1,179 @@
+#include <resolver.hpp>
+#include <beacon_api.hpp>
+#include <platform.hpp>
+#include <arena.hpp>
+#include <linker.hpp>
+#include <metrics.hpp>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+namespace {
+
+//
+// Sorted by name (strcmp order) for beacon_api_find. Only addresses, so the
+// table is part of the image and there is nothing to build before a lookup.
+//
+const beacon_api_entry beacon_api_table[] = {
+    { "BeaconAddValue", reinterpret_cast<void*>(BeaconAddValue) },
+    { "BeaconCleanupProcess", reinterpret_cast<void*>(BeaconCleanupProcess) },
+    { "BeaconDataExtract", reinterpret_cast<void*>(BeaconDataExtract) },
+    { "BeaconDataInt", reinterpret_cast<void*>(BeaconDataInt) },
+    { "BeaconDataLength", reinterpret_cast<void*>(BeaconDataLength) },
+    { "BeaconDataParse", reinterpret_cast<void*>(BeaconDataParse) },
+    { "BeaconDataShort", reinterpret_cast<void*>(BeaconDataShort) },
+    { "BeaconFormatAlloc", reinterpret_cast<void*>(BeaconFormatAlloc) },
+    { "BeaconFormatAppend", reinterpret_cast<void*>(BeaconFormatAppend) },
+    { "BeaconFormatFree", reinterpret_cast<void*>(BeaconFormatFree) },
+    { "BeaconFormatInt", reinterpret_cast<void*>(BeaconFormatInt) },
+    { "BeaconFormatPrintf", reinterpret_cast<void*>(BeaconFormatPrintf) },
+    { "BeaconFormatReset", reinterpret_cast<void*>(BeaconFormatReset) },
+    { "BeaconFormatToString", reinterpret_cast<void*>(BeaconFormatToString) },
+    { "BeaconGetSpawnTo", reinterpret_cast<void*>(BeaconGetSpawnTo) },
+    { "BeaconGetValue", reinterpret_cast<void*>(BeaconGetValue) },
+    { "BeaconInjectProcess", reinterpret_cast<void*>(BeaconInjectProcess) },
+    { "BeaconInjectTemporaryProcess", reinterpret_cast<void*>(BeaconInjectTemporaryProcess) },
+    { "BeaconIsAdmin", reinterpret_cast<void*>(BeaconIsAdmin) },
+    { "BeaconIsCancelled", reinterpret_cast<void*>(BeaconIsCancelled) },
+    { "BeaconOutput", reinterpret_cast<void*>(BeaconOutput) },
+    { "BeaconPrintf", reinterpret_cast<void*>(BeaconPrintf) },
+    { "BeaconRemoveValue", reinterpret_cast<void*>(BeaconRemoveValue) },
+    { "BeaconRevertToken", reinterpret_cast<void*>(BeaconRevertToken) },
+    { "BeaconSpawnTemporaryProcess", reinterpret_cast<void*>(BeaconSpawnTemporaryProcess) },
+    { "BeaconUseToken", reinterpret_cast<void*>(BeaconUseToken) },
+    { "toWideChar", reinterpret_cast<void*>(toWideChar) },
+};
+
+void* counted(void* resolved)
+{
+    metrics_add(resolved != nullptr ? METRIC_SYMBOLS_RESOLVED : METRIC_SYMBOLS_UNRESOLVED);
+    return resolved;
+}
+
+void* lookup_object_symbol(const char* symbol);
+#if BOF_ELF_SUPPORT
+void* lookup_elf_symbol(const char* symbol);
+#endif
+
+} // namespace
+
+bool is_supported_beacon_function(const char* name)
+{
+    return beacon_api_find(beacon_api_table, std::size(beacon_api_table), name) != nullptr;
+}
+
+void* resolve_object_symbol(const char* symbol)
+{
+    return counted(lookup_object_symbol(symbol));
+}
+
+#if BOF_ELF_SUPPORT
+void* resolve_elf_symbol(const char* symbol)
+{
+    return counted(lookup_elf_symbol(symbol));
+}
+#endif
+
+namespace {
+
+void* lookup_object_symbol(const char* symbol)
+{
+    std::string function;
+    std::string library;
+    void* resolved_func = nullptr;
+
+    if (symbol == nullptr) {
+        return nullptr;
+    }
+
+    //
+    // anything without the "__imp_" prefix has to come from a library object
+    //
+    if (strncmp("__imp_", symbol, 6) != 0) {
+        if ((resolved_func = link_find_symbol(LINK_COFF, symbol)) == nullptr) {
+            std::cerr << "[!] ERROR, Unresolved external symbol: " << symbol << std::endl;
+        }
+        return resolved_func;
+    }
+
+    symbol += 6; // move past the "__imp_" string
+
+    //
+    // if the symbol is a Beacon API function, check which one it is.
+    //
+    if ((resolved_func = beacon_api_find(beacon_api_table, std::size(beacon_api_table), symbol)) != nullptr) {
+        return resolved_func;
+    }
+
+    else if (strncmp("Beacon", symbol, 6) == 0) {
+        std::cerr << "[!] ERROR, Unsupported beacon function: " << symbol << std::endl;
+        return nullptr;
+    }
+
+    //
+    // otherwise it is a LIBRARY$Function import for the platform to resolve
+    //
+    else {
+        const std::string obj = symbol;
+        const size_t pos = obj.find_first_of('$');
+
+        if (pos == std::string::npos) {
+            std::cerr << "[!] ERROR, Malformed import: " << symbol << std::endl;
+            return nullptr;
+        }
+
+        library = obj.substr(0, pos);
+        function = obj.substr(pos + 1);
+
+        if (arena_enabled() && (resolved_func = arena_import(library.c_str(), function.c_str())) != nullptr) {
+            return resolved_func;
+        }
+
+        resolved_func = platform_resolve_import(library.c_str(), function.c_str());
+        if (!resolved_func) {
+            std::cerr << "[!] ERROR, Unresolved import: " << symbol << std::endl;
+            return nullptr;
+        }
+    }
+
+    return resolved_func;
+}
+
+#if BOF_ELF_SUPPORT
+void* lookup_elf_symbol(const char* symbol)
+{
+    void* resolved_func = nullptr;
+
+    if (symbol == nullptr) {
+        return nullptr;
+    }
+
+    if ((resolved_func = beacon_sysv_function(symbol)) != nullptr) {
+        return resolved_func;
+    }
+
+    else if (strncmp("Beacon", symbol, 6) == 0) {
+        std::cerr << "[!] ERROR, Unsupported beacon function: " << symbol << std::endl;
+        return nullptr;
+    }
+
+    if ((resolved_func = link_find_symbol(LINK_ELF, symbol)) != nullptr) {
+        return resolved_func;
+    }
+
+    if (arena_enabled() && (resolved_func = arena_sysv_import(symbol)) != nullptr) {
+        return resolved_func;
+    }
+
+    resolved_func = platform_resolve_import(nullptr, symbol);
+    if (!resolved_func) {
+        std::cerr << "[!] ERROR, Unresolved import: " << symbol << std::endl;
+        return nullptr;
+    }
+
+    return resolved_func;
+}
+#endif
+
+} // namespace
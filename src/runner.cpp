@@ -0,0 +1,462 @@
+#include <runner.hpp>
+#include <executor.hpp>
+#include <beacon_api.hpp>
+#include <util.hpp>
+#include <trace.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+const char* job_status_name(const job_status status)
+{
+    switch (status) {
+    case JOB_QUEUED:    return "queued";
+    case JOB_RUNNING:   return "running";
+    case JOB_SUCCEEDED: return "succeeded";
+    case JOB_FAILED:    return "failed";
+    case JOB_TIMED_OUT: return "timed out";
+    default:            return "unknown";
+    }
+}
+
+const char* job_priority_name(const job_priority priority)
+{
+    switch (priority) {
+    case JOB_INTERACTIVE: return "interactive";
+    case JOB_NORMAL:      return "normal";
+    case JOB_BULK:        return "bulk";
+    default:              return "unknown";
+    }
+}
+
+std::optional<job_priority> job_priority_from_name(const std::string_view name)
+{
+    for (uint32_t i = 0; i < JOB_PRIORITY_COUNT; i++) {
+        if (name == job_priority_name(static_cast<job_priority>(i))) {
+            return static_cast<job_priority>(i);
+        }
+    }
+
+    return std::nullopt;
+}
+
+void metrics_record_status(const job_status status)
+{
+    switch (status) {
+    case JOB_SUCCEEDED: metrics_add(METRIC_JOBS_SUCCEEDED); break;
+    case JOB_FAILED:    metrics_add(METRIC_JOBS_FAILED); break;
+    case JOB_TIMED_OUT: metrics_add(METRIC_JOBS_TIMED_OUT); break;
+    default:            break;
+    }
+}
+
+job_result run_job(const std::string& object_path, const std::string& arguments, platform_guard* guard, loaded_image* keep)
+{
+    job_result result;
+    std::vector<char> packed;
+    std::optional<packed_blob> blob;
+    char* packed_args = nullptr;
+    uint32_t packed_size = 0;
+
+    //
+    // Streamed objects are read while they load, files up front
+    //
+    std::optional<input_stream> stream;
+    std::optional<std::vector<char>> input_file;
+
+    if (input_stream::is_stream_name(object_path)) {
+        if (!(stream = input_stream::open(object_path))) {
+            std::cerr << "[!] ERROR, Failed to open object stream: " << object_path << std::endl;
+            return result;
+        }
+    } else if (!(input_file = read_from_disk(object_path))) {
+        return result;
+    }
+
+    if (!arguments.empty() && arguments[0] == '@') {
+        if (!(blob = load_packed_arguments(arguments.substr(1)))) {
+            std::cerr << "[!] ERROR, failed to load packed arguments from: " << arguments.substr(1) << std::endl;
+            return result;
+        }
+
+        packed_args = blob->data;
+        packed_size = blob->size;
+    } else if (!arguments.empty()) {
+        if (!pack_arguments(arguments, packed)) {
+            std::cerr << "[!] ERROR, invalid BOF arguments passed." << std::endl;
+            return result;
+        }
+
+        packed_args = packed.data();
+        packed_size = static_cast<uint32_t>(packed.size());
+    }
+
+    clear_beacon_output();
+    if (arena_enabled()) {
+        arena_begin();
+    }
+    perf_begin();
+    if (footprint_enabled()) {
+        footprint_begin();
+    }
+    if (trace_recording()) {
+        trace_record_begin();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const bool succeeded = stream
+        ? load_object_stream(*stream, "go", packed_size ? packed_args : nullptr, packed_size, guard)
+        : load_object(
+            input_file->data(),
+            input_file->size(),
+            "go",
+            packed_size ? packed_args : nullptr,
+            packed_size,
+            guard,
+            keep);
+
+    result.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    result.status     = succeeded ? JOB_SUCCEEDED : JOB_FAILED;
+    result.output     = get_beacon_output();
+    clear_beacon_output();
+
+    if (trace_recording()) {
+        trace_record_end(object_path, packed_args, packed_size, result.output, succeeded);
+    }
+
+    if (arena_enabled()) {
+        result.arena = arena_end();
+    }
+    result.perf = perf_end();
+
+    if (footprint_enabled()) {
+        result.footprint = footprint_end();
+        result.footprint.peak_working_set = platform_peak_working_set();
+    }
+
+    if (metrics_enabled()) {
+        for (uint32_t phase = 0; phase < PERF_PHASE_COUNT; phase++) {
+            metrics_observe(static_cast<metric_histogram>(METRIC_PHASE_PARSE + phase), result.perf.phases[phase].elapsed_ms);
+        }
+        metrics_observe(METRIC_JOB_DURATION, result.elapsed_ms);
+        metrics_add(METRIC_OUTPUT_BYTES, result.output.size());
+
+        if (arena_enabled()) {
+            metrics_add(METRIC_ARENA_ALLOCATIONS, result.arena.allocations);
+            metrics_add(METRIC_ARENA_RECLAIMED_BYTES, result.arena.leaked_bytes);
+            metrics_set(METRIC_ARENA_PEAK_BYTES, static_cast<int64_t>(result.arena.peak_bytes));
+        }
+    }
+
+    return result;
+}
+
+std::optional<std::vector<job>> read_job_file(const std::string& file_name, const uint32_t timeout_ms)
+{
+    std::ifstream input(file_name);
+    std::vector<job> jobs;
+    std::string line;
+
+    if (!input.is_open()) {
+        std::cerr << "[!] ERROR, Failed to open job file: " << file_name << std::endl;
+        return std::nullopt;
+    }
+
+    while (std::getline(input, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        size_t begin = line.find_first_not_of(" \t");
+        if (begin == std::string::npos || line[begin] == '#') {
+            continue;
+        }
+
+        job_priority priority = JOB_NORMAL;
+        if (line[begin] == '[') {
+            const size_t close = line.find(']', begin);
+            const auto named = close != std::string::npos
+                ? job_priority_from_name(std::string_view(line).substr(begin + 1, close - begin - 1))
+                : std::nullopt;
+
+            if (!named || (begin = line.find_first_not_of(" \t", close + 1)) == std::string::npos) {
+                std::cerr << "[!] ERROR, Invalid job class in: " << line << std::endl;
+                return std::nullopt;
+            }
+            priority = *named;
+        }
+
+        const size_t end = line.find_first_of(" \t", begin);
+        job& added = jobs.emplace_back();
+        added.priority    = priority;
+
+        added.object_path = line.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+        added.timeout_ms  = timeout_ms;
+        if (end != std::string::npos && line.find_first_not_of(" \t", end) != std::string::npos) {
+            added.arguments = line.substr(line.find_first_not_of(" \t", end));
+        }
+    }
+
+    return jobs;
+}
+
+worker_pool::worker_pool(const uint32_t workers, const scheduler_limits& limits, const uint32_t grace_ms)
+    : limits_(limits), size_(workers ? workers : 1), grace_ms_(grace_ms)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    limits_.interactive_reserved = std::min(limits_.interactive_reserved, size_ - 1);
+
+    for (uint32_t i = 0; i < size_; i++) {
+        spawn_worker();
+    }
+    metrics_set(METRIC_WORKERS, static_cast<int64_t>(workers_.size()));
+
+    watchdog_ = std::thread(&worker_pool::watchdog_loop, this);
+}
+
+worker_pool::~worker_pool()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stopping_ = true;
+    }
+
+    work_ready_.notify_all();
+    watchdog_wake_.notify_all();
+    watchdog_.join();
+
+    for (auto& w : workers_) {
+        if (!w->retired) { // a hung thread keeps its own reference
+            w->thread.join();
+        }
+    }
+}
+
+void worker_pool::spawn_worker()
+{
+    auto& added = workers_.emplace_back(std::make_shared<worker>());
+    added->thread = std::thread(&worker_pool::worker_loop, this, added);
+}
+
+void worker_pool::submit(job* j)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        j->status    = JOB_QUEUED;
+        j->submitted = std::chrono::steady_clock::now();
+        queues_[j->priority].push_back(j);
+        queued_++;
+        pending_++;
+        metrics_set(METRIC_JOBS_QUEUED, static_cast<int64_t>(queued_));
+    }
+
+    work_ready_.notify_one();
+}
+
+void worker_pool::wait()
+{
+    std::unique_lock<std::mutex> guard(lock_);
+    job_done_.wait(guard, [this] { return pending_ == 0; });
+}
+
+uint32_t worker_pool::replaced_workers()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    return replaced_;
+}
+
+queue_wait_stats worker_pool::queue_wait(const job_priority priority)
+{
+    queue_wait_stats stats;
+    std::vector<double> waits;
+
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        waits = waits_[priority];
+    }
+
+    if (waits.empty()) {
+        return stats;
+    }
+
+    std::sort(waits.begin(), waits.end());
+    for (const double wait : waits) {
+        stats.mean_ms += wait;
+    }
+
+    stats.jobs    = static_cast<uint32_t>(waits.size());
+    stats.mean_ms = stats.mean_ms / static_cast<double>(waits.size());
+    stats.p50_ms  = waits[(waits.size() - 1) / 2];
+    stats.p99_ms  = waits[(waits.size() * 99 + 99) / 100 - 1];
+    stats.max_ms  = waits.back();
+    return stats;
+}
+
+job* worker_pool::take_next()
+{
+    uint32_t shared_running = 0; // jobs outside of the interactive class
+    for (uint32_t i = JOB_INTERACTIVE + 1; i < JOB_PRIORITY_COUNT; i++) {
+        shared_running += running_[i];
+    }
+
+    for (uint32_t i = 0; i < JOB_PRIORITY_COUNT; i++) {
+        const uint32_t limit = limits_.class_limit[i];
+
+        if (queues_[i].empty() || (limit != 0 && running_[i] >= limit)) {
+            continue;
+        }
+        if (i != JOB_INTERACTIVE && shared_running >= size_ - limits_.interactive_reserved) {
+            break; // the rest of the pool is held for interactive jobs
+        }
+
+        job* next = queues_[i].front();
+        queues_[i].pop_front();
+        queued_--;
+        running_[i]++;
+
+        next->queued_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - next->submitted).count();
+        waits_[i].push_back(next->queued_ms);
+        metrics_observe(static_cast<metric_histogram>(METRIC_QUEUE_WAIT_INTERACTIVE + i), next->queued_ms);
+        return next;
+    }
+
+    return nullptr;
+}
+
+void worker_pool::worker_loop(std::shared_ptr<worker> self)
+{
+    set_beacon_cancel_flag(&self->cancel);
+    set_beacon_output_buffer(&self->output, &self->state_lock);
+
+    std::unique_lock<std::mutex> guard(lock_);
+    while (true) {
+        job* current = nullptr;
+
+        work_ready_.wait(guard, [&] { return (current = take_next()) != nullptr || stopping_; });
+        if (current == nullptr) {
+            return; // stopping
+        }
+
+        metrics_set(METRIC_JOBS_QUEUED, static_cast<int64_t>(queued_));
+        metrics_set(METRIC_JOBS_RUNNING, static_cast<int64_t>(pending_ - queued_));
+
+        //
+        // The job itself is only touched with the lock held, a worker that has
+        // been given up on must not write to it anymore.
+        //
+        const std::string object_path = current->object_path;
+        const std::string arguments   = current->arguments;
+
+        current->status = JOB_RUNNING;
+        self->current   = current;
+        self->stage     = 0;
+        self->cancel    = false;
+        {
+            std::lock_guard<std::mutex> state(self->state_lock);
+            self->returned = false;
+        }
+        self->deadline  = std::chrono::steady_clock::now() + std::chrono::milliseconds(current->timeout_ms);
+        if (current->timeout_ms != 0) {
+            watchdog_wake_.notify_one();
+        }
+
+        guard.unlock();
+        job_result result = run_job(object_path, arguments, &self->guard);
+
+        //
+        // Once retired, the pool may already be gone: only self is safe to touch
+        //
+        {
+            std::lock_guard<std::mutex> state(self->state_lock);
+            if (self->retired) {
+                return;
+            }
+            self->returned = true;
+        }
+        guard.lock();
+
+        current->status     = self->stage != 0 ? JOB_TIMED_OUT : result.status;
+        current->output     = std::move(result.output);
+        current->elapsed_ms = result.elapsed_ms;
+        current->arena      = result.arena;
+        current->perf       = result.perf;
+        current->footprint  = result.footprint;
+        self->current       = nullptr;
+        metrics_record_status(current->status);
+
+        running_[current->priority]--;
+        pending_--;
+        metrics_set(METRIC_JOBS_RUNNING, static_cast<int64_t>(pending_ - queued_));
+        job_done_.notify_all();
+
+        //
+        // A class below its limit again may let a waiting worker start something
+        //
+        if (queued_ != 0) {
+            work_ready_.notify_all();
+        }
+    }
+}
+
+void worker_pool::watchdog_loop()
+{
+    std::unique_lock<std::mutex> guard(lock_);
+
+    while (!stopping_) {
+        const auto now = std::chrono::steady_clock::now();
+        auto next = now + std::chrono::hours(1);
+
+        for (size_t i = 0; i < workers_.size(); i++) {
+            worker* w = workers_[i].get();
+            if (w->retired || w->current == nullptr || w->current->timeout_ms == 0) {
+                continue;
+            }
+
+            if (now >= w->deadline) {
+                switch (w->stage++) {
+                case 0: // ask nicely
+                    w->cancel = true;
+                    break;
+                case 1: // force it
+                    platform_abort_guarded_call(&w->guard);
+                    break;
+                default: { // give up on the thread, the job ends here
+                    std::unique_lock<std::mutex> state(w->state_lock);
+                    if (w->returned) {
+                        continue; // it made it back after all and finishes the job itself
+                    }
+                    w->retired = true;
+                    w->current->output = std::move(w->output);
+                    w->output.clear();
+                    state.unlock();
+
+                    w->current->status = JOB_TIMED_OUT;
+                    w->current->elapsed_ms = w->current->timeout_ms + 2.0 * grace_ms_;
+                    metrics_record_status(JOB_TIMED_OUT);
+                    running_[w->current->priority]--;
+                    w->current  = nullptr;
+                    w->thread.detach();
+
+                    std::cerr << "[!] ERROR, worker did not come back from an aborted BOF, replacing it." << std::endl;
+                    spawn_worker();
+                    replaced_++;
+                    pending_--;
+                    metrics_set(METRIC_JOBS_RUNNING, static_cast<int64_t>(pending_ - queued_));
+                    job_done_.notify_all();
+                    work_ready_.notify_all();
+                    continue;
+                }
+                }
+
+                w->deadline = now + std::chrono::milliseconds(grace_ms_);
+            }
+
+            if (w->deadline < next) {
+                next = w->deadline;
+            }
+        }
+
+        watchdog_wake_.wait_until(guard, next);
+    }
+}
@@ -0,0 +1,557 @@
+#include <trace.hpp>
+#include <arena.hpp>
+#include <beacon_api.hpp>
+#include <executor.hpp>
+#include <linker.hpp>
+#include <platform.hpp>
+#include <resolver.hpp>
+#include <util.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if BOF_ELF_SUPPORT
+#include <dlfcn.h>
+#include <link.h>
+#endif
+
+namespace {
+
+//
+// Every distinct import gets one thunk for the lifetime of the process.
+//
+constexpr size_t thunk_count = 256;
+
+constexpr const char* trace_magic = "bof-trace 1";
+
+using u64 = uint64_t;
+
+struct trace_import {
+    std::string         name;       // as the object spells it, "__imp_KERNEL32$GetTickCount" or "time"
+    std::atomic<void*>  real { nullptr };
+    std::atomic<bool>   live { false };     // called even when replaying
+};
+
+struct trace_call {
+    uint32_t import;
+    u64      args[4];
+    u64      result;
+};
+
+struct trace_session {
+    trace_mode                          mode = TRACE_OFF;
+    std::vector<trace_call>             calls;      // recording
+    std::vector<std::vector<u64>>       results;    // replaying, by import index
+    std::vector<size_t>                 cursor;
+    uint64_t                            replayed = 0;
+    uint64_t                            live = 0;
+    uint64_t                            missing = 0;    // calls past the end of the recording
+
+    u64 next_result(const size_t index) {
+        if (index < results.size() && cursor[index] < results[index].size()) {
+            replayed++;
+            return results[index][cursor[index]++];
+        }
+        missing++;
+        return 0;
+    }
+};
+
+std::mutex                  import_lock;
+std::atomic<trace_import*>  imports[thunk_count];
+size_t                      import_count = 0;
+bool                        reported_full = false;
+
+std::string                 record_file;
+
+thread_local trace_session* session = nullptr;
+thread_local std::unique_ptr<trace_session> recording;
+
+//
+// The thunks pass twelve integer arguments on, enough for every Windows API
+// call a BOF makes. Arguments past the caller's own are whatever is on its
+// stack, the callee never looks at them. Nothing in the dispatch touches the
+// vector registers before the call.
+//
+template<typename F>
+u64 dispatch(const size_t index, u64 a1, u64 a2, u64 a3, u64 a4, u64 a5, u64 a6,
+             u64 a7, u64 a8, u64 a9, u64 a10, u64 a11, u64 a12)
+{
+    const trace_import* import = imports[index].load(std::memory_order_acquire);
+    void* real = import->real.load(std::memory_order_relaxed);
+    trace_session* current = session;
+
+    if (current != nullptr && current->mode == TRACE_REPLAY) {
+        if (real == nullptr || !import->live.load(std::memory_order_relaxed)) {
+            return current->next_result(index);
+        }
+        current->live++;
+    }
+
+    const u64 result = reinterpret_cast<F>(real)(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12);
+
+    if (current != nullptr && current->mode == TRACE_RECORD) {
+        current->calls.push_back({ static_cast<uint32_t>(index), { a1, a2, a3, a4 }, result });
+    }
+    return result;
+}
+
+using coff_function = u64 (BOF_API *)(u64, u64, u64, u64, u64, u64, u64, u64, u64, u64, u64, u64);
+
+template<size_t I>
+u64 BOF_API coff_thunk(u64 a1, u64 a2, u64 a3, u64 a4, u64 a5, u64 a6,
+                       u64 a7, u64 a8, u64 a9, u64 a10, u64 a11, u64 a12)
+{
+    return dispatch<coff_function>(I, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12);
+}
+
+template<size_t... I>
+void* const* coff_thunks(std::index_sequence<I...>)
+{
+    static void* const table[] = { reinterpret_cast<void*>(&coff_thunk<I>)... };
+    return table;
+}
+
+#if BOF_ELF_SUPPORT
+using sysv_function = u64 (*)(u64, u64, u64, u64, u64, u64, u64, u64, u64, u64, u64, u64);
+
+template<size_t I>
+u64 sysv_thunk(u64 a1, u64 a2, u64 a3, u64 a4, u64 a5, u64 a6,
+               u64 a7, u64 a8, u64 a9, u64 a10, u64 a11, u64 a12)
+{
+    return dispatch<sysv_function>(I, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12);
+}
+
+template<size_t... I>
+void* const* sysv_thunks(std::index_sequence<I...>)
+{
+    static void* const table[] = { reinterpret_cast<void*>(&sysv_thunk<I>)... };
+    return table;
+}
+#endif
+
+//
+// Imports that only depend on their arguments (and the heap the BOF got from
+// them) run for real during a replay; recorded pointers into another
+// process's heap would be useless.
+//
+bool is_live_function(const std::string& function)
+{
+    static const char* const functions[] = {
+        "malloc", "calloc", "realloc", "free", "_msize",
+        "HeapAlloc", "HeapReAlloc", "HeapFree", "HeapSize", "GetProcessHeap",
+        "LocalAlloc", "LocalReAlloc", "LocalFree", "GlobalAlloc", "GlobalFree",
+        "memcpy", "memmove", "memset", "memcmp", "memchr",
+        "strlen", "strnlen", "strcmp", "strncmp", "_stricmp", "strcpy", "strncpy", "strcat", "strncat",
+        "strchr", "strrchr", "strstr", "strtok", "strtol", "strtoul", "atoi", "tolower", "toupper",
+        "wcslen", "wcscmp", "_wcsicmp", "wcscpy", "wcsncpy", "wcscat", "wcschr", "wcsstr",
+        "sprintf", "snprintf", "_snprintf", "vsnprintf", "_vsnprintf",
+        "swprintf", "_snwprintf", "vswprintf", "_vsnwprintf",
+        "mbstowcs", "wcstombs", "MultiByteToWideChar", "WideCharToMultiByte",
+    };
+
+    return std::any_of(std::begin(functions), std::end(functions), [&](const char* name) { return function == name; });
+}
+
+//
+// Finds or adds the import called name. Returns its index, or thunk_count
+// once every thunk is taken.
+//
+size_t register_import(const std::string& name)
+{
+    for (size_t i = 0; i < import_count; i++) {
+        if (imports[i].load(std::memory_order_relaxed)->name == name) {
+            return i;
+        }
+    }
+
+    if (import_count == thunk_count) {
+        if (!reported_full) {
+            std::cerr << "[*] More than " << thunk_count << " distinct imports, the rest are not traced." << std::endl;
+            reported_full = true;
+        }
+        return thunk_count;
+    }
+
+    auto* added = new trace_import; // lives as long as its thunk may be called
+    added->name = name;
+    imports[import_count].store(added, std::memory_order_release);
+    return import_count++;
+}
+
+void* wrap_import(const std::string& name, void* real, const bool live, void* const* thunks)
+{
+    std::lock_guard<std::mutex> guard(import_lock);
+
+    const size_t index = register_import(name);
+    if (index == thunk_count) {
+        return real;
+    }
+
+    trace_import* import = imports[index].load(std::memory_order_relaxed);
+    import->live.store(live, std::memory_order_relaxed);
+    if (real != nullptr) {
+        import->real.store(real, std::memory_order_release);
+    }
+    return thunks[index];
+}
+
+std::string to_hex(const char* data, const size_t size)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+
+    hex.reserve(size * 2);
+    for (size_t i = 0; i < size; i++) {
+        hex += digits[static_cast<uint8_t>(data[i]) >> 4];
+        hex += digits[static_cast<uint8_t>(data[i]) & 0xf];
+    }
+    return hex;
+}
+
+bool from_hex(const std::string& hex, std::string& out)
+{
+    const auto digit = [](const char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+
+    out.clear();
+    out.reserve(hex.size() / 2);
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        const int high = digit(hex[i]);
+        const int low  = digit(hex[i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        out += static_cast<char>(high << 4 | low);
+    }
+    return true;
+}
+
+struct trace_file {
+    std::string object_path;
+    std::string arguments;      // packed
+    std::string output;
+    bool        succeeded = false;
+    std::vector<std::pair<std::string, u64>> calls; // name, result
+};
+
+//
+// Text, one record per line:
+//   bof-trace 1
+//   object <path>
+//   arguments <hex>
+//   call <name> <arg1> <arg2> <arg3> <arg4> <result>     (hex, in call order)
+//   output <hex>
+//   status succeeded|failed
+//
+std::optional<trace_file> read_trace(const std::filesystem::path& path)
+{
+    std::ifstream input(path);
+    std::string line;
+    trace_file trace;
+
+    if (!input.is_open() || !std::getline(input, line) || line.rfind(trace_magic, 0) != 0) {
+        std::cerr << "[!] ERROR, Not a trace file: " << path.string() << std::endl;
+        return std::nullopt;
+    }
+
+    while (std::getline(input, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        std::istringstream fields(line);
+        std::string kind;
+        std::string value;
+        fields >> kind;
+
+        if (kind == "object") {
+            std::getline(fields >> std::ws, trace.object_path);
+        } else if (kind == "arguments" || kind == "output") {
+            fields >> value;
+            if (!from_hex(value, kind == "output" ? trace.output : trace.arguments)) {
+                std::cerr << "[!] ERROR, Malformed " << kind << " in trace: " << path.string() << std::endl;
+                return std::nullopt;
+            }
+        } else if (kind == "call") {
+            u64 numbers[5] = {};
+            fields >> value >> std::hex >> numbers[0] >> numbers[1] >> numbers[2] >> numbers[3] >> numbers[4];
+            if (fields.fail()) {
+                std::cerr << "[!] ERROR, Malformed call in trace: " << path.string() << ": " << line << std::endl;
+                return std::nullopt;
+            }
+            trace.calls.emplace_back(value, numbers[4]);
+        } else if (kind == "status") {
+            fields >> value;
+            trace.succeeded = value == "succeeded";
+        }
+    }
+
+    if (trace.object_path.empty()) {
+        std::cerr << "[!] ERROR, Trace names no object: " << path.string() << std::endl;
+        return std::nullopt;
+    }
+    return trace;
+}
+
+bool replay_one(const std::filesystem::path& path, std::ostream& out)
+{
+    auto trace = read_trace(path);
+    if (!trace) {
+        return false;
+    }
+
+    //
+    // The object path is taken as recorded, or else next to the trace.
+    //
+    std::filesystem::path object_path = trace->object_path;
+    if (!std::filesystem::exists(object_path) && std::filesystem::exists(path.parent_path() / object_path.filename())) {
+        object_path = path.parent_path() / object_path.filename();
+    }
+
+    auto object = read_from_disk(object_path.string());
+    if (!object) {
+        return false;
+    }
+
+    trace_session replay;
+    replay.mode = TRACE_REPLAY;
+    {
+        std::lock_guard<std::mutex> guard(import_lock);
+        for (const auto& [name, result] : trace->calls) {
+            const size_t index = register_import(name);
+            if (index == thunk_count) {
+                continue;
+            }
+            if (replay.results.size() <= index) {
+                replay.results.resize(index + 1);
+            }
+            replay.results[index].push_back(result);
+        }
+        replay.cursor.assign(replay.results.size(), 0);
+    }
+
+    std::vector<char> arguments(trace->arguments.begin(), trace->arguments.end());
+
+    session = &replay;
+    auto _ = defer([]() { session = nullptr; });
+
+    clear_beacon_output();
+    if (arena_enabled()) {
+        arena_begin();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const bool succeeded = load_object(
+        object->data(),
+        object->size(),
+        "go",
+        arguments.empty() ? nullptr : arguments.data(),
+        static_cast<uint32_t>(arguments.size()),
+        nullptr);
+    const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    const std::string output = get_beacon_output();
+    clear_beacon_output();
+    if (arena_enabled()) {
+        arena_end();
+    }
+
+    const bool matches = output == trace->output && succeeded == trace->succeeded;
+    if (matches) {
+        out << "[+] " << path.string() << ": output matches (" << replay.replayed << " calls replayed, "
+            << replay.live << " live) in " << elapsed_ms << " ms" << std::endl;
+    } else {
+        const auto differs = std::mismatch(output.begin(), output.end(), trace->output.begin(), trace->output.end());
+        out << "[!] " << path.string() << ": ";
+        if (succeeded != trace->succeeded) {
+            out << (succeeded ? "succeeded" : "failed") << ", recorded run " << (trace->succeeded ? "succeeded" : "failed");
+        } else {
+            out << "output differs at byte " << differs.first - output.begin() << " (" << output.size()
+                << " bytes, recorded " << trace->output.size() << ")";
+        }
+        out << " in " << elapsed_ms << " ms" << std::endl;
+    }
+
+    if (replay.missing != 0) {
+        out << "[*] " << replay.missing << " import calls had no recorded result left and returned 0." << std::endl;
+    }
+    return matches;
+}
+
+} // namespace
+
+void trace_set_record(const std::string& trace_file)
+{
+    record_file = trace_file;
+}
+
+bool trace_recording()
+{
+    return !record_file.empty();
+}
+
+bool trace_active()
+{
+    return session != nullptr;
+}
+
+void trace_record_begin()
+{
+    recording = std::make_unique<trace_session>();
+    recording->mode = TRACE_RECORD;
+    session = recording.get();
+}
+
+bool trace_record_end(const std::string& object_path, const char* args, const uint32_t size,
+                      const std::string& output, const bool succeeded)
+{
+    std::ofstream file(record_file, std::ios::binary | std::ios::trunc);
+
+    session = nullptr;
+    const std::unique_ptr<trace_session> recorded = std::move(recording);
+
+    if (!file.is_open()) {
+        std::cerr << "[!] ERROR, Failed to write trace: " << record_file << std::endl;
+        return false;
+    }
+
+    file << trace_magic << "\n";
+    file << "object " << object_path << "\n";
+    file << "arguments " << to_hex(args, size) << "\n";
+    for (const trace_call& call : recorded->calls) {
+        const trace_import* import = imports[call.import].load(std::memory_order_acquire);
+        file << "call " << import->name << std::hex;
+        for (const u64 arg : call.args) {
+            file << " " << arg;
+        }
+        file << " " << call.result << std::dec << "\n";
+    }
+    file << "output " << to_hex(output.data(), output.size()) << "\n";
+    file << "status " << (succeeded ? "succeeded" : "failed") << "\n";
+
+    if (!file.good()) {
+        std::cerr << "[!] ERROR, Failed to write trace: " << record_file << std::endl;
+        return false;
+    }
+
+    if (!log_quiet()) {
+        std::cout << "[+] Recorded " << recorded->calls.size() << " calls to: " << record_file << std::endl;
+    }
+    return true;
+}
+
+bool trace_replay(const std::string& path, std::ostream& out)
+{
+    std::vector<std::filesystem::path> traces;
+    std::error_code error;
+
+    if (std::filesystem::is_directory(path, error)) {
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(path, error)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".trace") {
+                traces.push_back(entry.path());
+            }
+        }
+        std::sort(traces.begin(), traces.end());
+    } else {
+        traces.emplace_back(path);
+    }
+
+    if (traces.empty()) {
+        std::cerr << "[!] ERROR, No traces found in: " << path << std::endl;
+        return false;
+    }
+
+    size_t matched = 0;
+    for (const auto& trace : traces) {
+        matched += replay_one(trace, out) ? 1 : 0;
+    }
+
+    if (traces.size() > 1) {
+        out << "[+] Replayed " << traces.size() << " traces: " << matched << " matched, "
+            << traces.size() - matched << " differed." << std::endl;
+    }
+    return matched == traces.size();
+}
+
+void* trace_resolve_object_symbol(const char* symbol)
+{
+    //
+    // Library objects are code of this process, calls into them are not traced.
+    //
+    if (symbol == nullptr || strncmp("__imp_", symbol, 6) != 0) {
+        return resolve_object_symbol(symbol);
+    }
+
+    const char* function = strchr(symbol, '$');
+    const bool beacon = function == nullptr;
+    const bool live = beacon || is_live_function(function + 1);
+    void* real = nullptr;
+
+    if (session->mode == TRACE_REPLAY && !beacon) {
+        //
+        // The import may well not exist here, replaying does not need it
+        //
+        if (live) {
+            const std::string library(symbol + 6, function);
+            real = arena_enabled() ? arena_import(library.c_str(), function + 1) : nullptr;
+            if (real == nullptr) {
+                real = platform_resolve_import(library.c_str(), function + 1);
+            }
+        }
+    } else if ((real = resolve_object_symbol(symbol)) == nullptr) {
+        return nullptr;
+    }
+
+    static void* const* thunks = coff_thunks(std::make_index_sequence<thunk_count>());
+    return wrap_import(symbol, real, live, thunks);
+}
+
+#if BOF_ELF_SUPPORT
+void* trace_resolve_elf_symbol(const char* symbol)
+{
+    void* real = resolve_elf_symbol(symbol);
+
+    if (real == nullptr || link_find_symbol(LINK_ELF, symbol) != nullptr) {
+        return real;
+    }
+
+    //
+    // Data imports (environ, stdout) are left alone, only functions get a thunk
+    //
+    const bool beacon = beacon_sysv_function(symbol) != nullptr;
+    const bool arena  = arena_enabled() && arena_sysv_import(symbol) == real;
+
+    if (!beacon && !arena) {
+        Dl_info info = {};
+        ElfW(Sym)* entry = nullptr;
+
+        if (!dladdr1(real, &info, reinterpret_cast<void**>(&entry), RTLD_DL_SYMENT) || entry == nullptr
+            || (ELF64_ST_TYPE(entry->st_info) != STT_FUNC && ELF64_ST_TYPE(entry->st_info) != STT_GNU_IFUNC)) {
+            return real;
+        }
+    }
+
+    static void* const* thunks = sysv_thunks(std::make_index_sequence<thunk_count>());
+    return wrap_import(symbol, real, beacon || arena || is_live_function(symbol), thunks);
+}
+#endif
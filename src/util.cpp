@@ -1,5 +1,37 @@
 #include <util.hpp>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <filesystem>
+#include <utility>
+
+#ifdef _WIN32
+#include <compat.hpp>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::atomic<bool> quiet { false };
 
+}
+
+void log_set_quiet(const bool on)
+{
+    quiet.store(on, std::memory_order_relaxed);
+}
+
+bool log_quiet()
+{
+    return quiet.load(std::memory_order_relaxed);
+}
 
 std::optional<std::vector<char>>
 read_from_disk(const std::string& file_name) {
@@ -33,13 +65,15 @@ read_from_disk(const std::string& file_name) {
     }
 
 
-    std::cout << "[+] Read from disk: " << file_name << std::endl;
+    if (!log_quiet()) {
+        std::cout << "[+] Read from disk: " << file_name << std::endl;
+    }
     return out;
 }
 
 
 bool
-is_numeric(const std::string& str) {
+is_numeric(std::string_view str) {
     for( size_t i = 0; i < str.size(); i++ ) {
         if(i == 0 && str[i] == '-') {
             if(str.size() == 1) {
@@ -47,7 +81,7 @@ is_numeric(const std::string& str) {
             }
             continue;
         }
-        if(!isdigit(str[i])) {
+        if(!isdigit(static_cast<unsigned char>(str[i]))) {
             return false;
         }
     }
@@ -57,11 +91,11 @@ is_numeric(const std::string& str) {
 
 
 bool
-is_ambiguous(const std::string& str) {
+is_ambiguous(std::string_view str) {
     if(!str.empty() && (str[0] == 's' || str[0] == 'i')) {
         if(str.size() == 1) {
             return true;
-        } if(!is_numeric(std::string(&str.c_str()[1]))) {
+        } if(!is_numeric(str.substr(1))) {
             return true;
         }
     }
@@ -70,116 +104,497 @@ is_ambiguous(const std::string& str) {
 }
 
 
-void
-strip_whitespace(std::string& str) {
+std::string_view
+strip_whitespace(std::string_view str) {
+
+    const size_t first_non_space = str.find_first_not_of(" \t");
+    if (first_non_space == std::string_view::npos) {
+        return {};
+    }
+
+    const size_t last_non_space = str.find_last_not_of(" \t");
+    return str.substr(first_non_space, last_non_space - first_non_space + 1);
+}
+
+
+bool
+starts_with(std::string_view str, std::string_view prefix) {
+    return str.size() >= prefix.size() && str.compare(0, prefix.size(), prefix) == 0;
+}
+
+
+//
+// Returns the number of UTF-16 code units (no terminator), or npos if the input
+// is not valid UTF-8. Only counts when out is null.
+//
+size_t
+utf8_to_utf16le(std::string_view in, char* out) {
+
+    size_t units = 0;
+    size_t i     = 0;
+
+    //------------------------------------------------------//
+
+    const auto emit = [&](const uint16_t unit) {
+        if(out != nullptr) {
+            out[units * 2]     = static_cast<char>(unit & 0xFF);
+            out[units * 2 + 1] = static_cast<char>(unit >> 8);
+        }
+        ++units;
+    };
+
+    while(i < in.size()) {
+        const auto lead = static_cast<unsigned char>(in[i]);
+        uint32_t   code_point = 0;
+        size_t     extra = 0;
+
+        if(lead < 0x80)                { code_point = lead;        extra = 0; }
+        else if((lead & 0xE0) == 0xC0) { code_point = lead & 0x1F; extra = 1; }
+        else if((lead & 0xF0) == 0xE0) { code_point = lead & 0x0F; extra = 2; }
+        else if((lead & 0xF8) == 0xF0) { code_point = lead & 0x07; extra = 3; }
+        else {
+            return std::string_view::npos;
+        }
+
+        if(extra > in.size() - i - 1) { // truncated sequence
+            return std::string_view::npos;
+        }
+
+        for(size_t j = 1; j <= extra; j++) {
+            const auto cont = static_cast<unsigned char>(in[i + j]);
+            if((cont & 0xC0) != 0x80) {
+                return std::string_view::npos;
+            }
+            code_point = (code_point << 6) | (cont & 0x3F);
+        }
+
+        if(code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+            return std::string_view::npos;
+        }
+
+        if(code_point >= 0x10000) {
+            code_point -= 0x10000;
+            emit(static_cast<uint16_t>(0xD800 + (code_point >> 10)));
+            emit(static_cast<uint16_t>(0xDC00 + (code_point & 0x3FF)));
+        } else {
+            emit(static_cast<uint16_t>(code_point));
+        }
 
-    if (str.empty()) {
-        return;
+        i += extra + 1;
     }
 
-    size_t first_non_space = str.find_first_not_of(" \t");
-    if (first_non_space != std::string::npos) {
-        str.erase(0, first_non_space);
+    return units;
+}
+
+
+//
+// Packs a single, already stripped chunk at out + offset. With out == nullptr
+// nothing is written and only offset is advanced, which is how the size is measured.
+//
+bool
+pack_chunk(std::string_view str, char* out, const size_t capacity, size_t& offset) {
+
+    const auto fits = [&](const size_t bytes) {
+        return out == nullptr || (offset <= capacity && bytes <= capacity - offset);
+    };
+
+    const auto emit = [&](const void* data, const size_t bytes) {
+        if(out != nullptr) {
+            memcpy(out + offset, data, bytes);
+        }
+        offset += bytes;
+    };
+
+    //------------------------------------------------------//
+
+    if(starts_with(str, "file:")) {
+        const std::filesystem::path path(str.substr(5));
+        std::error_code             ec;
+        const uintmax_t             file_size = std::filesystem::file_size(path, ec);
+
+        if(ec || file_size > UINT32_MAX || !fits(sizeof(uint32_t) + file_size)) {
+            return false;
+        }
+
+        const auto size_prefix = static_cast<uint32_t>(file_size);
+        emit(&size_prefix, sizeof(uint32_t));
+
+        if(out != nullptr) {
+            std::ifstream input(path, std::ios::binary);
+            if(!input.read(out + offset, static_cast<std::streamsize>(file_size))) {
+                return false;
+            }
+        }
+
+        offset += file_size;
+        return true;
     }
 
-    if (str.empty()) {
-        return;
+    if(starts_with(str, "wstr:")) {
+        const std::string_view text  = str.substr(5);
+        const size_t           units = utf8_to_utf16le(text, nullptr);
+        const uint16_t         terminator = 0;
+
+        if(units == std::string_view::npos || (units + 1) * 2 > UINT32_MAX || !fits(sizeof(uint32_t) + (units + 1) * 2)) {
+            return false;
+        }
+
+        const auto size_prefix = static_cast<uint32_t>((units + 1) * 2);
+        emit(&size_prefix, sizeof(uint32_t));
+
+        if(out != nullptr) {
+            utf8_to_utf16le(text, out + offset);
+        }
+
+        offset += units * 2;
+        emit(&terminator, sizeof(uint16_t));
+        return true;
     }
 
+    if((str[0] != 's' && str[0] != 'i') || is_ambiguous(str)) {
+        const auto size_prefix = static_cast<uint32_t>(str.size() + 1);
+        const char terminator  = '\0';
 
-    if (str.back() == ' ' || str.back() == '\t') {
-        size_t r_first_non_space = str.size() - 1;
-        while ((r_first_non_space - 1) >= 0 && (str[r_first_non_space - 1] == ' ' || str[r_first_non_space - 1] == '\t')) {
-            --r_first_non_space;
+        if(!fits(sizeof(uint32_t) + size_prefix)) {
+            return false;
         }
 
-        str.erase(r_first_non_space);
+        emit(&size_prefix, sizeof(uint32_t));
+        emit(str.data(), str.size());
+        emit(&terminator, sizeof(char));
+        return true;
+    }
+
+    const bool             is_short = (str[0] == 's');
+    const std::string_view digits   = str.substr(1);
+    int                    arg_int  = 0;
+
+    if(digits.empty() || !is_numeric(digits)) {
+        return false;
     }
+
+    const auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), arg_int);
+    if(ec != std::errc() || end != digits.data() + digits.size()) {
+        return false;
+    }
+
+    if(is_short) {
+        const auto arg_short = static_cast<short>(arg_int);
+        if(!fits(sizeof(short))) {
+            return false;
+        }
+        emit(&arg_short, sizeof(short));
+    } else {
+        if(!fits(sizeof(int))) {
+            return false;
+        }
+        emit(&arg_int, sizeof(int));
+    }
+
+    return true;
 }
 
 
 bool
-pack_arguments(std::string unpacked, std::vector<char>& packed) {
+pack_arguments_impl(std::string_view unpacked, char* out, const size_t capacity, size_t& offset) {
 
-    std::vector<std::string>    chunks;
-    size_t                      start    = 0;
-    size_t                      next_arg = 0;
+    size_t  start    = 0;
+    size_t  next_arg = 0;
+    size_t  count    = 0;
 
 
     if(unpacked.empty()) {
         return false;
     }
 
-    if(unpacked.back() != ',') {
-        unpacked += ',';
-    }
+    while(start < unpacked.size()) {
+        next_arg = unpacked.find(',', start);
+        if(next_arg == std::string_view::npos) {
+            next_arg = unpacked.size();
+        }
 
-    next_arg = unpacked.find(',');
-    while(next_arg != std::string::npos) {
         if(next_arg > start) {
-            chunks.push_back(unpacked.substr(start, next_arg - start));
+            const std::string_view chunk = strip_whitespace(unpacked.substr(start, next_arg - start));
+            if(chunk.empty() || !pack_chunk(chunk, out, capacity, offset)) {
+                return false;
+            }
+            ++count;
         }
 
         start = next_arg + 1;
-        next_arg = unpacked.find(',', start);
     }
 
-    if(chunks.empty()) {
+    return count != 0;
+}
+
+
+std::optional<size_t>
+packed_arguments_size(std::string_view unpacked) {
+    size_t size = 0;
+    if(!pack_arguments_impl(unpacked, nullptr, 0, size)) {
+        return std::nullopt;
+    }
+
+    return size;
+}
+
+
+bool
+pack_arguments(std::string_view unpacked, char* out, const size_t capacity, size_t* written) {
+    size_t offset = 0;
+    if(out == nullptr || !pack_arguments_impl(unpacked, out, capacity, offset)) {
         return false;
     }
 
+    if(written != nullptr) {
+        *written = offset;
+    }
 
-    for(std::string& str : chunks) {
+    return true;
+}
 
-        strip_whitespace(str);
-        if(str.empty()) {
-            return false;
+
+bool
+pack_arguments(std::string_view unpacked, std::vector<char>& packed) {
+
+    const size_t base = packed.size();
+    size_t       written = 0;
+
+    const auto size = packed_arguments_size(unpacked);
+    if(!size) {
+        return false;
+    }
+
+    packed.resize(base + *size);
+    if(!pack_arguments(unpacked, packed.data() + base, *size, &written) || written != *size) {
+        packed.resize(base);
+        return false;
+    }
+
+    return true;
+}
+
+
+mapped_file::mapped_file(mapped_file&& other) noexcept {
+    *this = std::move(other);
+}
+
+
+mapped_file&
+mapped_file::operator=(mapped_file&& other) noexcept {
+    if(this != &other) {
+        this->~mapped_file();
+        base_   = std::exchange(other.base_, nullptr);
+        length_ = std::exchange(other.length_, 0);
+        handle_ = std::exchange(other.handle_, nullptr);
+    }
+
+    return *this;
+}
+
+
+mapped_file::~mapped_file() {
+#ifdef _WIN32
+    if(base_ != nullptr) {
+        UnmapViewOfFile(base_);
+    }
+    if(handle_ != nullptr) {
+        CloseHandle(handle_);
+    }
+#else
+    if(base_ != nullptr) {
+        munmap(base_, length_);
+    }
+#endif
+    base_   = nullptr;
+    length_ = 0;
+    handle_ = nullptr;
+}
+
+
+bool
+input_stream::is_stream_name(const std::string& name) {
+    return name == "-" || starts_with(name, "fd:");
+}
+
+std::optional<input_stream>
+input_stream::open(const std::string& name) {
+
+    input_stream stream;
+
+    if(name == "-") {
+#ifdef _WIN32
+        stream.fd_ = _fileno(stdin);
+        _setmode(stream.fd_, _O_BINARY);
+#else
+        stream.fd_ = STDIN_FILENO;
+#endif
+        return stream;
+    }
+
+#ifndef _WIN32
+    uint32_t fd = 0;
+    const char* value = name.c_str() + 3;
+    const auto [end, ec] = std::from_chars(value, value + strlen(value), fd);
+
+    if(starts_with(name, "fd:") && ec == std::errc() && *end == '\0' && fcntl(static_cast<int>(fd), F_GETFD) != -1) {
+        stream.fd_ = static_cast<int>(fd);
+        return stream;
+    }
+#endif
+
+    return std::nullopt;
+}
+
+size_t
+input_stream::read(void* buffer, const size_t size) {
+
+    size_t done = 0;
+
+    while(done < size) {
+#ifdef _WIN32
+        const int chunk = _read(fd_, static_cast<char*>(buffer) + done, static_cast<unsigned>(std::min<size_t>(size - done, INT32_MAX)));
+#else
+        const ssize_t chunk = ::read(fd_, static_cast<char*>(buffer) + done, size - done);
+        if(chunk < 0 && errno == EINTR) {
+            continue;
+        }
+#endif
+        if(chunk <= 0) {
+            break;
         }
+        done += static_cast<size_t>(chunk);
+    }
 
-        if((str[0] != 's' && str[0] != 'i') || is_ambiguous(str) ) {
-            auto                size_prefix = static_cast<uint32_t>(str.size() + 1); //std::string::size does not include the null terminator
-            std::vector<char>   prefix_buffer;
+    offset_ += done;
+    return done;
+}
 
-            prefix_buffer.resize(sizeof(uint32_t));
-            memcpy(prefix_buffer.data(), &size_prefix, sizeof(uint32_t));
+bool
+input_stream::skip(uint64_t size) {
 
-            packed.insert(packed.end(), prefix_buffer.begin(), prefix_buffer.end());
-            packed.insert(packed.end(), str.begin(), str.end());
-            packed.emplace_back('\0');
+    char discard[4096];
 
-            std::cout << "[+] Packed argument: " << str << " (" << size_prefix << " bytes)" << std::endl;
+    while(size != 0) {
+        const size_t chunk = static_cast<size_t>(std::min<uint64_t>(size, sizeof(discard)));
+        if(read(discard, chunk) != chunk) {
+            return false;
         }
+        size -= chunk;
+    }
 
-        else {
-            const bool          is_short = (str[0] == 's');
-            std::vector<char>   buffer;
+    return true;
+}
 
-            buffer.resize(is_short ? sizeof(short) : sizeof(int));
-            str.erase(0,1);
+std::optional<mapped_file>
+mapped_file::open(const std::string& file_name) {
 
-            if(str.empty() || !is_numeric(str)) {
-                return false;
-            }
+    mapped_file mapping;
 
+#ifdef _WIN32
+    LARGE_INTEGER file_size = { 0 };
+    HANDLE hfile = CreateFileA(
+        file_name.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
 
-            const int arg_int = atoi(str.c_str());
-            if(!arg_int) {
-                return false;
-            }
+    if(hfile == INVALID_HANDLE_VALUE) {
+        return std::nullopt;
+    }
 
+    auto _ = defer([&]() { CloseHandle(hfile); });
 
-            if(is_short) {
-                short arg_short = static_cast<short>(arg_int);
-                memcpy(buffer.data(), &arg_short, sizeof(short));
-                std::cout << "[+] Packed argument: " << arg_short << " (int16)" << std::endl;
-            } else {
-                memcpy(buffer.data(), &arg_int, sizeof(int));
-                std::cout << "[+] Packed argument: " << arg_int << " (int32)" << std::endl;
-            }
+    if(!GetFileSizeEx(hfile, &file_size) || file_size.QuadPart == 0) {
+        return std::nullopt;
+    }
 
-            packed.insert(packed.end(), buffer.begin(), buffer.end());
-        }
+    mapping.handle_ = CreateFileMappingA(hfile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if(mapping.handle_ == nullptr) {
+        return std::nullopt;
+    }
+
+    mapping.base_ = static_cast<char*>(MapViewOfFile(mapping.handle_, FILE_MAP_COPY, 0, 0, 0));
+    if(mapping.base_ == nullptr) {
+        return std::nullopt;
+    }
+
+    mapping.length_ = static_cast<size_t>(file_size.QuadPart);
+#else
+    struct stat file_stat = {};
+    const int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if(fd == -1) {
+        return std::nullopt;
+    }
+
+    auto _ = defer([&]() { ::close(fd); });
+
+    if(fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        return std::nullopt;
+    }
+
+    void* base = mmap(nullptr, file_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if(base == MAP_FAILED) {
+        return std::nullopt;
+    }
+
+    mapping.base_   = static_cast<char*>(base);
+    mapping.length_ = static_cast<size_t>(file_stat.st_size);
+#endif
+
+    return mapping;
+}
+
+
+//
+// Blob layout: { uint32_t magic; uint32_t size; char packed[size]; }
+//
+constexpr uint32_t packed_blob_magic = 0x41464F42; // "BOFA"
+
+bool
+save_packed_arguments(const std::string& file_name, const char* packed, const size_t size) {
+
+    if(size > UINT32_MAX) {
+        return false;
+    }
+
+    const uint32_t header[2] = { packed_blob_magic, static_cast<uint32_t>(size) };
+    std::ofstream  output(file_name, std::ios::binary | std::ios::trunc);
+
+    if(!output.write(reinterpret_cast<const char*>(header), sizeof(header))) {
+        return false;
+    }
+
+    if(size != 0 && !output.write(packed, static_cast<std::streamsize>(size))) {
+        return false;
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+
+std::optional<packed_blob>
+load_packed_arguments(const std::string& file_name) {
+
+    packed_blob blob;
+    uint32_t    header[2] = { 0 };
+
+    auto mapping = mapped_file::open(file_name);
+    if(!mapping || mapping->size() < sizeof(header)) {
+        return std::nullopt;
+    }
+
+    memcpy(header, mapping->data(), sizeof(header));
+    if(header[0] != packed_blob_magic || header[1] > mapping->size() - sizeof(header)) {
+        return std::nullopt;
+    }
+
+    blob.file = std::move(*mapping);
+    blob.data = blob.file.data() + sizeof(header);
+    blob.size = header[1];
+    return blob;
+}
@@ -0,0 +1,53 @@
+/*
+ * Sample ELF BOF for bof-exec on x86-64 Linux.
+ * Build: gcc -c -O2 -fno-stack-protector -fno-asynchronous-unwind-tables elftest.c -o elftest.o
+ */
+#include <string.h>
+
+typedef struct {
+    char* original;
+    char* buffer;
+    int   length;
+    int   size;
+} datap;
+
+#define CALLBACK_OUTPUT 0x0
+
+void  BeaconDataParse(datap* parser, char* buffer, int size);
+int   BeaconDataInt(datap* parser);
+short BeaconDataShort(datap* parser);
+char* BeaconDataExtract(datap* parser, int* size);
+void  BeaconPrintf(int type, char* fmt, ...);
+
+static int calls;
+static const char* greeting = "hello from an ELF object";
+
+static int count_upper(const char* str)
+{
+    int count = 0;
+    for (; *str; str++) {
+        count += (*str >= 'A' && *str <= 'Z');
+    }
+    return count;
+}
+
+void go(char* args, int len)
+{
+    datap parser;
+    int size = 0;
+
+    calls++;
+    BeaconPrintf(CALLBACK_OUTPUT, "%s (call %d, %d bytes of arguments)\n", greeting, calls, len);
+
+    if (len == 0) {
+        return;
+    }
+
+    BeaconDataParse(&parser, args, len);
+    char* str = BeaconDataExtract(&parser, &size);
+    int number = BeaconDataInt(&parser);
+    short small = BeaconDataShort(&parser);
+
+    BeaconPrintf(CALLBACK_OUTPUT, "string: %s (strlen %zu, %d upper case)\n", str, strlen(str), count_upper(str));
+    BeaconPrintf(CALLBACK_OUTPUT, "int: %d, short: %d\n", number, small);
+}
@@ -0,0 +1,12 @@
+    .text
+    .def lib_add; .scl 2; .type 32; .endef
+    .globl lib_add
+lib_add:
+    lea (%rcx,%rdx), %eax
+    addl lib_value(%rip), %eax
+    incl lib_value(%rip)
+    ret
+    .data
+    .globl lib_value
+lib_value:
+    .long 100
@@ -0,0 +1,18 @@
+    .def lib_add; .scl 2; .type 32; .endef
+    .text
+    .def go; .scl 2; .type 32; .endef
+    .globl go
+go:
+    sub $40, %rsp
+    mov $1, %ecx
+    mov $2, %edx
+    call lib_add
+    mov %eax, %r8d
+    mov lib_value(%rip), %r9d
+    xor %ecx, %ecx
+    lea fmt(%rip), %rdx
+    call *__imp_BeaconPrintf(%rip)
+    add $40, %rsp
+    ret
+    .data
+fmt: .asciz "lib_add(1,2)=%d lib_value=%d\n"